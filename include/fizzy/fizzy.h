@@ -17,6 +17,9 @@ typedef struct FizzyModule FizzyModule;
 /// The opaque data type representing an instance (instantiated module).
 typedef struct FizzyInstance FizzyInstance;
 
+/// The opaque data type representing the execution context of a thread.
+typedef struct FizzyExecutionContext FizzyExecutionContext;
+
 /// The data type representing numeric values.
 ///
 /// i64 member is used to represent values of both i32 and i64 type.
@@ -37,6 +40,9 @@ typedef struct FizzyExecutionResult
     /// Value returned from a function.
     /// Valid only if trapped equals false and has_value equals true.
     FizzyValue value;
+    /// Whether execution has been interrupted with fizzy_interrupt().
+    /// The interrupted execution is also trapped.
+    bool interrupted;
 } FizzyExecutionResult;
 
 
@@ -151,9 +157,24 @@ bool fizzy_validate(const uint8_t* wasm_binary, size_t wasm_binary_size);
 /// @returns non-NULL pointer to module in case of success, NULL otherwise.
 const FizzyModule* fizzy_parse(const uint8_t* wasm_binary, size_t wasm_binary_size);
 
+/// The number of entries of the instruction cost table: one for each opcode.
+static const size_t FizzyInstructionCostTableSize = 256;
+
+/// Parse binary module with metered code.
+///
+/// The execution of the code of the module with fizzy_execute_metered() is charged the costs of
+/// the executed instructions. The costs are charged once for each executed basic block.
+///
+/// @param cost_table   Pointer to the array of FizzyInstructionCostTableSize instruction costs
+///                     indexed by opcode. If NULL, the cost of every instruction is 1.
+/// @returns non-NULL pointer to module in case of success, NULL otherwise.
+const FizzyModule* fizzy_parse_metered(
+    const uint8_t* wasm_binary, size_t wasm_binary_size, const uint32_t* cost_table);
+
 /// Free resources associated with the module.
 ///
-/// Should be called unless @p module was passed to fizzy_instantiate.
+/// Should be called for every module returned by fizzy_parse or fizzy_parse_metered.
+/// The instances of the module keep it alive, so it may be called before they are freed.
 /// If passed pointer is NULL, has no effect.
 void fizzy_free_module(const FizzyModule* module);
 
@@ -178,11 +199,9 @@ bool fizzy_find_exported_function(
 
 /// Instantiate a module.
 ///
-/// The instance takes ownership of the module, i.e. fizzy_free_module must not be called on the
-/// module after this call.
-/// For simplicity a module cannot be shared among several instances (calling fizzy_instatiate more
-/// than once with the same module results in undefined behaviour), but after fizzy_instantiate
-/// functions querying module info can still be called with @p module.
+/// The module is not consumed: it is shared by all its instances, so it can be instantiated any
+/// number of times, also concurrently from different threads, without parsing it again.
+/// The module must still be freed with fizzy_free_module.
 ///
 /// @param      module                   Pointer to module.
 /// @param      imported_functions       Pointer to the imported function array. Can be NULL iff
@@ -217,11 +236,9 @@ FizzyInstance* fizzy_instantiate(const FizzyModule* module,
 
 /// Instantiate a module resolving imported functions.
 ///
-/// The instance takes ownership of the module, i.e. fizzy_free_module must not be called on the
-/// module after this call.
-/// For simplicity a module cannot be shared among several instances (calling fizzy_instatiate more
-/// than once with the same module results in undefined behaviour), but after fizzy_instantiate
-/// functions querying module info can still be called with @p module.
+/// The module is not consumed: it is shared by all its instances, so it can be instantiated any
+/// number of times, also concurrently from different threads, without parsing it again.
+/// The module must still be freed with fizzy_free_module.
 ///
 /// @param      module                   Pointer to module.
 /// @param      imported_functions       Pointer to the imported function array. Can be NULL iff
@@ -260,7 +277,8 @@ void fizzy_free_instance(FizzyInstance* instance);
 /// Get pointer to module of an instance.
 ///
 /// @note The returned pointer represents non-owning, "view"-access to the module and must not be
-/// passed to fizzy_free_module.
+/// passed to fizzy_free_module. It is valid as long as the instance and can be passed to
+/// fizzy_instantiate to create another instance of the same module.
 const FizzyModule* fizzy_get_instance_module(FizzyInstance* instance);
 
 /// Get pointer to memory of an instance.
@@ -275,6 +293,72 @@ uint8_t* fizzy_get_instance_memory_data(FizzyInstance* instance);
 /// @note    Function returns memory size regardless of whether memory is exported or not.
 size_t fizzy_get_instance_memory_size(FizzyInstance* instance);
 
+/// Mark the fragment of memory of an instance as modified.
+///
+/// The modifications of memory made by the host through the pointer returned by
+/// fizzy_get_instance_memory_data() must be marked to be reverted by fizzy_reset_instance().
+/// The modifications made by the wasm code are tracked automatically.
+///
+/// @param instance  Pointer to instance with memory. Cannot be NULL.
+/// @param offset    Offset of the modified fragment.
+/// @param size      Size of the modified fragment, which must fit in the memory. Can be zero.
+void fizzy_mark_instance_memory_dirty(FizzyInstance* instance, size_t offset, size_t size);
+
+/// Save the state of an instance to be restored later with fizzy_reset_instance().
+///
+/// The state is usually saved right after instantiation, including the effects of the start
+/// function. Only the state owned by the instance is saved: its memory, table and globals, but not
+/// the imported ones.
+///
+/// @returns true if the state was saved, false if it could not be allocated.
+bool fizzy_snapshot_instance(FizzyInstance* instance);
+
+/// Restore the state of an instance saved by fizzy_snapshot_instance().
+///
+/// Only the memory pages modified since the snapshot or the last reset are copied back,
+/// so the cost depends on what the executions touched, not on the memory size.
+///
+/// @param instance  Pointer to instance with saved state. Cannot be NULL.
+/// @returns true if the state was restored, false if the memory could not be shrunk back to
+///          its saved size, then the instance is not modified.
+bool fizzy_reset_instance(FizzyInstance* instance);
+
+/// Save the state of an instance to the image file.
+///
+/// The state is usually saved after instantiation and the execution of the initialization
+/// function exported by the module. Only the state owned by the instance is saved: its memory,
+/// table and globals. The table may reference only the functions of this instance.
+///
+/// @param instance          Pointer to instance. Cannot be NULL.
+/// @param wasm_binary       The wasm binary the module of the instance was parsed from.
+///                          The image is tied to it.
+/// @param wasm_binary_size  Size of the wasm binary.
+/// @param path              Path of the image file. NULL-terminated string. Cannot be NULL.
+/// @returns true if the image was saved, false otherwise.
+bool fizzy_save_instance_image(FizzyInstance* instance, const uint8_t* wasm_binary,
+    size_t wasm_binary_size, const char* path);
+
+/// Instantiate a module with the state restored from the image file.
+///
+/// The image must have been saved by fizzy_save_instance_image() for the same module and
+/// wasm binary. The data and element segments are not applied and the start function is not
+/// executed. The memory is mapped from the file copy-on-write where possible, so the file must
+/// not be modified while any instance created from it exists.
+///
+/// @param module            Pointer to module. Cannot be NULL.
+/// @param wasm_binary       The wasm binary the module was parsed from.
+/// @param wasm_binary_size  Size of the wasm binary.
+/// @param image_path        Path of the image file. NULL-terminated string. Cannot be NULL.
+/// @returns non-NULL pointer to instance in case of success, NULL otherwise.
+///
+/// @note
+/// The imports are passed the same way as to fizzy_instantiate().
+FizzyInstance* fizzy_instantiate_from_image(const FizzyModule* module, const uint8_t* wasm_binary,
+    size_t wasm_binary_size, const char* image_path,
+    const FizzyExternalFunction* imported_functions, size_t imported_functions_size,
+    const FizzyExternalTable* imported_table, const FizzyExternalMemory* imported_memory,
+    const FizzyExternalGlobal* imported_globals, size_t imported_globals_size);
+
 /// Find exported table by name.
 ///
 /// @param  instance        Pointer to instance.
@@ -319,6 +403,66 @@ bool fizzy_find_exported_global(
 FizzyExecutionResult fizzy_execute(
     FizzyInstance* instance, uint32_t func_idx, const FizzyValue* args, int depth);
 
+/// Execute module function once for each of the argument sets.
+///
+/// The results are the same as of fizzy_execute() with depth 0 called for each argument set,
+/// but the setup of the function execution is done once for the whole batch.
+///
+/// @param instance     Pointer to module instance.
+/// @param args_batch   Pointer to the argument sets placed one after another, each of them having
+///                     the number of function inputs values. Can be NULL if function has 0 inputs.
+/// @param batch_size   The number of argument sets.
+/// @param results      Pointer to the array of @p batch_size results to be written, in the order of
+///                     the argument sets. Can be NULL if @p batch_size is 0.
+///                     The results are written directly to it, nothing is allocated for them.
+///                     The execution which cannot allocate its stack traps, and so do the
+///                     remaining ones.
+///
+/// @note
+/// No validation is done on the number of arguments passed in @p args_batch, nor on their types.
+/// When number of passed arguments or their types are different from the ones defined by the
+/// function type, behaviour is undefined.
+void fizzy_execute_batch(FizzyInstance* instance, uint32_t func_idx,
+    const FizzyValue* args_batch, size_t batch_size, FizzyExecutionResult* results);
+
+/// Execute module function with the gas budget for the metered code.
+///
+/// The execution traps when the gas runs out (see fizzy_parse_metered()).
+/// The budget is independent of the outer execution, if any (e.g. when called from a host
+/// function). The execution with fizzy_execute() is charged against the budget of the outer
+/// execution, or is not limited if there is none.
+///
+/// @param instance     Pointer to module instance.
+/// @param args         Pointer to the argument array. Can be NULL if function has 0 inputs.
+/// @param gas_left     Pointer to the gas budget, updated with the gas left after the execution.
+///                     It is negative if the execution trapped because the gas ran out.
+///                     Cannot be NULL.
+/// @param depth        Call stack depth.
+///
+/// @note
+/// No validation is done on the number of arguments passed in @p args, nor on their types.
+/// When number of passed arguments or their types are different from the ones defined by the
+/// function type, behaviour is undefined.
+FizzyExecutionResult fizzy_execute_metered(FizzyInstance* instance, uint32_t func_idx,
+    const FizzyValue* args, int64_t* gas_left, int depth);
+
+/// Get the execution context of the calling thread.
+///
+/// The context is valid until the thread exits. It can be passed to other threads
+/// to interrupt the executions in the calling thread with fizzy_interrupt().
+FizzyExecutionContext* fizzy_get_thread_execution_context(void);
+
+/// Interrupt the execution in the given context. Can be called from any thread.
+///
+/// The executed code checks the request only at the loop back-edges and function calls, then
+/// the execution ends with the result having the interrupted flag set, including all the nested
+/// executions (e.g. called from host functions). The request is cleared when the outermost
+/// execution starts and returns, so the request made while nothing is being executed has
+/// no effect.
+///
+/// @param context      Pointer to the execution context. Cannot be NULL.
+void fizzy_interrupt(FizzyExecutionContext* context);
+
 #ifdef __cplusplus
 }
 #endif
@@ -4,21 +4,27 @@
 
 #include "cxx20/bit.hpp"
 #include "execute.hpp"
+#include "execution_context.hpp"
 #include "instantiate.hpp"
+#include "instructions.hpp"
 #include "parser.hpp"
 #include <fizzy/fizzy.h>
+#include <algorithm>
 #include <memory>
 
 namespace
 {
-inline const FizzyModule* wrap(const fizzy::Module* module) noexcept
+// The module handle holds a reference to the module shared with the instances of it.
+using SharedModule = std::shared_ptr<const fizzy::Module>;
+
+inline const FizzyModule* wrap(const SharedModule* module) noexcept
 {
     return reinterpret_cast<const FizzyModule*>(module);
 }
 
-inline const fizzy::Module* unwrap(const FizzyModule* module) noexcept
+inline const SharedModule* unwrap(const FizzyModule* module) noexcept
 {
-    return reinterpret_cast<const fizzy::Module*>(module);
+    return reinterpret_cast<const SharedModule*>(module);
 }
 
 inline const FizzyValueType* wrap(const fizzy::ValType* value_types) noexcept
@@ -98,19 +104,34 @@ inline fizzy::Instance* unwrap(FizzyInstance* instance) noexcept
 
 inline FizzyExecutionResult wrap(const fizzy::ExecutionResult& result) noexcept
 {
-    return {result.trapped, result.has_value, wrap(result.value)};
+    // The executions cannot be resumed with the C API, so the suspended one is trapped.
+    if (result.suspended)
+        return {true, false, {}, false};
+    return {result.trapped, result.has_value, wrap(result.value), result.interrupted};
 }
 
 inline fizzy::ExecutionResult unwrap(const FizzyExecutionResult& result) noexcept
 {
+    // The interrupted flag is only read for the trapped result, as the interrupted result is
+    // also trapped. The host functions written before the flag existed may leave it unset.
     if (result.trapped)
-        return fizzy::Trap;
+        return result.interrupted ? fizzy::Interrupted : fizzy::Trap;
     else if (!result.has_value)
         return fizzy::Void;
     else
         return unwrap(result.value);
 }
 
+inline FizzyExecutionContext* wrap(fizzy::ExecutionContext* context) noexcept
+{
+    return reinterpret_cast<FizzyExecutionContext*>(context);
+}
+
+inline fizzy::ExecutionContext* unwrap(FizzyExecutionContext* context) noexcept
+{
+    return reinterpret_cast<fizzy::ExecutionContext*>(context);
+}
+
 inline auto unwrap(FizzyExternalFn func, void* context) noexcept
 {
     return [func, context](fizzy::Instance& instance, const fizzy::Value* args,
@@ -178,14 +199,14 @@ inline fizzy::table_elements* unwrap(FizzyTable* table) noexcept
     return reinterpret_cast<fizzy::table_elements*>(table);
 }
 
-inline FizzyMemory* wrap(fizzy::bytes* memory) noexcept
+inline FizzyMemory* wrap(fizzy::LinearMemory* memory) noexcept
 {
     return reinterpret_cast<FizzyMemory*>(memory);
 }
 
-inline fizzy::bytes* unwrap(FizzyMemory* memory) noexcept
+inline fizzy::LinearMemory* unwrap(FizzyMemory* memory) noexcept
 {
-    return reinterpret_cast<fizzy::bytes*>(memory);
+    return reinterpret_cast<fizzy::LinearMemory*>(memory);
 }
 
 inline FizzyLimits wrap(const fizzy::Limits& limits) noexcept
@@ -280,7 +301,23 @@ const FizzyModule* fizzy_parse(const uint8_t* wasm_binary, size_t wasm_binary_si
     try
     {
         auto module = fizzy::parse({wasm_binary, wasm_binary_size});
-        return wrap(module.release());
+        return wrap(new SharedModule{std::move(module)});
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
+const FizzyModule* fizzy_parse_metered(
+    const uint8_t* wasm_binary, size_t wasm_binary_size, const uint32_t* cost_table)
+{
+    static_assert(FizzyInstructionCostTableSize == fizzy::InstructionCostTableSize);
+    try
+    {
+        auto module = fizzy::parse({wasm_binary, wasm_binary_size},
+            cost_table != nullptr ? cost_table : fizzy::get_default_instruction_cost_table());
+        return wrap(new SharedModule{std::move(module)});
     }
     catch (...)
     {
@@ -295,13 +332,13 @@ void fizzy_free_module(const FizzyModule* module)
 
 FizzyFunctionType fizzy_get_function_type(const FizzyModule* module, uint32_t func_idx)
 {
-    return wrap(unwrap(module)->get_function_type(func_idx));
+    return wrap((*unwrap(module))->get_function_type(func_idx));
 }
 
 bool fizzy_find_exported_function(
     const FizzyModule* module, const char* name, uint32_t* out_func_idx)
 {
-    const auto optional_func_idx = fizzy::find_exported_function(*unwrap(module), name);
+    const auto optional_func_idx = fizzy::find_exported_function(**unwrap(module), name);
     if (!optional_func_idx)
         return false;
 
@@ -354,8 +391,8 @@ FizzyInstance* fizzy_instantiate(const FizzyModule* module,
         auto memory = unwrap(imported_memory);
         auto globals = unwrap(imported_globals, imported_globals_size);
 
-        auto instance = fizzy::instantiate(std::unique_ptr<const fizzy::Module>(unwrap(module)),
-            std::move(functions), std::move(table), std::move(memory), std::move(globals));
+        auto instance = fizzy::instantiate(*unwrap(module), std::move(functions), std::move(table),
+            std::move(memory), std::move(globals));
 
         return wrap(instance.release());
     }
@@ -377,11 +414,11 @@ FizzyInstance* fizzy_resolve_instantiate(const FizzyModule* c_module,
         auto memory = unwrap(imported_memory);
         auto globals = unwrap(imported_globals, imported_globals_size);
 
-        std::unique_ptr<const fizzy::Module> module{unwrap(c_module)};
+        const auto& module = *unwrap(c_module);
         auto resolved_imports = fizzy::resolve_imported_functions(*module, imported_functions);
 
-        auto instance = fizzy::instantiate(std::move(module), std::move(resolved_imports),
-            std::move(table), std::move(memory), std::move(globals));
+        auto instance = fizzy::instantiate(module, std::move(resolved_imports), std::move(table),
+            std::move(memory), std::move(globals));
 
         return wrap(instance.release());
     }
@@ -398,7 +435,7 @@ void fizzy_free_instance(FizzyInstance* instance)
 
 const FizzyModule* fizzy_get_instance_module(FizzyInstance* instance)
 {
-    return wrap(unwrap(instance)->module.get());
+    return wrap(&unwrap(instance)->module);
 }
 
 uint8_t* fizzy_get_instance_memory_data(FizzyInstance* instance)
@@ -419,10 +456,121 @@ size_t fizzy_get_instance_memory_size(FizzyInstance* instance)
     return memory->size();
 }
 
+void fizzy_mark_instance_memory_dirty(FizzyInstance* instance, size_t offset, size_t size)
+{
+    if (size != 0)
+        unwrap(instance)->memory->mark_dirty(offset, size);
+}
+
+bool fizzy_snapshot_instance(FizzyInstance* instance)
+{
+    try
+    {
+        fizzy::snapshot_instance(*unwrap(instance));
+        return true;
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+
+bool fizzy_reset_instance(FizzyInstance* instance)
+{
+    try
+    {
+        fizzy::reset_instance(*unwrap(instance));
+        return true;
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+
+bool fizzy_save_instance_image(FizzyInstance* instance, const uint8_t* wasm_binary,
+    size_t wasm_binary_size, const char* path)
+{
+    try
+    {
+        fizzy::save_instance_image(*unwrap(instance), {wasm_binary, wasm_binary_size}, path);
+        return true;
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+
+FizzyInstance* fizzy_instantiate_from_image(const FizzyModule* module, const uint8_t* wasm_binary,
+    size_t wasm_binary_size, const char* image_path,
+    const FizzyExternalFunction* imported_functions, size_t imported_functions_size,
+    const FizzyExternalTable* imported_table, const FizzyExternalMemory* imported_memory,
+    const FizzyExternalGlobal* imported_globals, size_t imported_globals_size)
+{
+    try
+    {
+        auto functions = unwrap(imported_functions, imported_functions_size);
+        auto table = unwrap(imported_table);
+        auto memory = unwrap(imported_memory);
+        auto globals = unwrap(imported_globals, imported_globals_size);
+
+        auto instance = fizzy::instantiate_from_image(*unwrap(module),
+            {wasm_binary, wasm_binary_size}, image_path, std::move(functions), std::move(table),
+            std::move(memory), std::move(globals));
+
+        return wrap(instance.release());
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+}
+
 FizzyExecutionResult fizzy_execute(
     FizzyInstance* instance, uint32_t func_idx, const FizzyValue* args, int depth)
 {
     const auto result = fizzy::execute(*unwrap(instance), func_idx, unwrap(args), depth);
     return wrap(result);
 }
+
+void fizzy_execute_batch(FizzyInstance* instance, uint32_t func_idx,
+    const FizzyValue* args_batch, size_t batch_size, FizzyExecutionResult* results)
+{
+    // The results are written straight to the output array.
+    auto* results_end = results;
+    try
+    {
+        fizzy::execute_batch(
+            *unwrap(instance), func_idx, unwrap(args_batch), batch_size,
+            [](void* out, const fizzy::ExecutionResult& result) noexcept {
+                *(*static_cast<FizzyExecutionResult**>(out))++ = wrap(result);
+            },
+            &results_end);
+    }
+    catch (...)
+    {
+        // The execution which cannot allocate its operand stack traps, and so do the remaining
+        // ones.
+        std::fill(results_end, results + batch_size, wrap(fizzy::Trap));
+    }
+}
+
+FizzyExecutionResult fizzy_execute_metered(FizzyInstance* instance, uint32_t func_idx,
+    const FizzyValue* args, int64_t* gas_left, int depth)
+{
+    const auto result =
+        fizzy::execute(*unwrap(instance), func_idx, unwrap(args), *gas_left, depth);
+    return wrap(result);
+}
+
+FizzyExecutionContext* fizzy_get_thread_execution_context()
+{
+    return wrap(&fizzy::get_thread_execution_context());
+}
+
+void fizzy_interrupt(FizzyExecutionContext* context)
+{
+    unwrap(context)->interrupt();
+}
 }
@@ -9,4 +9,6 @@ namespace fizzy
 parser_error::~parser_error() noexcept = default;
 validation_error::~validation_error() noexcept = default;
 instantiate_error::~instantiate_error() noexcept = default;
+image_error::~image_error() noexcept = default;
+cache_error::~cache_error() noexcept = default;
 }  // namespace fizzy
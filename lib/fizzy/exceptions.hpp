@@ -29,4 +29,18 @@ struct instantiate_error : public std::runtime_error
     ~instantiate_error() noexcept override;
 };
 
+struct image_error : public std::runtime_error
+{
+    using runtime_error::runtime_error;
+
+    ~image_error() noexcept override;
+};
+
+struct cache_error : public std::runtime_error
+{
+    using runtime_error::runtime_error;
+
+    ~cache_error() noexcept override;
+};
+
 }  // namespace fizzy
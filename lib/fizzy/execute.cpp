@@ -5,6 +5,9 @@
 #include "execute.hpp"
 #include "asserts.hpp"
 #include "cxx20/bit.hpp"
+#include "execution_context.hpp"
+#include "instructions.hpp"
+#include "linear_memory.hpp"
 #include "stack.hpp"
 #include "trunc_boundaries.hpp"
 #include "types.hpp"
@@ -14,12 +17,54 @@
 #include <cstring>
 #include <stack>
 
+#ifdef FIZZY_GUARD_PAGES
+#include "guard_pages.hpp"
+#endif
+
+// Direct-threaded dispatch in the interpreter loop requires the "labels as values" extension
+// of GCC and Clang. Define FIZZY_ENABLE_COMPUTED_GOTO to use it instead of the portable switch
+// dispatch.
+#if defined(__GNUC__) && defined(FIZZY_ENABLE_COMPUTED_GOTO)
+#define FIZZY_COMPUTED_GOTO 1
+#else
+#define FIZZY_COMPUTED_GOTO 0
+#endif
+
+// The interpreter loop keeps the top operand stack item in a local variable (see
+// CachedOperandStack). Define FIZZY_DISABLE_STACK_TOP_CACHING to access the OperandStack directly.
+#ifndef FIZZY_DISABLE_STACK_TOP_CACHING
+#define FIZZY_STACK_TOP_CACHING 1
+#else
+#define FIZZY_STACK_TOP_CACHING 0
+#endif
+
 namespace fizzy
 {
 namespace
 {
-// code_offset + stack_drop
-constexpr auto BranchImmediateSize = 2 * sizeof(uint32_t);
+#if FIZZY_STACK_TOP_CACHING
+/// The operand stack used by the interpreter loop.
+using InterpreterStack = CachedOperandStack;
+
+/// The number of the hidden local variables added to each function frame. The CachedOperandStack
+/// spills the top item of an empty stack there.
+constexpr size_t NumHiddenLocals = 1;
+#else
+using InterpreterStack = OperandStack;
+constexpr size_t NumHiddenLocals = 0;
+#endif
+
+/// Returns the number of the local variables (excluding arguments) in the function frame.
+inline size_t get_frame_local_count(const Code& code) noexcept
+{
+    return code.local_count + NumHiddenLocals;
+}
+
+/// Returns the size of the function frame: the arguments, local variables and operand stack.
+inline size_t get_frame_size(size_t num_args, const Code& code) noexcept
+{
+    return num_args + get_frame_local_count(code) + static_cast<size_t>(code.max_stack_height);
+}
 
 constexpr uint32_t F32AbsMask = 0x7fffffff;
 constexpr uint32_t F32SignMask = ~F32AbsMask;
@@ -36,19 +81,33 @@ inline T read(const uint8_t*& input) noexcept
 }
 
 template <typename T>
-inline void store(bytes& input, size_t offset, T value) noexcept
+inline void store(uint8_t* data, uint64_t offset, T value) noexcept
 {
-    __builtin_memcpy(input.data() + offset, &value, sizeof(value));
+    __builtin_memcpy(data + offset, &value, sizeof(value));
 }
 
 template <typename T>
-inline T load(bytes_view input, size_t offset) noexcept
+inline T load(const uint8_t* data, uint64_t offset) noexcept
 {
     T ret;
-    __builtin_memcpy(&ret, input.data() + offset, sizeof(ret));
+    __builtin_memcpy(&ret, data + offset, sizeof(ret));
     return ret;
 }
 
+/// Converts the result of an instruction to Value.
+///
+/// The f32 value is stored with the upper bits zeroed, so the whole Value is initialized.
+/// A partially initialized Value cannot be kept in a register, which would force the cached top
+/// stack item to memory.
+template <typename T>
+inline Value to_value(T result) noexcept
+{
+    if constexpr (std::is_same_v<T, float>)
+        return uint64_t{bit_cast<uint32_t>(result)};
+    else
+        return Value{result};  // Convert to Value, also from signed integer types.
+}
+
 template <typename DstT, typename SrcT>
 inline constexpr DstT extend(SrcT in) noexcept
 {
@@ -65,17 +124,21 @@ inline constexpr DstT extend(SrcT in) noexcept
 
 template <typename DstT, typename SrcT = DstT>
 inline bool load_from_memory(
-    bytes_view memory, OperandStack& stack, const uint8_t*& immediates) noexcept
+    const LinearMemory& memory, InterpreterStack& stack, const uint8_t*& immediates) noexcept
 {
     const auto address = stack.top().as<uint32_t>();
     // NOTE: alignment is dropped by the parser
     const auto offset = read<uint32_t>(immediates);
     // Addressing is 32-bit, but we keep the value as 64-bit to detect overflows.
-    if ((uint64_t{address} + offset + sizeof(SrcT)) > memory.size())
+    const auto effective_address = uint64_t{address} + offset;
+#ifndef FIZZY_GUARD_PAGES
+    if (effective_address + sizeof(SrcT) > memory.size())
         return false;
+#endif
+    // With guard pages the out-of-bounds access faults and the fault handler traps.
 
-    const auto ret = load<SrcT>(memory, address + offset);
-    stack.top() = extend<DstT>(ret);
+    const auto ret = load<SrcT>(memory.data(), effective_address);
+    stack.top() = to_value(extend<DstT>(ret));
     return true;
 }
 
@@ -95,23 +158,28 @@ inline constexpr DstT shrink(Value value) noexcept
 
 template <typename DstT>
 inline bool store_into_memory(
-    bytes& memory, OperandStack& stack, const uint8_t*& immediates) noexcept
+    LinearMemory& memory, InterpreterStack& stack, const uint8_t*& immediates) noexcept
 {
     const auto value = shrink<DstT>(stack.pop());
     const auto address = stack.pop().as<uint32_t>();
     // NOTE: alignment is dropped by the parser
     const auto offset = read<uint32_t>(immediates);
     // Addressing is 32-bit, but we keep the value as 64-bit to detect overflows.
-    if ((uint64_t{address} + offset + sizeof(DstT)) > memory.size())
+    const auto effective_address = uint64_t{address} + offset;
+#ifndef FIZZY_GUARD_PAGES
+    if (effective_address + sizeof(DstT) > memory.size())
         return false;
+#endif
+    // With guard pages the out-of-bounds access faults and the fault handler traps.
 
-    store<DstT>(memory, address + offset, value);
+    store<DstT>(memory.data(), effective_address, value);
+    memory.mark_stored<sizeof(DstT)>(effective_address);
     return true;
 }
 
 /// Converts the top stack item by truncating a float value to an integer value.
 template <typename SrcT, typename DstT>
-inline bool trunc(OperandStack& stack) noexcept
+inline bool trunc(InterpreterStack& stack) noexcept
 {
     static_assert(std::is_floating_point_v<SrcT>);
     static_assert(std::is_integral_v<DstT>);
@@ -131,11 +199,11 @@ inline bool trunc(OperandStack& stack) noexcept
 
 /// Converts the top stack item from an integer value to a float value.
 template <typename SrcT, typename DstT>
-inline void convert(OperandStack& stack) noexcept
+inline void convert(InterpreterStack& stack) noexcept
 {
     static_assert(std::is_integral_v<SrcT>);
     static_assert(std::is_floating_point_v<DstT>);
-    stack.top() = static_cast<DstT>(stack.top().as<SrcT>());
+    stack.top() = to_value(static_cast<DstT>(stack.top().as<SrcT>()));
 }
 
 /// Performs a bit_cast from SrcT type to DstT type.
@@ -143,39 +211,59 @@ inline void convert(OperandStack& stack) noexcept
 /// This should be optimized to empty function in assembly. Except for f32 -> i32 where pushing
 /// the result i32 value to the stack requires zero-extension to 64-bit.
 template <typename SrcT, typename DstT>
-inline void reinterpret(OperandStack& stack) noexcept
+inline void reinterpret(InterpreterStack& stack) noexcept
 {
     static_assert(std::is_integral_v<SrcT> == std::is_floating_point_v<DstT> ||
                   std::is_floating_point_v<SrcT> == std::is_integral_v<DstT>);
-    stack.top() = bit_cast<DstT>(stack.top().as<SrcT>());
+    stack.top() = to_value(bit_cast<DstT>(stack.top().as<SrcT>()));
 }
 
 template <typename Op>
-inline void unary_op(OperandStack& stack, Op op) noexcept
+inline void unary_op(InterpreterStack& stack, Op op) noexcept
 {
     using T = decltype(op({}));
     const auto result = op(stack.top().as<T>());
-    stack.top() = Value{result};  // Convert to Value, also from signed integer types.
+    stack.top() = to_value(result);
 }
 
 template <typename Op>
-inline void binary_op(OperandStack& stack, Op op) noexcept
+inline void binary_op(InterpreterStack& stack, Op op) noexcept
 {
     using T = decltype(op({}, {}));
     const auto val2 = stack.pop().as<T>();
     const auto val1 = stack.top().as<T>();
     const auto result = op(val1, val2);
-    stack.top() = Value{result};  // Convert to Value, also from signed integer types.
+    stack.top() = to_value(result);
 }
 
 template <typename T, template <typename> class Op>
-inline void comparison_op(OperandStack& stack, Op<T> op) noexcept
+inline void comparison_op(InterpreterStack& stack, Op<T> op) noexcept
 {
     const auto val2 = stack.pop().as<T>();
     const auto val1 = stack.top().as<T>();
     stack.top() = uint32_t{op(val1, val2)};
 }
 
+/// Executes the binary instruction with the second operand being the immediate value.
+template <typename Op>
+inline void binary_op_imm(InterpreterStack& stack, const uint8_t*& immediates, Op op) noexcept
+{
+    using T = decltype(op({}, {}));
+    const auto val2 = read<T>(immediates);
+    const auto val1 = stack.top().as<T>();
+    const auto result = op(val1, val2);
+    stack.top() = to_value(result);
+}
+
+/// Pops both operands of the comparison and returns the result without pushing it to the stack.
+template <typename T, template <typename> class Op>
+inline bool pop_comparison(InterpreterStack& stack, Op<T> op) noexcept
+{
+    const auto val2 = stack.pop().as<T>();
+    const auto val1 = stack.pop().as<T>();
+    return op(val1, val2);
+}
+
 template <typename T>
 inline constexpr T add(T a, T b) noexcept
 {
@@ -453,12 +541,26 @@ __attribute__((no_sanitize("float-cast-overflow"))) inline constexpr float demot
     return static_cast<float>(value);
 }
 
-void branch(const Code& code, OperandStack& stack, const uint8_t*& pc, uint32_t arity) noexcept
+/// Checks if the execution is interrupted (see ExecutionContext::interrupt()) when taking
+/// the branch ending at the given pc. This is polled only at the loop back-edges, i.e. the branches
+/// to the preceding instructions, as only these make the function code execute indefinitely.
+inline bool is_interrupted_at_branch(
+    const ExecutionContext& context, const uint8_t* pc, const uint8_t* target_pc) noexcept
+{
+    return target_pc < pc && context.interrupt_requested();
+}
+
+/// Takes the branch. Returns false if the execution is interrupted at the loop back-edge instead.
+inline bool branch(const Code& code, InterpreterStack& stack, const uint8_t*& pc, uint32_t arity,
+    const ExecutionContext& context) noexcept
 {
     const auto code_offset = read<uint32_t>(pc);
     const auto stack_drop = read<uint32_t>(pc);
 
-    pc = code.instructions.data() + code_offset;
+    const auto* const target_pc = code.instructions.data() + code_offset;
+    if (is_interrupted_at_branch(context, pc, target_pc))
+        return false;
+    pc = target_pc;
 
     // When branch is taken, additional stack items must be dropped.
     assert(static_cast<int>(stack_drop) >= 0);
@@ -472,22 +574,242 @@ void branch(const Code& code, OperandStack& stack, const uint8_t*& pc, uint32_t
     }
     else
         stack.drop(stack_drop);
+    return true;
+}
+
+/// Takes the branch of the br_no_drop or br_if_no_drop instruction: only jumps to the target.
+/// Returns false if the execution is interrupted at the loop back-edge instead.
+inline bool branch_no_drop(
+    const Code& code, const uint8_t*& pc, const ExecutionContext& context) noexcept
+{
+    pc += sizeof(uint32_t);  // Skip the arity.
+    const auto code_offset = read<uint32_t>(pc);
+    pc += sizeof(uint32_t);  // Skip the stack_drop.
+
+    const auto* const target_pc = code.instructions.data() + code_offset;
+    if (is_interrupted_at_branch(context, pc, target_pc))
+        return false;
+    pc = target_pc;
+    return true;
+}
+
+/// Takes the branch of the br_void or br_if_void instruction: drops the stack items
+/// without keeping the result.
+/// Returns false if the execution is interrupted at the loop back-edge instead.
+inline bool branch_void(const Code& code, InterpreterStack& stack, const uint8_t*& pc,
+    const ExecutionContext& context) noexcept
+{
+    pc += sizeof(uint32_t);  // Skip the arity.
+    const auto code_offset = read<uint32_t>(pc);
+    const auto stack_drop = read<uint32_t>(pc);
+
+    const auto* const target_pc = code.instructions.data() + code_offset;
+    if (is_interrupted_at_branch(context, pc, target_pc))
+        return false;
+    pc = target_pc;
+
+    assert(stack.size() >= stack_drop);
+    stack.drop(stack_drop);
+    return true;
+}
+
+/// Executes the br_if instruction being the part of a superinstruction, with the condition
+/// already evaluated. The pc points at the br_if opcode.
+/// Returns false if the execution is interrupted at the loop back-edge.
+inline bool fused_br_if(const Code& code, InterpreterStack& stack, const uint8_t*& pc,
+    bool condition, const ExecutionContext& context) noexcept
+{
+    ++pc;  // Skip the br_if opcode.
+    if (!condition)
+    {
+        pc += sizeof(uint32_t) + BranchImmediateSize;  // Skip arity and branch immediates.
+        return true;
+    }
+
+    const auto arity = read<uint32_t>(pc);
+    return branch(code, stack, pc, arity, context);
+}
+
+#ifdef FIZZY_GUARD_PAGES
+/// Sets the memory fault handler of the current thread for the lifetime of the scope.
+class MemoryFaultHandlerScope
+{
+    MemoryFaultHandler*& m_current;
+    MemoryFaultHandler* const m_prev;
+
+public:
+    explicit MemoryFaultHandlerScope(MemoryFaultHandler* handler) noexcept
+      : m_current{current_memory_fault_handler()}, m_prev{m_current}
+    {
+        m_current = handler;
+    }
+
+    ~MemoryFaultHandlerScope() noexcept { m_current = m_prev; }
+
+    MemoryFaultHandlerScope(const MemoryFaultHandlerScope&) = delete;
+    MemoryFaultHandlerScope& operator=(const MemoryFaultHandlerScope&) = delete;
+};
+#endif
+
+/// Returns the memory of the instance to be executed. With guard pages, the memory fault handler
+/// of the current thread is switched to this memory.
+inline LinearMemory* get_executed_memory(Instance& instance) noexcept
+{
+    auto* const memory = instance.memory.get();
+#ifdef FIZZY_GUARD_PAGES
+    auto* const handler = current_memory_fault_handler();
+    assert(handler != nullptr);
+    handler->memory_data = memory != nullptr ? memory->data() : nullptr;
+#endif
+    return memory;
 }
 
-inline bool invoke_function(const FuncType& func_type, uint32_t func_idx, Instance& instance,
-    OperandStack& stack, int depth)
+ExecutionResult execute_frame(Instance& instance, FuncIdx func_idx, OperandStack& stack,
+    ExecutionContext& context, int depth, SuspendedExecution* suspended = nullptr);
+
+/// Executes the function defined in the module (not imported) with the frame placed
+/// in the execution context stack space. The arguments must already be at the frame beginning.
+inline ExecutionResult execute_in_context(Instance& instance, FuncIdx func_idx, const Code& code,
+    Value* frame, size_t frame_size, ExecutionContext& context, int depth)
+{
+    const ExecutionContext::FrameGuard guard{context, frame, frame_size};
+    OperandStack stack(frame, instance.module->get_function_type(func_idx).inputs.size(),
+        get_frame_local_count(code));
+    return execute_frame(instance, func_idx, stack, context, depth);
+}
+
+/// Executes the function defined in the module (not imported) with the arguments copied to
+/// the free part of the execution context stack space. If the frame does not fit there,
+/// it is allocated separately.
+ExecutionResult execute_with_args_copy(
+    Instance& instance, FuncIdx func_idx, const Value* args, ExecutionContext& context, int depth)
+{
+    const auto num_args = instance.module->get_function_type(func_idx).inputs.size();
+    const auto& code = instance.module->get_code(func_idx);
+    const auto frame_size = get_frame_size(num_args, code);
+
+    auto* const frame = context.free_space();
+    if (context.can_allocate(frame, frame_size))
+    {
+        std::copy_n(args, num_args, frame);
+        return execute_in_context(instance, func_idx, code, frame, frame_size, context, depth);
+    }
+
+    OperandStack stack(args, num_args, get_frame_local_count(code),
+        static_cast<size_t>(code.max_stack_height));
+    return execute_frame(instance, func_idx, stack, context, depth);
+}
+
+/// Calls the function with the arguments being the top items of the caller's operand stack
+/// outside of the interpreter loop.
+///
+/// This is used for the imported functions and the functions defined in a module which frames
+/// do not fit in the execution context stack space (see enter_function()). The latter trap,
+/// as executing them in separately allocated frames would need the native recursion.
+ExecutionResult call(
+    Instance& instance, FuncIdx func_idx, Value* args, ExecutionContext& context, int depth)
+{
+    if (depth > context.call_depth_limit())
+        return Trap;
+
+    assert(instance.module->imported_function_types.size() == instance.imported_functions.size());
+    if (func_idx < instance.imported_functions.size())
+    {
+#ifdef FIZZY_GUARD_PAGES
+        // The memory faults in the host function are not traps of the wasm code.
+        const MemoryFaultHandlerScope no_handler{nullptr};
+#endif
+        return instance.imported_functions[func_idx].function(instance, args, depth);
+    }
+
+    // The call stack space is exhausted.
+    return Trap;
+}
+
+/// Enters the function defined in the module (not imported) called by the currently executed one
+/// without leaving the interpreter loop.
+///
+/// The state of the calling function is saved in the execution context call frames and
+/// the operand stack is switched to the frame of the called function. The frame is placed at the
+/// call arguments on top of the caller's operand stack, or the arguments are copied to the free
+/// part of the execution context stack space if the caller's frame is not there.
+/// Returns the code of the called function to continue with, or nullptr if the function is
+/// imported or its frame does not fit in the stack space. The state is not changed then.
+///
+/// This is always inlined, as the cached top stack item can be kept in a register only if
+/// the stack is not passed to a function called by the interpreter loop.
+__attribute__((always_inline)) inline const Code* enter_function(const FuncType& func_type,
+    FuncIdx func_idx, const Instance& called_instance, ExecutionContext& context,
+    Instance* instance, const Code* code, const uint8_t* pc, InterpreterStack& stack)
+{
+    assert(called_instance.module->imported_function_types.size() ==
+           called_instance.imported_functions.size());
+    if (func_idx < called_instance.imported_functions.size())
+        return nullptr;
+
+    const auto num_args = func_type.inputs.size();
+    assert(stack.size() >= num_args);
+    const auto& called_code = called_instance.module->get_code(func_idx);
+    const auto frame_size = get_frame_size(num_args, called_code);
+
+    auto* const args = stack.rend() - num_args;
+    auto* frame = args;
+    if (!context.can_allocate(frame, frame_size))
+    {
+        frame = context.free_space();
+        if (!context.can_allocate(frame, frame_size))
+            return nullptr;
+        std::copy_n(args, num_args, frame);
+    }
+
+    stack.drop(num_args);
+    context.push_call_frame(instance, code, pc, stack.frame(), frame, frame_size);
+    stack.set_frame(frame, num_args, get_frame_local_count(called_code));
+    return &called_code;
+}
+
+/// Returns from the function entered with enter_function() to the calling function:
+/// switches the operand stack back to the caller's frame and pushes the result, if any.
+/// Returns the saved state of the calling function to continue with.
+inline const CallFrame& return_from_function(
+    ExecutionContext& context, InterpreterStack& stack) noexcept
+{
+    // NOTE: we can assume at most one result from validation.
+    assert(stack.size() <= 1);
+    const auto has_result = stack.size() != 0;
+    const auto result = has_result ? stack.top() : Value{};
+
+    const auto& call_frame = context.pop_call_frame();
+    stack.set_frame(call_frame.stack);
+
+    if (has_result)
+        stack.push(result);
+    return call_frame;
+}
+
+/// Calls the imported function, or the function defined in a module with the frame not fitting
+/// in the stack space, outside of the interpreter loop (see call()). Always inlined, like
+/// enter_function().
+/// Returns Void, or the result of the trapped (possibly interrupted) or pending call.
+__attribute__((always_inline)) inline ExecutionResult invoke_function(const FuncType& func_type,
+    uint32_t func_idx, Instance& instance, InterpreterStack& stack, ExecutionContext& context,
+    int depth)
 {
     const auto num_args = func_type.inputs.size();
     assert(stack.size() >= num_args);
     const auto call_args = stack.rend() - num_args;
 
-    const auto ret = execute(instance, func_idx, call_args, depth + 1);
+    const auto ret = call(instance, func_idx, call_args, context, depth + 1);
     // Bubble up traps
     if (ret.trapped)
-        return false;
+        return ret;
 
     stack.drop(num_args);
 
+    // The result of the pending host function call is pushed by complete_host_call().
+    if (ret.suspended)
+        return ret;
+
     const auto num_outputs = func_type.outputs.size();
     // NOTE: we can assume these two from validation
     assert(num_outputs <= 1);
@@ -496,85 +818,227 @@ inline bool invoke_function(const FuncType& func_type, uint32_t func_idx, Instan
     if (num_outputs != 0)
         stack.push(ret.value);
 
-    return true;
+    return Void;
 }
 
 }  // namespace
 
-ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args, int depth)
-{
-    assert(depth >= 0);
-    if (depth > CallStackLimit)
-        return Trap;
+#if FIZZY_COMPUTED_GOTO
+// The handler of each instruction jumps directly to the handler of the next one
+// (direct-threaded dispatch) instead of going back through the single indirect jump of the switch.
+// This uses the "labels as values" extension, which is not allowed by -Wpedantic.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define CASE(instr) \
+    case Instr::instr: \
+    op_##instr
+#define DISPATCH() goto* dispatch_table[*pc++]
+
+// The handlers of the dispatch table in the order of their opcodes; INVALID marks the opcodes
+// not in Instr. A new instruction must be put in its slot here.
+#define FIZZY_DISPATCH_TABLE(OP, INVALID) \
+    OP(unreachable), OP(nop), OP(block), OP(loop), OP(if_), OP(else_), INVALID, INVALID, \
+    INVALID, INVALID, INVALID, OP(end), OP(br), OP(br_if), OP(br_table), OP(return_), OP(call), \
+    OP(call_indirect), INVALID, INVALID, INVALID, INVALID, INVALID, INVALID, INVALID, INVALID, \
+    OP(drop), OP(select), INVALID, INVALID, INVALID, INVALID, OP(local_get), OP(local_set), \
+    OP(local_tee), OP(global_get), OP(global_set), INVALID, INVALID, INVALID, OP(i32_load), \
+    OP(i64_load), OP(f32_load), OP(f64_load), OP(i32_load8_s), OP(i32_load8_u), \
+    OP(i32_load16_s), OP(i32_load16_u), OP(i64_load8_s), OP(i64_load8_u), OP(i64_load16_s), \
+    OP(i64_load16_u), OP(i64_load32_s), OP(i64_load32_u), OP(i32_store), OP(i64_store), \
+    OP(f32_store), OP(f64_store), OP(i32_store8), OP(i32_store16), OP(i64_store8), \
+    OP(i64_store16), OP(i64_store32), OP(memory_size), OP(memory_grow), OP(i32_const), \
+    OP(i64_const), OP(f32_const), OP(f64_const), OP(i32_eqz), OP(i32_eq), OP(i32_ne), \
+    OP(i32_lt_s), OP(i32_lt_u), OP(i32_gt_s), OP(i32_gt_u), OP(i32_le_s), OP(i32_le_u), \
+    OP(i32_ge_s), OP(i32_ge_u), OP(i64_eqz), OP(i64_eq), OP(i64_ne), OP(i64_lt_s), OP(i64_lt_u), \
+    OP(i64_gt_s), OP(i64_gt_u), OP(i64_le_s), OP(i64_le_u), OP(i64_ge_s), OP(i64_ge_u), \
+    OP(f32_eq), OP(f32_ne), OP(f32_lt), OP(f32_gt), OP(f32_le), OP(f32_ge), OP(f64_eq), \
+    OP(f64_ne), OP(f64_lt), OP(f64_gt), OP(f64_le), OP(f64_ge), OP(i32_clz), OP(i32_ctz), \
+    OP(i32_popcnt), OP(i32_add), OP(i32_sub), OP(i32_mul), OP(i32_div_s), OP(i32_div_u), \
+    OP(i32_rem_s), OP(i32_rem_u), OP(i32_and), OP(i32_or), OP(i32_xor), OP(i32_shl), \
+    OP(i32_shr_s), OP(i32_shr_u), OP(i32_rotl), OP(i32_rotr), OP(i64_clz), OP(i64_ctz), \
+    OP(i64_popcnt), OP(i64_add), OP(i64_sub), OP(i64_mul), OP(i64_div_s), OP(i64_div_u), \
+    OP(i64_rem_s), OP(i64_rem_u), OP(i64_and), OP(i64_or), OP(i64_xor), OP(i64_shl), \
+    OP(i64_shr_s), OP(i64_shr_u), OP(i64_rotl), OP(i64_rotr), OP(f32_abs), OP(f32_neg), \
+    OP(f32_ceil), OP(f32_floor), OP(f32_trunc), OP(f32_nearest), OP(f32_sqrt), OP(f32_add), \
+    OP(f32_sub), OP(f32_mul), OP(f32_div), OP(f32_min), OP(f32_max), OP(f32_copysign), \
+    OP(f64_abs), OP(f64_neg), OP(f64_ceil), OP(f64_floor), OP(f64_trunc), OP(f64_nearest), \
+    OP(f64_sqrt), OP(f64_add), OP(f64_sub), OP(f64_mul), OP(f64_div), OP(f64_min), OP(f64_max), \
+    OP(f64_copysign), OP(i32_wrap_i64), OP(i32_trunc_f32_s), OP(i32_trunc_f32_u), \
+    OP(i32_trunc_f64_s), OP(i32_trunc_f64_u), OP(i64_extend_i32_s), OP(i64_extend_i32_u), \
+    OP(i64_trunc_f32_s), OP(i64_trunc_f32_u), OP(i64_trunc_f64_s), OP(i64_trunc_f64_u), \
+    OP(f32_convert_i32_s), OP(f32_convert_i32_u), OP(f32_convert_i64_s), OP(f32_convert_i64_u), \
+    OP(f32_demote_f64), OP(f64_convert_i32_s), OP(f64_convert_i32_u), OP(f64_convert_i64_s), \
+    OP(f64_convert_i64_u), OP(f64_promote_f32), OP(i32_reinterpret_f32), \
+    OP(i64_reinterpret_f64), OP(f32_reinterpret_i32), OP(f64_reinterpret_i64), \
+    OP(local_get_local_get_i32_add), OP(local_get_i32_load), OP(local_tee_local_get), \
+    OP(i32_eqz_br_if), OP(i32_eq_br_if), OP(i32_ne_br_if), OP(i32_lt_s_br_if), \
+    OP(i32_lt_u_br_if), OP(i32_gt_s_br_if), OP(i32_gt_u_br_if), OP(i32_le_s_br_if), \
+    OP(i32_le_u_br_if), OP(i32_ge_s_br_if), OP(i32_ge_u_br_if), INVALID, INVALID, \
+    OP(end_function), OP(br_no_drop), OP(br_if_no_drop), OP(br_void), OP(br_if_void), INVALID, \
+    INVALID, INVALID, INVALID, INVALID, INVALID, INVALID, INVALID, INVALID, INVALID, INVALID, \
+    OP(i32_add_imm), OP(i32_and_imm), OP(i32_or_imm), OP(i32_xor_imm), OP(i32_shl_imm), \
+    OP(i32_shr_s_imm), OP(i32_shr_u_imm), OP(i32_rotl_imm), OP(i32_rotr_imm), OP(i64_add_imm), \
+    OP(i64_and_imm), OP(i64_or_imm), OP(i64_xor_imm), OP(i64_shl_imm), OP(i64_shr_s_imm), \
+    OP(i64_shr_u_imm), OP(i64_rotl_imm), OP(i64_rotr_imm), INVALID, INVALID, INVALID, INVALID, \
+    INVALID, INVALID, OP(meter), INVALID, INVALID, INVALID, INVALID, INVALID, INVALID, INVALID
 
-    const auto& func_type = instance.module->get_function_type(func_idx);
+namespace
+{
+#define OPCODE(instr) static_cast<int>(Instr::instr)
+constexpr int dispatch_table_opcodes[256] = {FIZZY_DISPATCH_TABLE(OPCODE, -1)};
+#undef OPCODE
 
-    assert(instance.module->imported_function_types.size() == instance.imported_functions.size());
-    if (func_idx < instance.imported_functions.size())
-        return instance.imported_functions[func_idx].function(instance, args, depth);
+/// Checks that each handler of the dispatch table is in the slot of its instruction.
+constexpr bool is_dispatch_table_ordered() noexcept
+{
+    for (int opcode = 0; opcode < 256; ++opcode)
+    {
+        const auto handler_opcode = dispatch_table_opcodes[opcode];
+        if (handler_opcode != -1 && handler_opcode != opcode)
+            return false;
+    }
+    return true;
+}
+static_assert(is_dispatch_table_ordered(), "dispatch table order does not match Instr opcodes");
+}  // namespace
+#else
+#define CASE(instr) case Instr::instr
+#define DISPATCH() continue
+#endif
 
-    const auto& code = instance.module->get_code(func_idx);
-    auto* const memory = instance.memory.get();
+namespace
+{
+// The loop must not be inlined into execute_frame(), which may call sigsetjmp().
+//
+// If the suspended execution is given, the execution is suspended there when the gas runs out,
+// and it is continued from there if it has been suspended before. Then the context belongs
+// to this execution only.
+__attribute__((noinline)) ExecutionResult interpret(Instance& entry_instance, FuncIdx func_idx,
+    OperandStack& entry_stack, ExecutionContext& context, int depth, SuspendedExecution* suspended)
+{
+#if FIZZY_STACK_TOP_CACHING
+    CachedOperandStack stack{entry_stack};
+#else
+    auto& stack = entry_stack;
+#endif
+
+    // The state of the currently executed function. This changes when a function defined
+    // in a module is called or returns, as this is handled without leaving the loop.
+    auto* instance = &entry_instance;
+    const auto* code = &instance->module->get_code(func_idx);
+    const uint8_t* pc = code->instructions.data();
+
+    // The call frames below belong to the outer activations of the interpreter loop.
+    auto entry_call_frames = context.num_call_frames();
+
+    if (suspended != nullptr && suspended->pc != nullptr)
+    {
+        // The call frames of the functions called before the suspension are kept in the context.
+        instance = suspended->instance;
+        code = suspended->code;
+        pc = suspended->pc;
+        stack.set_frame(suspended->stack_frame);
+        depth = suspended->depth;
+        entry_call_frames = 0;
+    }
 
-    OperandStack stack(args, func_type.inputs.size(), code.local_count,
-        static_cast<size_t>(code.max_stack_height));
+    auto* memory = get_executed_memory(*instance);
 
-    const uint8_t* pc = code.instructions.data();
+#if FIZZY_COMPUTED_GOTO
+    // The addresses of instruction handlers indexed by opcode.
+#define HANDLER(instr) &&op_##instr
+    static const void* const dispatch_table[256] = {FIZZY_DISPATCH_TABLE(HANDLER, &&op_invalid)};
+#undef HANDLER
+#endif
 
     while (true)
     {
-        const auto instruction = static_cast<Instr>(*pc++);
-        switch (instruction)
+        switch (static_cast<Instr>(*pc++))
         {
-        case Instr::unreachable:
+        CASE(unreachable):
             goto trap;
-        case Instr::nop:
-        case Instr::block:
-        case Instr::loop:
-            break;
-        case Instr::if_:
+        CASE(meter):
+        {
+            const auto cost = read<int64_t>(pc);
+            if (!context.charge_gas(cost))
+            {
+                if (suspended == nullptr)
+                    goto trap;
+
+                // The basic block is charged again when the execution is resumed.
+                context.set_gas_left(context.gas_left() + cost);
+                pc -= 1 + sizeof(cost);
+                goto suspend;
+            }
+            DISPATCH();
+        }
+        CASE(nop):
+        CASE(block):
+        CASE(loop):
+            DISPATCH();
+        CASE(if_):
         {
             if (stack.pop().as<uint32_t>() != 0)
                 pc += sizeof(uint32_t);  // Skip the immediate for else instruction.
             else
             {
                 const auto target_pc = read<uint32_t>(pc);
-                pc = code.instructions.data() + target_pc;
+                pc = code->instructions.data() + target_pc;
             }
-            break;
+            DISPATCH();
         }
-        case Instr::else_:
+        CASE(else_):
         {
             // We reach else only after executing if block ("then" part),
             // so we need to skip else block now.
             const auto target_pc = read<uint32_t>(pc);
-            pc = code.instructions.data() + target_pc;
-            break;
-        }
-        case Instr::end:
-        {
-            // End execution if it's a final end instruction.
-            if (pc == &code.instructions[code.instructions.size()])
+            pc = code->instructions.data() + target_pc;
+            DISPATCH();
+        }
+        CASE(end):
+            // The code of the parsed function ends with end_function and does not contain other
+            // end instructions (see peephole_optimize()), but the final end is also supported.
+            if (pc != &code->instructions[code->instructions.size()])
+                DISPATCH();
+            [[fallthrough]];
+        CASE(end_function):
+        {
+            // End execution if it's the entry function, otherwise return to the calling function.
+            assert(pc == &code->instructions[code->instructions.size()]);
+            if (context.num_call_frames() == entry_call_frames)
                 goto end;
-            break;
+
+            const auto& call_frame = return_from_function(context, stack);
+            instance = call_frame.instance;
+            code = call_frame.code;
+            pc = call_frame.return_pc;
+            memory = get_executed_memory(*instance);
+            --depth;
+            DISPATCH();
         }
-        case Instr::br:
-        case Instr::br_if:
-        case Instr::return_:
+        CASE(br_if):
         {
-            const auto arity = read<uint32_t>(pc);
-
             // Check condition for br_if.
-            if (instruction == Instr::br_if && stack.pop().as<uint32_t>() == 0)
+            if (stack.pop().as<uint32_t>() == 0)
             {
-                pc += BranchImmediateSize;
-                break;
+                pc += sizeof(uint32_t) + BranchImmediateSize;  // Skip arity and branch immediates.
+                DISPATCH();
             }
 
-            branch(code, stack, pc, arity);
-            break;
+            const auto arity = read<uint32_t>(pc);
+            if (!branch(*code, stack, pc, arity, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(br):
+        CASE(return_):
+        {
+            const auto arity = read<uint32_t>(pc);
+            if (!branch(*code, stack, pc, arity, context))
+                goto interrupted;
+            DISPATCH();
         }
-        case Instr::br_table:
+        CASE(br_table):
         {
             const auto br_table_size = read<uint32_t>(pc);
             const auto arity = read<uint32_t>(pc);
@@ -586,51 +1050,101 @@ ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args,
                                               br_table_size * BranchImmediateSize;
             pc += label_idx_offset;
 
-            branch(code, stack, pc, arity);
-            break;
+            if (!branch(*code, stack, pc, arity, context))
+                goto interrupted;
+            DISPATCH();
         }
-        case Instr::call:
+        CASE(call):
         {
             const auto called_func_idx = read<uint32_t>(pc);
-            const auto& called_func_type = instance.module->get_function_type(called_func_idx);
+            const auto& called_func_type = instance->module->get_function_type(called_func_idx);
+
+            if (depth >= context.call_depth_limit())
+                goto trap;
+
+            if (context.interrupt_requested())
+                goto interrupted;
 
-            if (!invoke_function(called_func_type, called_func_idx, instance, stack, depth))
+            if (const auto* const called_code = enter_function(called_func_type, called_func_idx,
+                    *instance, context, instance, code, pc, stack))
+            {
+                code = called_code;
+                pc = code->instructions.data();
+                memory = get_executed_memory(*instance);
+                ++depth;
+                DISPATCH();
+            }
+
+            if (const auto ret = invoke_function(
+                    called_func_type, called_func_idx, *instance, stack, context, depth);
+                ret.trapped || ret.suspended)
+            {
+                if (ret.suspended)
+                    goto host_call_pending;
+                if (ret.interrupted)
+                    goto interrupted;
                 goto trap;
-            break;
+            }
+            DISPATCH();
         }
-        case Instr::call_indirect:
+        CASE(call_indirect):
         {
-            assert(instance.table != nullptr);
+            assert(instance->table != nullptr);
 
             const auto expected_type_idx = read<uint32_t>(pc);
-            assert(expected_type_idx < instance.module->typesec.size());
+            assert(expected_type_idx < instance->module->typesec.size());
 
             const auto elem_idx = stack.pop().as<uint32_t>();
-            if (elem_idx >= instance.table->size())
+            if (elem_idx >= instance->table->size())
                 goto trap;
 
-            const auto called_func = (*instance.table)[elem_idx];
+            const auto& called_func = (*instance->table)[elem_idx];
             if (!called_func.instance)  // Table element not initialized.
                 goto trap;
 
-            // check actual type against expected type
-            const auto& actual_type =
-                called_func.instance->module->get_function_type(called_func.func_idx);
-            const auto& expected_type = instance.module->typesec[expected_type_idx];
-            if (expected_type != actual_type)
+            // Check actual type against expected type by comparing their canonical identifiers.
+            const auto& called_module = *called_func.instance->module;
+            if (called_module.get_function_type_id(called_func.func_idx) !=
+                instance->module->typesec_ids[expected_type_idx])
                 goto trap;
 
-            if (!invoke_function(
-                    actual_type, called_func.func_idx, *called_func.instance, stack, depth))
+            const auto& actual_type = called_module.get_function_type(called_func.func_idx);
+
+            if (depth >= context.call_depth_limit())
                 goto trap;
-            break;
+
+            if (context.interrupt_requested())
+                goto interrupted;
+
+            if (const auto* const called_code = enter_function(actual_type, called_func.func_idx,
+                    *called_func.instance, context, instance, code, pc, stack))
+            {
+                instance = called_func.instance;
+                code = called_code;
+                pc = code->instructions.data();
+                memory = get_executed_memory(*instance);
+                ++depth;
+                DISPATCH();
+            }
+
+            if (const auto ret = invoke_function(actual_type, called_func.func_idx,
+                    *called_func.instance, stack, context, depth);
+                ret.trapped || ret.suspended)
+            {
+                if (ret.suspended)
+                    goto host_call_pending;
+                if (ret.interrupted)
+                    goto interrupted;
+                goto trap;
+            }
+            DISPATCH();
         }
-        case Instr::drop:
+        CASE(drop):
         {
             stack.pop();
-            break;
+            DISPATCH();
         }
-        case Instr::select:
+        CASE(select):
         {
             const auto condition = stack.pop().as<uint32_t>();
             // NOTE: these two are the same type (ensured by validation)
@@ -640,193 +1154,193 @@ ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args,
                 stack.push(val2);
             else
                 stack.push(val1);
-            break;
+            DISPATCH();
         }
-        case Instr::local_get:
+        CASE(local_get):
         {
             const auto idx = read<uint32_t>(pc);
             stack.push(stack.local(idx));
-            break;
+            DISPATCH();
         }
-        case Instr::local_set:
+        CASE(local_set):
         {
             const auto idx = read<uint32_t>(pc);
             stack.local(idx) = stack.pop();
-            break;
+            DISPATCH();
         }
-        case Instr::local_tee:
+        CASE(local_tee):
         {
             const auto idx = read<uint32_t>(pc);
             stack.local(idx) = stack.top();
-            break;
+            DISPATCH();
         }
-        case Instr::global_get:
+        CASE(global_get):
         {
             const auto idx = read<uint32_t>(pc);
-            assert(idx < instance.imported_globals.size() + instance.globals.size());
-            if (idx < instance.imported_globals.size())
+            assert(idx < instance->imported_globals.size() + instance->globals.size());
+            if (idx < instance->imported_globals.size())
             {
-                stack.push(*instance.imported_globals[idx].value);
+                stack.push(*instance->imported_globals[idx].value);
             }
             else
             {
-                const auto module_global_idx = idx - instance.imported_globals.size();
-                assert(module_global_idx < instance.module->globalsec.size());
-                stack.push(instance.globals[module_global_idx]);
+                const auto module_global_idx = idx - instance->imported_globals.size();
+                assert(module_global_idx < instance->module->globalsec.size());
+                stack.push(instance->globals[module_global_idx]);
             }
-            break;
+            DISPATCH();
         }
-        case Instr::global_set:
+        CASE(global_set):
         {
             const auto idx = read<uint32_t>(pc);
-            if (idx < instance.imported_globals.size())
+            if (idx < instance->imported_globals.size())
             {
-                assert(instance.imported_globals[idx].type.is_mutable);
-                *instance.imported_globals[idx].value = stack.pop();
+                assert(instance->imported_globals[idx].type.is_mutable);
+                *instance->imported_globals[idx].value = stack.pop();
             }
             else
             {
-                const auto module_global_idx = idx - instance.imported_globals.size();
-                assert(module_global_idx < instance.module->globalsec.size());
-                assert(instance.module->globalsec[module_global_idx].type.is_mutable);
-                instance.globals[module_global_idx] = stack.pop();
+                const auto module_global_idx = idx - instance->imported_globals.size();
+                assert(module_global_idx < instance->module->globalsec.size());
+                assert(instance->module->globalsec[module_global_idx].type.is_mutable);
+                instance->globals[module_global_idx] = stack.pop();
             }
-            break;
+            DISPATCH();
         }
-        case Instr::i32_load:
+        CASE(i32_load):
         {
             if (!load_from_memory<uint32_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_load:
+        CASE(i64_load):
         {
             if (!load_from_memory<uint64_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::f32_load:
+        CASE(f32_load):
         {
             if (!load_from_memory<float>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::f64_load:
+        CASE(f64_load):
         {
             if (!load_from_memory<double>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i32_load8_s:
+        CASE(i32_load8_s):
         {
             if (!load_from_memory<uint32_t, int8_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i32_load8_u:
+        CASE(i32_load8_u):
         {
             if (!load_from_memory<uint32_t, uint8_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i32_load16_s:
+        CASE(i32_load16_s):
         {
             if (!load_from_memory<uint32_t, int16_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i32_load16_u:
+        CASE(i32_load16_u):
         {
             if (!load_from_memory<uint32_t, uint16_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_load8_s:
+        CASE(i64_load8_s):
         {
             if (!load_from_memory<uint64_t, int8_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_load8_u:
+        CASE(i64_load8_u):
         {
             if (!load_from_memory<uint64_t, uint8_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_load16_s:
+        CASE(i64_load16_s):
         {
             if (!load_from_memory<uint64_t, int16_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_load16_u:
+        CASE(i64_load16_u):
         {
             if (!load_from_memory<uint64_t, uint16_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_load32_s:
+        CASE(i64_load32_s):
         {
             if (!load_from_memory<uint64_t, int32_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_load32_u:
+        CASE(i64_load32_u):
         {
             if (!load_from_memory<uint64_t, uint32_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i32_store:
+        CASE(i32_store):
         {
             if (!store_into_memory<uint32_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_store:
+        CASE(i64_store):
         {
             if (!store_into_memory<uint64_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::f32_store:
+        CASE(f32_store):
         {
             if (!store_into_memory<float>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::f64_store:
+        CASE(f64_store):
         {
             if (!store_into_memory<double>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i32_store8:
-        case Instr::i64_store8:
+        CASE(i32_store8):
+        CASE(i64_store8):
         {
             if (!store_into_memory<uint8_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i32_store16:
-        case Instr::i64_store16:
+        CASE(i32_store16):
+        CASE(i64_store16):
         {
             if (!store_into_memory<uint16_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_store32:
+        CASE(i64_store32):
         {
             if (!store_into_memory<uint32_t>(*memory, stack, pc))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::memory_size:
+        CASE(memory_size):
         {
             stack.push(static_cast<uint32_t>(memory->size() / PageSize));
-            break;
+            DISPATCH();
         }
-        case Instr::memory_grow:
+        CASE(memory_grow):
         {
             const auto delta = stack.pop().as<uint32_t>();
             const auto cur_pages = memory->size() / PageSize;
@@ -836,7 +1350,7 @@ ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args,
             uint32_t ret = static_cast<uint32_t>(cur_pages);
             try
             {
-                if (new_pages > instance.memory_pages_limit)
+                if (new_pages > instance->memory_pages_limit)
                     throw std::bad_alloc();
                 memory->resize(new_pages * PageSize);
             }
@@ -845,244 +1359,244 @@ ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args,
                 ret = static_cast<uint32_t>(-1);
             }
             stack.push(ret);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_const:
-        case Instr::f32_const:
+        CASE(i32_const):
+        CASE(f32_const):
         {
             const auto value = read<uint32_t>(pc);
             stack.push(value);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_const:
-        case Instr::f64_const:
+        CASE(i64_const):
+        CASE(f64_const):
         {
             const auto value = read<uint64_t>(pc);
             stack.push(value);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_eqz:
+        CASE(i32_eqz):
         {
             stack.top() = uint32_t{stack.top().as<uint32_t>() == 0};
-            break;
+            DISPATCH();
         }
-        case Instr::i32_eq:
+        CASE(i32_eq):
         {
             comparison_op(stack, std::equal_to<uint32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_ne:
+        CASE(i32_ne):
         {
             comparison_op(stack, std::not_equal_to<uint32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_lt_s:
+        CASE(i32_lt_s):
         {
             comparison_op(stack, std::less<int32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_lt_u:
+        CASE(i32_lt_u):
         {
             comparison_op(stack, std::less<uint32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_gt_s:
+        CASE(i32_gt_s):
         {
             comparison_op(stack, std::greater<int32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_gt_u:
+        CASE(i32_gt_u):
         {
             comparison_op(stack, std::greater<uint32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_le_s:
+        CASE(i32_le_s):
         {
             comparison_op(stack, std::less_equal<int32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_le_u:
+        CASE(i32_le_u):
         {
             comparison_op(stack, std::less_equal<uint32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_ge_s:
+        CASE(i32_ge_s):
         {
             comparison_op(stack, std::greater_equal<int32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_ge_u:
+        CASE(i32_ge_u):
         {
             comparison_op(stack, std::greater_equal<uint32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_eqz:
+        CASE(i64_eqz):
         {
             stack.top() = uint32_t{stack.top().i64 == 0};
-            break;
+            DISPATCH();
         }
-        case Instr::i64_eq:
+        CASE(i64_eq):
         {
             comparison_op(stack, std::equal_to<uint64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_ne:
+        CASE(i64_ne):
         {
             comparison_op(stack, std::not_equal_to<uint64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_lt_s:
+        CASE(i64_lt_s):
         {
             comparison_op(stack, std::less<int64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_lt_u:
+        CASE(i64_lt_u):
         {
             comparison_op(stack, std::less<uint64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_gt_s:
+        CASE(i64_gt_s):
         {
             comparison_op(stack, std::greater<int64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_gt_u:
+        CASE(i64_gt_u):
         {
             comparison_op(stack, std::greater<uint64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_le_s:
+        CASE(i64_le_s):
         {
             comparison_op(stack, std::less_equal<int64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_le_u:
+        CASE(i64_le_u):
         {
             comparison_op(stack, std::less_equal<uint64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_ge_s:
+        CASE(i64_ge_s):
         {
             comparison_op(stack, std::greater_equal<int64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_ge_u:
+        CASE(i64_ge_u):
         {
             comparison_op(stack, std::greater_equal<uint64_t>());
-            break;
+            DISPATCH();
         }
 
-        case Instr::f32_eq:
+        CASE(f32_eq):
         {
             comparison_op(stack, std::equal_to<float>());
-            break;
+            DISPATCH();
         }
-        case Instr::f32_ne:
+        CASE(f32_ne):
         {
             comparison_op(stack, std::not_equal_to<float>());
-            break;
+            DISPATCH();
         }
-        case Instr::f32_lt:
+        CASE(f32_lt):
         {
             comparison_op(stack, std::less<float>());
-            break;
+            DISPATCH();
         }
-        case Instr::f32_gt:
+        CASE(f32_gt):
         {
             comparison_op<float>(stack, std::greater<float>());
-            break;
+            DISPATCH();
         }
-        case Instr::f32_le:
+        CASE(f32_le):
         {
             comparison_op(stack, std::less_equal<float>());
-            break;
+            DISPATCH();
         }
-        case Instr::f32_ge:
+        CASE(f32_ge):
         {
             comparison_op(stack, std::greater_equal<float>());
-            break;
+            DISPATCH();
         }
 
-        case Instr::f64_eq:
+        CASE(f64_eq):
         {
             comparison_op(stack, std::equal_to<double>());
-            break;
+            DISPATCH();
         }
-        case Instr::f64_ne:
+        CASE(f64_ne):
         {
             comparison_op(stack, std::not_equal_to<double>());
-            break;
+            DISPATCH();
         }
-        case Instr::f64_lt:
+        CASE(f64_lt):
         {
             comparison_op(stack, std::less<double>());
-            break;
+            DISPATCH();
         }
-        case Instr::f64_gt:
+        CASE(f64_gt):
         {
             comparison_op<double>(stack, std::greater<double>());
-            break;
+            DISPATCH();
         }
-        case Instr::f64_le:
+        CASE(f64_le):
         {
             comparison_op(stack, std::less_equal<double>());
-            break;
+            DISPATCH();
         }
-        case Instr::f64_ge:
+        CASE(f64_ge):
         {
             comparison_op(stack, std::greater_equal<double>());
-            break;
+            DISPATCH();
         }
 
-        case Instr::i32_clz:
+        CASE(i32_clz):
         {
             unary_op(stack, clz32);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_ctz:
+        CASE(i32_ctz):
         {
             unary_op(stack, ctz32);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_popcnt:
+        CASE(i32_popcnt):
         {
             unary_op(stack, popcnt32);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_add:
+        CASE(i32_add):
         {
             binary_op(stack, add<uint32_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_sub:
+        CASE(i32_sub):
         {
             binary_op(stack, sub<uint32_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_mul:
+        CASE(i32_mul):
         {
             binary_op(stack, mul<uint32_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_div_s:
+        CASE(i32_div_s):
         {
             const auto rhs = stack.pop().as<int32_t>();
             const auto lhs = stack.top().as<int32_t>();
             if (rhs == 0 || (lhs == std::numeric_limits<int32_t>::min() && rhs == -1))
                 goto trap;
             stack.top() = div(lhs, rhs);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_div_u:
+        CASE(i32_div_u):
         {
             const auto rhs = stack.pop().as<uint32_t>();
             if (rhs == 0)
                 goto trap;
             const auto lhs = stack.top().as<uint32_t>();
             stack.top() = div(lhs, rhs);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_rem_s:
+        CASE(i32_rem_s):
         {
             const auto rhs = stack.pop().as<int32_t>();
             if (rhs == 0)
@@ -1092,107 +1606,107 @@ ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args,
                 stack.top() = 0;
             else
                 stack.top() = rem(lhs, rhs);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_rem_u:
+        CASE(i32_rem_u):
         {
             const auto rhs = stack.pop().as<uint32_t>();
             if (rhs == 0)
                 goto trap;
             const auto lhs = stack.top().as<uint32_t>();
             stack.top() = rem(lhs, rhs);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_and:
+        CASE(i32_and):
         {
             binary_op(stack, std::bit_and<uint32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_or:
+        CASE(i32_or):
         {
             binary_op(stack, std::bit_or<uint32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_xor:
+        CASE(i32_xor):
         {
             binary_op(stack, std::bit_xor<uint32_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i32_shl:
+        CASE(i32_shl):
         {
             binary_op(stack, shift_left<uint32_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_shr_s:
+        CASE(i32_shr_s):
         {
             binary_op(stack, shift_right<int32_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_shr_u:
+        CASE(i32_shr_u):
         {
             binary_op(stack, shift_right<uint32_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_rotl:
+        CASE(i32_rotl):
         {
             binary_op(stack, rotl<uint32_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_rotr:
+        CASE(i32_rotr):
         {
             binary_op(stack, rotr<uint32_t>);
-            break;
+            DISPATCH();
         }
 
-        case Instr::i64_clz:
+        CASE(i64_clz):
         {
             unary_op(stack, clz64);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_ctz:
+        CASE(i64_ctz):
         {
             unary_op(stack, ctz64);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_popcnt:
+        CASE(i64_popcnt):
         {
             unary_op(stack, popcnt64);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_add:
+        CASE(i64_add):
         {
             binary_op(stack, add<uint64_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_sub:
+        CASE(i64_sub):
         {
             binary_op(stack, sub<uint64_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_mul:
+        CASE(i64_mul):
         {
             binary_op(stack, mul<uint64_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_div_s:
+        CASE(i64_div_s):
         {
             const auto rhs = stack.pop().as<int64_t>();
             const auto lhs = stack.top().as<int64_t>();
             if (rhs == 0 || (lhs == std::numeric_limits<int64_t>::min() && rhs == -1))
                 goto trap;
             stack.top() = div(lhs, rhs);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_div_u:
+        CASE(i64_div_u):
         {
             const auto rhs = stack.pop().i64;
             if (rhs == 0)
                 goto trap;
             const auto lhs = stack.top().i64;
             stack.top() = div(lhs, rhs);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_rem_s:
+        CASE(i64_rem_s):
         {
             const auto rhs = stack.pop().as<int64_t>();
             if (rhs == 0)
@@ -1202,348 +1716,850 @@ ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args,
                 stack.top() = 0;
             else
                 stack.top() = rem(lhs, rhs);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_rem_u:
+        CASE(i64_rem_u):
         {
             const auto rhs = stack.pop().i64;
             if (rhs == 0)
                 goto trap;
             const auto lhs = stack.top().i64;
             stack.top() = rem(lhs, rhs);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_and:
+        CASE(i64_and):
         {
             binary_op(stack, std::bit_and<uint64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_or:
+        CASE(i64_or):
         {
             binary_op(stack, std::bit_or<uint64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_xor:
+        CASE(i64_xor):
         {
             binary_op(stack, std::bit_xor<uint64_t>());
-            break;
+            DISPATCH();
         }
-        case Instr::i64_shl:
+        CASE(i64_shl):
         {
             binary_op(stack, shift_left<uint64_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_shr_s:
+        CASE(i64_shr_s):
         {
             binary_op(stack, shift_right<int64_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_shr_u:
+        CASE(i64_shr_u):
         {
             binary_op(stack, shift_right<uint64_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_rotl:
+        CASE(i64_rotl):
         {
             binary_op(stack, rotl<uint64_t>);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_rotr:
+        CASE(i64_rotr):
         {
             binary_op(stack, rotr<uint64_t>);
-            break;
+            DISPATCH();
         }
 
-        case Instr::f32_abs:
+        CASE(f32_abs):
         {
             unary_op(stack, fabs<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_neg:
+        CASE(f32_neg):
         {
             unary_op(stack, fneg<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_ceil:
+        CASE(f32_ceil):
         {
             unary_op(stack, fceil<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_floor:
+        CASE(f32_floor):
         {
             unary_op(stack, ffloor<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_trunc:
+        CASE(f32_trunc):
         {
             unary_op(stack, ftrunc<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_nearest:
+        CASE(f32_nearest):
         {
             unary_op(stack, fnearest<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_sqrt:
+        CASE(f32_sqrt):
         {
             unary_op(stack, static_cast<float (*)(float)>(std::sqrt));
-            break;
+            DISPATCH();
         }
 
-        case Instr::f32_add:
+        CASE(f32_add):
         {
             binary_op(stack, add<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_sub:
+        CASE(f32_sub):
         {
             binary_op(stack, sub<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_mul:
+        CASE(f32_mul):
         {
             binary_op(stack, mul<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_div:
+        CASE(f32_div):
         {
             binary_op(stack, fdiv<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_min:
+        CASE(f32_min):
         {
             binary_op(stack, fmin<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_max:
+        CASE(f32_max):
         {
             binary_op(stack, fmax<float>);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_copysign:
+        CASE(f32_copysign):
         {
             binary_op(stack, fcopysign<float>);
-            break;
+            DISPATCH();
         }
 
-        case Instr::f64_abs:
+        CASE(f64_abs):
         {
             unary_op(stack, fabs<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_neg:
+        CASE(f64_neg):
         {
             unary_op(stack, fneg<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_ceil:
+        CASE(f64_ceil):
         {
             unary_op(stack, fceil<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_floor:
+        CASE(f64_floor):
         {
             unary_op(stack, ffloor<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_trunc:
+        CASE(f64_trunc):
         {
             unary_op(stack, ftrunc<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_nearest:
+        CASE(f64_nearest):
         {
             unary_op(stack, fnearest<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_sqrt:
+        CASE(f64_sqrt):
         {
             unary_op(stack, static_cast<double (*)(double)>(std::sqrt));
-            break;
+            DISPATCH();
         }
 
-        case Instr::f64_add:
+        CASE(f64_add):
         {
             binary_op(stack, add<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_sub:
+        CASE(f64_sub):
         {
             binary_op(stack, sub<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_mul:
+        CASE(f64_mul):
         {
             binary_op(stack, mul<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_div:
+        CASE(f64_div):
         {
             binary_op(stack, fdiv<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_min:
+        CASE(f64_min):
         {
             binary_op(stack, fmin<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_max:
+        CASE(f64_max):
         {
             binary_op(stack, fmax<double>);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_copysign:
+        CASE(f64_copysign):
         {
             binary_op(stack, fcopysign<double>);
-            break;
+            DISPATCH();
         }
 
-        case Instr::i32_wrap_i64:
+        CASE(i32_wrap_i64):
         {
             stack.top() = static_cast<uint32_t>(stack.top().i64);
-            break;
+            DISPATCH();
         }
-        case Instr::i32_trunc_f32_s:
+        CASE(i32_trunc_f32_s):
         {
             if (!trunc<float, int32_t>(stack))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i32_trunc_f32_u:
+        CASE(i32_trunc_f32_u):
         {
             if (!trunc<float, uint32_t>(stack))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i32_trunc_f64_s:
+        CASE(i32_trunc_f64_s):
         {
             if (!trunc<double, int32_t>(stack))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i32_trunc_f64_u:
+        CASE(i32_trunc_f64_u):
         {
             if (!trunc<double, uint32_t>(stack))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_extend_i32_s:
+        CASE(i64_extend_i32_s):
         {
             stack.top() = int64_t{stack.top().as<int32_t>()};
-            break;
+            DISPATCH();
         }
-        case Instr::i64_extend_i32_u:
+        CASE(i64_extend_i32_u):
         {
             // effectively no-op
-            break;
+            DISPATCH();
         }
-        case Instr::i64_trunc_f32_s:
+        CASE(i64_trunc_f32_s):
         {
             if (!trunc<float, int64_t>(stack))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_trunc_f32_u:
+        CASE(i64_trunc_f32_u):
         {
             if (!trunc<float, uint64_t>(stack))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_trunc_f64_s:
+        CASE(i64_trunc_f64_s):
         {
             if (!trunc<double, int64_t>(stack))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::i64_trunc_f64_u:
+        CASE(i64_trunc_f64_u):
         {
             if (!trunc<double, uint64_t>(stack))
                 goto trap;
-            break;
+            DISPATCH();
         }
-        case Instr::f32_convert_i32_s:
+        CASE(f32_convert_i32_s):
         {
             convert<int32_t, float>(stack);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_convert_i32_u:
+        CASE(f32_convert_i32_u):
         {
             convert<uint32_t, float>(stack);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_convert_i64_s:
+        CASE(f32_convert_i64_s):
         {
             convert<int64_t, float>(stack);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_convert_i64_u:
+        CASE(f32_convert_i64_u):
         {
             convert<uint64_t, float>(stack);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_demote_f64:
+        CASE(f32_demote_f64):
         {
-            stack.top() = demote(stack.top().f64);
-            break;
+            stack.top() = to_value(demote(stack.top().f64));
+            DISPATCH();
         }
-        case Instr::f64_convert_i32_s:
+        CASE(f64_convert_i32_s):
         {
             convert<int32_t, double>(stack);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_convert_i32_u:
+        CASE(f64_convert_i32_u):
         {
             convert<uint32_t, double>(stack);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_convert_i64_s:
+        CASE(f64_convert_i64_s):
         {
             convert<int64_t, double>(stack);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_convert_i64_u:
+        CASE(f64_convert_i64_u):
         {
             convert<uint64_t, double>(stack);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_promote_f32:
+        CASE(f64_promote_f32):
         {
             stack.top() = double{stack.top().f32};
-            break;
+            DISPATCH();
         }
-        case Instr::i32_reinterpret_f32:
+        CASE(i32_reinterpret_f32):
         {
             reinterpret<float, uint32_t>(stack);
-            break;
+            DISPATCH();
         }
-        case Instr::i64_reinterpret_f64:
+        CASE(i64_reinterpret_f64):
         {
             reinterpret<double, uint64_t>(stack);
-            break;
+            DISPATCH();
         }
-        case Instr::f32_reinterpret_i32:
+        CASE(f32_reinterpret_i32):
         {
             reinterpret<uint32_t, float>(stack);
-            break;
+            DISPATCH();
         }
-        case Instr::f64_reinterpret_i64:
+        CASE(f64_reinterpret_i64):
         {
             reinterpret<uint64_t, double>(stack);
-            break;
+            DISPATCH();
+        }
+
+        // Superinstructions. The opcodes of the fused instructions following the first one
+        // are still present in the code and must be skipped.
+        CASE(local_get_local_get_i32_add):
+        {
+            const auto idx1 = read<uint32_t>(pc);
+            ++pc;  // Skip the local_get opcode.
+            const auto idx2 = read<uint32_t>(pc);
+            ++pc;  // Skip the i32_add opcode.
+            stack.push(stack.local(idx1).as<uint32_t>() + stack.local(idx2).as<uint32_t>());
+            DISPATCH();
+        }
+        CASE(local_get_i32_load):
+        {
+            const auto idx = read<uint32_t>(pc);
+            ++pc;  // Skip the i32_load opcode.
+            stack.push(stack.local(idx));
+            if (!load_from_memory<uint32_t>(*memory, stack, pc))
+                goto trap;
+            DISPATCH();
+        }
+        CASE(local_tee_local_get):
+        {
+            const auto idx1 = read<uint32_t>(pc);
+            ++pc;  // Skip the local_get opcode.
+            const auto idx2 = read<uint32_t>(pc);
+            stack.local(idx1) = stack.top();
+            stack.push(stack.local(idx2));
+            DISPATCH();
+        }
+        CASE(i32_eqz_br_if):
+        {
+            const auto condition = stack.pop().as<uint32_t>() == 0;
+            if (!fused_br_if(*code, stack, pc, condition, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(i32_eq_br_if):
+        {
+            const auto condition = pop_comparison(stack, std::equal_to<uint32_t>());
+            if (!fused_br_if(*code, stack, pc, condition, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(i32_ne_br_if):
+        {
+            const auto condition = pop_comparison(stack, std::not_equal_to<uint32_t>());
+            if (!fused_br_if(*code, stack, pc, condition, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(i32_lt_s_br_if):
+        {
+            const auto condition = pop_comparison(stack, std::less<int32_t>());
+            if (!fused_br_if(*code, stack, pc, condition, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(i32_lt_u_br_if):
+        {
+            const auto condition = pop_comparison(stack, std::less<uint32_t>());
+            if (!fused_br_if(*code, stack, pc, condition, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(i32_gt_s_br_if):
+        {
+            const auto condition = pop_comparison(stack, std::greater<int32_t>());
+            if (!fused_br_if(*code, stack, pc, condition, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(i32_gt_u_br_if):
+        {
+            const auto condition = pop_comparison(stack, std::greater<uint32_t>());
+            if (!fused_br_if(*code, stack, pc, condition, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(i32_le_s_br_if):
+        {
+            const auto condition = pop_comparison(stack, std::less_equal<int32_t>());
+            if (!fused_br_if(*code, stack, pc, condition, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(i32_le_u_br_if):
+        {
+            const auto condition = pop_comparison(stack, std::less_equal<uint32_t>());
+            if (!fused_br_if(*code, stack, pc, condition, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(i32_ge_s_br_if):
+        {
+            const auto condition = pop_comparison(stack, std::greater_equal<int32_t>());
+            if (!fused_br_if(*code, stack, pc, condition, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(i32_ge_u_br_if):
+        {
+            const auto condition = pop_comparison(stack, std::greater_equal<uint32_t>());
+            if (!fused_br_if(*code, stack, pc, condition, context))
+                goto interrupted;
+            DISPATCH();
+        }
+
+        CASE(br_no_drop):
+        {
+            if (!branch_no_drop(*code, pc, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(br_if_no_drop):
+        {
+            if (stack.pop().as<uint32_t>() == 0)
+                pc += sizeof(uint32_t) + BranchImmediateSize;  // Skip arity and branch immediates.
+            else if (!branch_no_drop(*code, pc, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(br_void):
+        {
+            if (!branch_void(*code, stack, pc, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(br_if_void):
+        {
+            if (stack.pop().as<uint32_t>() == 0)
+                pc += sizeof(uint32_t) + BranchImmediateSize;  // Skip arity and branch immediates.
+            else if (!branch_void(*code, stack, pc, context))
+                goto interrupted;
+            DISPATCH();
+        }
+        CASE(i32_add_imm):
+        {
+            binary_op_imm(stack, pc, add<uint32_t>);
+            DISPATCH();
+        }
+        CASE(i32_and_imm):
+        {
+            binary_op_imm(stack, pc, std::bit_and<uint32_t>());
+            DISPATCH();
+        }
+        CASE(i32_or_imm):
+        {
+            binary_op_imm(stack, pc, std::bit_or<uint32_t>());
+            DISPATCH();
+        }
+        CASE(i32_xor_imm):
+        {
+            binary_op_imm(stack, pc, std::bit_xor<uint32_t>());
+            DISPATCH();
+        }
+        CASE(i32_shl_imm):
+        {
+            binary_op_imm(stack, pc, shift_left<uint32_t>);
+            DISPATCH();
+        }
+        CASE(i32_shr_s_imm):
+        {
+            binary_op_imm(stack, pc, shift_right<int32_t>);
+            DISPATCH();
+        }
+        CASE(i32_shr_u_imm):
+        {
+            binary_op_imm(stack, pc, shift_right<uint32_t>);
+            DISPATCH();
+        }
+        CASE(i32_rotl_imm):
+        {
+            binary_op_imm(stack, pc, rotl<uint32_t>);
+            DISPATCH();
+        }
+        CASE(i32_rotr_imm):
+        {
+            binary_op_imm(stack, pc, rotr<uint32_t>);
+            DISPATCH();
+        }
+        CASE(i64_add_imm):
+        {
+            binary_op_imm(stack, pc, add<uint64_t>);
+            DISPATCH();
+        }
+        CASE(i64_and_imm):
+        {
+            binary_op_imm(stack, pc, std::bit_and<uint64_t>());
+            DISPATCH();
+        }
+        CASE(i64_or_imm):
+        {
+            binary_op_imm(stack, pc, std::bit_or<uint64_t>());
+            DISPATCH();
+        }
+        CASE(i64_xor_imm):
+        {
+            binary_op_imm(stack, pc, std::bit_xor<uint64_t>());
+            DISPATCH();
+        }
+        CASE(i64_shl_imm):
+        {
+            binary_op_imm(stack, pc, shift_left<uint64_t>);
+            DISPATCH();
+        }
+        CASE(i64_shr_s_imm):
+        {
+            binary_op_imm(stack, pc, shift_right<int64_t>);
+            DISPATCH();
+        }
+        CASE(i64_shr_u_imm):
+        {
+            binary_op_imm(stack, pc, shift_right<uint64_t>);
+            DISPATCH();
+        }
+        CASE(i64_rotl_imm):
+        {
+            binary_op_imm(stack, pc, rotl<uint64_t>);
+            DISPATCH();
+        }
+        CASE(i64_rotr_imm):
+        {
+            binary_op_imm(stack, pc, rotr<uint64_t>);
+            DISPATCH();
         }
 
         default:
+#if FIZZY_COMPUTED_GOTO
+        op_invalid:
+#endif
             FIZZY_UNREACHABLE();
         }
     }
 
 end:
-    assert(pc == &code.instructions[code.instructions.size()]);  // End of code must be reached.
-    assert(stack.size() == instance.module->get_function_type(func_idx).outputs.size());
+    assert(pc == &code->instructions[code->instructions.size()]);  // End of code must be reached.
+    assert(stack.size() == instance->module->get_function_type(func_idx).outputs.size());
 
     return stack.size() != 0 ? ExecutionResult{stack.top()} : Void;
 
 trap:
+    context.drop_call_frames(entry_call_frames);
     return Trap;
+
+interrupted:
+    context.drop_call_frames(entry_call_frames);
+    return Interrupted;
+
+host_call_pending:
+    // Only the resumable execution can wait for the result of the host function.
+    if (suspended == nullptr)
+        goto trap;
+    suspended->host_call_pending = true;
+
+suspend:
+    assert(suspended != nullptr);
+    suspended->instance = instance;
+    suspended->code = code;
+    suspended->pc = pc;
+    suspended->stack_frame = stack.frame();
+    suspended->depth = depth;
+    return Suspended;
+}
+}  // namespace
+
+#undef CASE
+#undef DISPATCH
+#if FIZZY_COMPUTED_GOTO
+#undef FIZZY_DISPATCH_TABLE
+#pragma GCC diagnostic pop
+#endif
+
+namespace
+{
+/// Executes the function frame in the interpreter loop.
+///
+/// With guard pages, the out-of-bounds memory accesses of the executed code fault and
+/// the fault handler jumps back here, so the execution traps. The jump target is set
+/// outside of the interpreter loop to not affect its optimization.
+ExecutionResult execute_frame(Instance& instance, FuncIdx func_idx, OperandStack& stack,
+    ExecutionContext& context, int depth, SuspendedExecution* suspended)
+{
+#ifdef FIZZY_GUARD_PAGES
+    MemoryFaultHandler handler;
+    const MemoryFaultHandlerScope scope{&handler};
+    const auto entry_call_frames = context.num_call_frames();
+    if (sigsetjmp(handler.jump_buffer, 0) != 0)
+    {
+        context.drop_call_frames(entry_call_frames);
+        return Trap;
+    }
+#endif
+    return interpret(instance, func_idx, stack, context, depth, suspended);
+}
+
+/// Returns the frame size of the function defined in the module (not imported).
+size_t get_frame_size(const Instance& instance, FuncIdx func_idx) noexcept
+{
+    const auto num_args = instance.module->get_function_type(func_idx).inputs.size();
+    return get_frame_size(num_args, instance.module->get_code(func_idx));
+}
+
+/// Checks if the function defined in the module (not imported) can be executed with the fuel:
+/// the limited fuel runs out only in the metered code (see parse()).
+bool can_use_fuel(const Instance& instance, FuncIdx func_idx, int64_t fuel) noexcept
+{
+    if (fuel == ExecutionContext::UnlimitedGas)
+        return true;
+
+    // The metered code begins with the meter instruction of the first basic block.
+    const auto& instructions = instance.module->get_code(func_idx).instructions;
+    return !instructions.empty() && instructions[0] == static_cast<uint8_t>(Instr::meter);
+}
+}  // namespace
+
+namespace
+{
+thread_local std::unique_ptr<ExecutionContext> thread_execution_context;
+}  // namespace
+
+ExecutionContext& get_thread_execution_context()
+{
+    if (!thread_execution_context)
+        thread_execution_context = std::make_unique<ExecutionContext>();
+    return *thread_execution_context;
+}
+
+void reset_thread_execution_context(size_t stack_space_size, int call_depth_limit)
+{
+    assert(!thread_execution_context || thread_execution_context->num_call_frames() == 0);
+    thread_execution_context =
+        std::make_unique<ExecutionContext>(stack_space_size, call_depth_limit);
+}
+
+ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args, int depth)
+{
+    assert(depth >= 0);
+    auto& context = get_thread_execution_context();
+    if (depth > context.call_depth_limit())
+        return Trap;
+
+    // The interruption requested while nothing was executed is discarded.
+    if (depth == 0)
+        context.clear_interrupt();
+
+    assert(instance.module->imported_function_types.size() == instance.imported_functions.size());
+    const auto result =
+        (func_idx < instance.imported_functions.size()) ?
+            instance.imported_functions[func_idx].function(instance, args, depth) :
+            execute_with_args_copy(instance, func_idx, args, context, depth);
+
+    // The interruption request stops all the nested executions until the outermost one returns.
+    if (depth == 0)
+        context.clear_interrupt();
+
+    // The execution which is not resumable cannot wait for the host function call.
+    return result.suspended ? Trap : result;
+}
+
+SuspendedExecution::SuspendedExecution(Instance& _instance, FuncIdx func_idx, const Value* args)
+  : context{std::max(ExecutionContext::DefaultStackSpaceSize, get_frame_size(_instance, func_idx)),
+        get_thread_execution_context().call_depth_limit()},
+    stack{context.free_space(), 0, 0},
+    frame_guard{context, context.free_space(), get_frame_size(_instance, func_idx)},
+    entry_instance{_instance},
+    entry_func_idx{func_idx}
+{
+    const auto num_args = _instance.module->get_function_type(func_idx).inputs.size();
+    auto* const frame = stack.frame().locals;
+    std::copy_n(args, num_args, frame);
+    stack.set_frame(frame, num_args, get_frame_local_count(_instance.module->get_code(func_idx)));
+}
+
+void execute_batch(Instance& instance, FuncIdx func_idx, const Value* args_batch,
+    size_t batch_size, void (*sink)(void* sink_context, const ExecutionResult& result),
+    void* sink_context)
+{
+    const auto num_args = instance.module->get_function_type(func_idx).inputs.size();
+    auto& context = get_thread_execution_context();
+    context.clear_interrupt();
+
+    assert(instance.module->imported_function_types.size() == instance.imported_functions.size());
+    if (func_idx < instance.imported_functions.size())
+    {
+        const auto& function = instance.imported_functions[func_idx].function;
+        for (size_t i = 0; i < batch_size; ++i)
+        {
+            // The execution which is not resumable cannot wait for the host function call.
+            const auto result = function(instance, args_batch + i * num_args, 0);
+            sink(sink_context, result.suspended ? Trap : result);
+        }
+    }
+    else
+    {
+        const auto& code = instance.module->get_code(func_idx);
+        const auto frame_size = get_frame_size(num_args, code);
+        const auto local_count = get_frame_local_count(code);
+
+        auto* const frame = context.free_space();
+        if (context.can_allocate(frame, frame_size))
+        {
+            // All the executions reuse the same frame.
+            const ExecutionContext::FrameGuard guard{context, frame, frame_size};
+            for (size_t i = 0; i < batch_size; ++i)
+            {
+                std::copy_n(args_batch + i * num_args, num_args, frame);
+                OperandStack stack(frame, num_args, local_count);
+                sink(sink_context, execute_frame(instance, func_idx, stack, context, 0));
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < batch_size; ++i)
+            {
+                const auto result = execute_with_args_copy(
+                    instance, func_idx, args_batch + i * num_args, context, 0);
+                sink(sink_context, result);
+            }
+        }
+    }
+
+    context.clear_interrupt();
+}
+
+ExecutionResult execute(
+    Instance& instance, FuncIdx func_idx, const Value* args, int64_t& gas_left, int depth)
+{
+    auto& context = get_thread_execution_context();
+    const auto outer_gas_left = context.gas_left();
+    context.set_gas_left(gas_left);
+    const auto result = execute(instance, func_idx, args, depth);
+    gas_left = context.gas_left();
+    context.set_gas_left(outer_gas_left);
+    return result;
+}
+
+ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args, int64_t fuel,
+    ExecutionHandle& handle)
+{
+    assert(instance.module->imported_function_types.size() == instance.imported_functions.size());
+    if (func_idx < instance.imported_functions.size())
+    {
+        handle.reset();
+        // There is no interpreter state to suspend, so the host function call cannot be pending
+        // and execute() traps then.
+        return execute(instance, func_idx, args);
+    }
+
+    // The fuel would never run out in the code not metered.
+    if (!can_use_fuel(instance, func_idx, fuel))
+    {
+        handle.reset();
+        return Trap;
+    }
+
+    handle = std::make_unique<SuspendedExecution>(instance, func_idx, args);
+    handle->context.set_gas_left(0);
+    return resume(handle, fuel);
+}
+
+ExecutionResult resume(ExecutionHandle& handle, int64_t more_fuel)
+{
+    assert(handle != nullptr);
+    assert(!handle->host_call_pending);
+    assert(more_fuel >= 0);
+    auto& context = handle->context;
+
+    // The execution of the code not metered is suspended only at the host function calls,
+    // completed with no fuel (see complete_host_call()).
+    if (more_fuel != 0 && !can_use_fuel(handle->entry_instance, handle->entry_func_idx, more_fuel))
+    {
+        handle.reset();
+        return Trap;
+    }
+
+    // The gas left is never negative when suspended, but may be unlimited.
+    const auto gas_left = context.gas_left();
+    assert(gas_left >= 0);
+    context.set_gas_left(more_fuel <= ExecutionContext::UnlimitedGas - gas_left ?
+                             gas_left + more_fuel :
+                             ExecutionContext::UnlimitedGas);
+
+    // The private context of the execution checks the interruption requests of the thread
+    // running it. Each run is the outermost execution, so they are cleared as in execute().
+    auto& thread_context = get_thread_execution_context();
+    thread_context.clear_interrupt();
+    context.set_interrupt_source(thread_context);
+    const auto result = execute_frame(handle->entry_instance, handle->entry_func_idx,
+        handle->stack, context, handle->depth, handle.get());
+    context.set_interrupt_source(context);
+    thread_context.clear_interrupt();
+
+    if (!result.suspended)
+        handle.reset();
+    return result;
+}
+
+ExecutionResult complete_host_call(ExecutionHandle& handle, const ExecutionResult& call_result)
+{
+    assert(handle != nullptr);
+    assert(handle->host_call_pending);
+    assert(!call_result.suspended);
+
+    // Bubble up traps
+    if (call_result.trapped)
+    {
+        handle.reset();
+        return call_result.interrupted ? Interrupted : Trap;
+    }
+
+    handle->host_call_pending = false;
+    if (call_result.has_value)
+        *++handle->stack_frame.top = call_result.value;
+
+    return resume(handle, 0);
 }
 }  // namespace fizzy
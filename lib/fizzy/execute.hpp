@@ -6,6 +6,7 @@
 
 #include "cxx20/span.hpp"
 #include "exceptions.hpp"
+#include "execution_context.hpp"
 #include "instantiate.hpp"
 #include "limits.hpp"
 #include "module.hpp"
@@ -13,6 +14,7 @@
 #include "value.hpp"
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -24,6 +26,21 @@ struct ExecutionResult
     const bool trapped = false;
     const bool has_value = false;
     const Value value{};
+    /// Whether the execution has been interrupted (see ExecutionContext::interrupt()).
+    /// The interrupted execution is also trapped.
+    const bool interrupted = false;
+    /// Whether the execution has been suspended, to be continued with resume().
+    const bool suspended = false;
+
+    /// The tag of the "interrupted" state.
+    struct InterruptedTag
+    {
+    };
+
+    /// The tag of the "suspended" state.
+    struct SuspendedTag
+    {
+    };
 
     /// Constructs result with a value.
     constexpr ExecutionResult(Value _value) noexcept : has_value{true}, value{_value} {}
@@ -31,14 +48,119 @@ struct ExecutionResult
     /// Constructs result in "void" or "trap" state depending on the success flag.
     /// Prefer using Void and Trap constants instead.
     constexpr explicit ExecutionResult(bool success) noexcept : trapped{!success} {}
+
+    /// Constructs result in "interrupted" state. Prefer using Interrupted constant instead.
+    constexpr explicit ExecutionResult(InterruptedTag) noexcept : trapped{true}, interrupted{true}
+    {}
+
+    /// Constructs result in "suspended" state. Prefer using Suspended constant instead.
+    constexpr explicit ExecutionResult(SuspendedTag) noexcept : suspended{true} {}
 };
 
 constexpr ExecutionResult Void{true};
 constexpr ExecutionResult Trap{false};
+constexpr ExecutionResult Interrupted{ExecutionResult::InterruptedTag{}};
+constexpr ExecutionResult Suspended{ExecutionResult::SuspendedTag{}};
+
+/// The handle of the suspended execution, to be continued with resume().
+using ExecutionHandle = std::unique_ptr<SuspendedExecution>;
 
 // Execute a function on an instance.
+//
+// The execution can be interrupted from another thread with the interrupt() of the execution
+// context of the executing thread (see get_thread_execution_context()).
 ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args, int depth = 0);
 
+/// Executes a function on an instance once for each of the argument sets.
+///
+/// The results are the same as of execute() called for each argument set, but the setup
+/// of the function execution (e.g. the frame allocation) is done once for the whole batch.
+/// The interruption (see ExecutionContext::interrupt()) stops all the remaining executions.
+///
+/// @param args_batch    The argument sets placed one after another, each of them having
+///                      the number of the function inputs values. Can be nullptr if the function
+///                      has no inputs.
+/// @param batch_size    The number of the argument sets.
+/// @param sink          The function called with the result of each execution, in the order
+///                      of the argument sets.
+/// @param sink_context  The pointer passed to the sink.
+void execute_batch(Instance& instance, FuncIdx func_idx, const Value* args_batch,
+    size_t batch_size, void (*sink)(void* sink_context, const ExecutionResult& result),
+    void* sink_context);
+
+/// Executes a function on an instance once for each of the argument sets (see execute_batch()
+/// with the sink), writing the results to the output iterator in the order of the argument sets.
+/// Nothing is allocated for the results, e.g. they can be written to the caller's array.
+///
+/// @return  The output iterator past the last written result.
+template <typename OutputIt>
+OutputIt execute_batch(Instance& instance, FuncIdx func_idx, const Value* args_batch,
+    size_t batch_size, OutputIt results)
+{
+    execute_batch(
+        instance, func_idx, args_batch, batch_size,
+        [](void* it, const ExecutionResult& result) { *(*static_cast<OutputIt*>(it))++ = result; },
+        &results);
+    return results;
+}
+
+/// Executes a function on an instance with the gas budget for the metered code (see parse()).
+///
+/// The execution traps when the gas runs out. The budget is independent of the outer execution
+/// (e.g. when called from a host function). The execution without the gas budget is charged
+/// against the budget of the outer execution, or is not limited at the top level.
+///
+/// @param gas_left  The gas budget, updated with the gas left after the execution. It is negative
+///                  if the execution trapped because the gas ran out.
+ExecutionResult execute(
+    Instance& instance, FuncIdx func_idx, const Value* args, int64_t& gas_left, int depth = 0);
+
+/// Executes a function on an instance with the fuel for the metered code (see parse()),
+/// suspending the execution when the fuel runs out instead of trapping.
+///
+/// The suspended execution returns the Suspended result and the handle owning the whole
+/// interpreter state, so the execution can be continued later with resume(). The handle is reset
+/// when the execution ends. The execution of the code not metered traps unless the fuel is
+/// unlimited, because the fuel would never run out.
+///
+/// The execution is also suspended when a host function returns Suspended, so the host function
+/// call is pending until its result is passed to complete_host_call(). This way the host function
+/// can wait for e.g. I/O without blocking the thread. The other executions cannot wait for
+/// the host function call, so they trap then.
+///
+/// The functions executed by the host functions are not suspended, as their state includes
+/// the native stack of the host functions. They are not charged against the fuel.
+///
+/// The execution can be interrupted from another thread with the interrupt() of the execution
+/// context of the thread running it (see get_thread_execution_context()), like execute().
+/// The suspended execution is not affected by the requests made until it is resumed.
+///
+/// @param fuel    The gas budget (see execute() with gas_left). With the default cost table,
+///                this is the number of the instructions executed before the suspension.
+///                Use ExecutionContext::UnlimitedGas to suspend only at the host function calls.
+/// @param handle  Set to the handle of the suspended execution, or reset if the execution ended.
+ExecutionResult execute(Instance& instance, FuncIdx func_idx, const Value* args, int64_t fuel,
+    ExecutionHandle& handle);
+
+/// Continues the suspended execution (see execute() with the ExecutionHandle) with more fuel.
+/// The fuel left when the execution has been suspended is also used. The execution of the code
+/// not metered traps if more fuel is given.
+///
+/// @param handle     The handle of the suspended execution. Cannot be null. It is reset
+///                   when the execution ends, or kept if the execution is suspended again.
+/// @param more_fuel  The gas budget added to the gas left.
+ExecutionResult resume(ExecutionHandle& handle, int64_t more_fuel);
+
+/// Completes the pending host function call of the suspended execution (see execute() with
+/// the ExecutionHandle) with its result, and continues the execution.
+///
+/// @param handle       The handle of the execution suspended with the pending host function call.
+///                     It is reset when the execution ends, or kept if the execution is
+///                     suspended again.
+/// @param call_result  The result of the host function call: the value of the function result
+///                     type, Void, or Trap to make the execution trap.
+ExecutionResult complete_host_call(ExecutionHandle& handle, const ExecutionResult& call_result);
+
 inline ExecutionResult execute(
     Instance& instance, FuncIdx func_idx, std::initializer_list<Value> args)
 {
@@ -0,0 +1,296 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2019-2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "limits.hpp"
+#include "stack.hpp"
+#include "types.hpp"
+#include "value.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+namespace fizzy
+{
+struct Code;
+struct Instance;
+
+/// The state of a calling function saved when the called function is entered
+/// without leaving the interpreter loop.
+struct CallFrame
+{
+    /// The instance of the calling function.
+    Instance* instance;
+
+    /// The code of the calling function.
+    const Code* code;
+
+    /// The instruction of the calling function following the call.
+    const uint8_t* return_pc;
+
+    /// The operand stack frame of the calling function with the call arguments already dropped.
+    OperandStack::Frame stack;
+
+    /// The beginning of the free part of the stack space before the called function's frame
+    /// has been reserved.
+    Value* prev_free;
+};
+
+/// The storage shared by all wasm function frames executed in a single thread.
+///
+/// The context owns one contiguous stack space for arguments, local variables and operand stacks
+/// of the active frames. The space is reserved once and reused by all executions, so calls do not
+/// allocate memory. The frame of a called function is placed directly on top of the caller's
+/// operand stack, so the call arguments become the callee's local variables without copying.
+///
+/// The context also keeps the explicit call stack of the functions called by the interpreter
+/// without native recursion. The call depth is limited by the call depth limit of the context
+/// (CallStackLimit by default), independently of the native stack size. The called function
+/// which frame does not fit in the stack space traps instead of being executed with native
+/// recursion.
+///
+/// The execution of the metered code (see parse()) is charged against the gas budget held
+/// by the context.
+///
+/// The execution in the context can be interrupted from another thread with interrupt().
+class ExecutionContext
+{
+public:
+    /// The default size of the stack space as the number of values (4 MB).
+    static constexpr size_t DefaultStackSpaceSize = 512 * 1024;
+
+    /// The gas budget large enough to never run out in practice.
+    static constexpr int64_t UnlimitedGas = std::numeric_limits<int64_t>::max();
+
+private:
+    /// The stack space. The memory is not initialized, so the operating system commits it
+    /// only when it is actually used.
+    std::unique_ptr<Value[]> m_stack_space;
+
+    /// The end of the stack space.
+    Value* m_stack_space_end;
+
+    /// The beginning of the free part of the stack space.
+    /// All the space below is reserved by the active frames.
+    Value* m_free;
+
+    /// The maximum call depth of the executions in the context.
+    int m_call_depth_limit;
+
+    /// The call frames of the functions being executed in the interpreter loop.
+    /// The space for m_call_depth_limit frames is reserved, as each of them increases
+    /// the call depth.
+    std::unique_ptr<CallFrame[]> m_call_frames;
+
+    /// The number of the saved call frames.
+    size_t m_num_call_frames = 0;
+
+    /// The gas left for the execution of the metered code. Negative if the gas has run out.
+    int64_t m_gas_left = UnlimitedGas;
+
+    /// Whether the execution in the context has been requested to stop (see interrupt()).
+    std::atomic<bool> m_interrupt_requested{false};
+
+    /// The request to stop checked by the code executed in the context: the one of this context
+    /// or of the context the execution is run from (see set_interrupt_source()).
+    const std::atomic<bool>* m_interrupt_source = &m_interrupt_requested;
+
+public:
+    /// Reserves the frame space in the execution context for its lifetime.
+    class FrameGuard
+    {
+        ExecutionContext& m_context;
+        Value* const m_prev_free;
+
+    public:
+        /// Reserves the space of the given size starting at the frame pointer.
+        ///
+        /// The frame may start below the free space (e.g. at the arguments on top of the caller's
+        /// operand stack), then the free space is moved down as everything above the frame
+        /// is not used by the caller anymore.
+        FrameGuard(ExecutionContext& context, Value* frame, size_t frame_size) noexcept
+          : m_context{context}, m_prev_free{context.m_free}
+        {
+            assert(context.can_allocate(frame, frame_size));
+            context.m_free = frame + frame_size;
+        }
+
+        ~FrameGuard() noexcept { m_context.m_free = m_prev_free; }
+
+        FrameGuard(const FrameGuard&) = delete;
+        FrameGuard& operator=(const FrameGuard&) = delete;
+    };
+
+    /// @param stack_space_size  The size of the stack space as the number of values.
+    /// @param call_depth_limit  The maximum call depth of the executions in the context.
+    ///                          The call exceeding it traps.
+    explicit ExecutionContext(size_t stack_space_size = DefaultStackSpaceSize,
+        int call_depth_limit = CallStackLimit)
+      : m_stack_space{new Value[stack_space_size]},
+        m_stack_space_end{m_stack_space.get() + stack_space_size},
+        m_free{m_stack_space.get()},
+        m_call_depth_limit{call_depth_limit},
+        m_call_frames{new CallFrame[static_cast<size_t>(call_depth_limit)]}
+    {
+        assert(call_depth_limit >= 0);
+    }
+
+    ExecutionContext(const ExecutionContext&) = delete;
+    ExecutionContext& operator=(const ExecutionContext&) = delete;
+
+    /// The beginning of the free part of the stack space.
+    Value* free_space() const noexcept { return m_free; }
+
+    /// Checks if the frame of the given size starting at the frame pointer fits
+    /// in the stack space.
+    bool can_allocate(const Value* frame, size_t frame_size) const noexcept
+    {
+        return frame >= m_stack_space.get() && frame <= m_stack_space_end &&
+               frame_size <= static_cast<size_t>(m_stack_space_end - frame);
+    }
+
+    /// The maximum call depth of the executions in the context.
+    int call_depth_limit() const noexcept { return m_call_depth_limit; }
+
+    /// The number of the saved call frames.
+    size_t num_call_frames() const noexcept { return m_num_call_frames; }
+
+    /// The gas left for the execution of the metered code. Negative if the gas has run out.
+    int64_t gas_left() const noexcept { return m_gas_left; }
+
+    /// Sets the gas budget for the execution of the metered code.
+    void set_gas_left(int64_t gas_left) noexcept { m_gas_left = gas_left; }
+
+    /// Charges the cost of the basic block of the metered code.
+    /// Returns false if the gas has run out, then the execution must trap.
+    bool charge_gas(int64_t cost) noexcept
+    {
+        m_gas_left -= cost;
+        return m_gas_left >= 0;
+    }
+
+    /// Requests the execution in the context to stop. Can be called from any thread.
+    ///
+    /// The executed code checks the request only at the loop back-edges and function calls,
+    /// then the execution ends with the Interrupted result, including all the nested executions
+    /// (e.g. called from host functions). The request is cleared when the outermost execution
+    /// starts and returns, so the request made while nothing is being executed has no effect.
+    void interrupt() noexcept { m_interrupt_requested.store(true, std::memory_order_relaxed); }
+
+    /// Checks if the execution in the context has been requested to stop.
+    bool interrupt_requested() const noexcept
+    {
+        return m_interrupt_source->load(std::memory_order_relaxed);
+    }
+
+    /// Makes the execution in the context stop on the requests to interrupt the source context,
+    /// instead of its own ones. Used by the resumable executions, which have private contexts,
+    /// to be interrupted with the context of the thread running them.
+    void set_interrupt_source(const ExecutionContext& source) noexcept
+    {
+        m_interrupt_source = &source.m_interrupt_requested;
+    }
+
+    /// Clears the request to stop the execution.
+    void clear_interrupt() noexcept
+    {
+        m_interrupt_requested.store(false, std::memory_order_relaxed);
+    }
+
+    /// Saves the calling function state and reserves the frame of the called function
+    /// starting at the frame pointer. The frame must fit in the stack space.
+    void push_call_frame(Instance* instance, const Code* code, const uint8_t* return_pc,
+        const OperandStack::Frame& stack, Value* frame, size_t frame_size) noexcept
+    {
+        assert(can_allocate(frame, frame_size));
+        assert(m_num_call_frames < static_cast<size_t>(m_call_depth_limit));
+        m_call_frames[m_num_call_frames++] = {instance, code, return_pc, stack, m_free};
+        m_free = frame + frame_size;
+    }
+
+    /// Releases the called function's frame and returns the saved state of the calling function.
+    /// The returned reference is valid until the next push_call_frame().
+    const CallFrame& pop_call_frame() noexcept
+    {
+        assert(m_num_call_frames != 0);
+        const auto& call_frame = m_call_frames[--m_num_call_frames];
+        m_free = call_frame.prev_free;
+        return call_frame;
+    }
+
+    /// Drops the call frames above the given number and releases their space
+    /// without restoring the calling functions. Used when the execution traps.
+    void drop_call_frames(size_t num_call_frames) noexcept
+    {
+        assert(num_call_frames <= m_num_call_frames);
+        if (num_call_frames == m_num_call_frames)
+            return;
+        m_free = m_call_frames[num_call_frames].prev_free;
+        m_num_call_frames = num_call_frames;
+    }
+};
+
+/// Returns the execution context of the current thread.
+ExecutionContext& get_thread_execution_context();
+
+/// Replaces the execution context of the current thread with the new one of the given stack space
+/// size and call depth limit (see ExecutionContext()), e.g. to limit the call depth of the code
+/// executed by execute(). The resumable executions started afterwards in the thread get the same
+/// call depth limit. Must not be called while an execution is in progress in the thread.
+/// The references to the previous context (e.g. kept to interrupt it) become invalid.
+void reset_thread_execution_context(size_t stack_space_size, int call_depth_limit);
+
+/// The execution suspended in the interpreter loop (see resume() and complete_host_call()).
+///
+/// The execution owns its context, so the operand stacks and the call frames of the executed
+/// functions stay in place while other executions run, and it can be resumed in any thread.
+/// Only the position in the currently executed function is saved when the execution is suspended.
+struct SuspendedExecution
+{
+    /// The execution context used only by this execution.
+    ExecutionContext context;
+
+    /// The operand stack of the entry function, placed at the beginning of the stack space.
+    OperandStack stack;
+
+    /// Reserves the frame of the entry function in the context stack space.
+    ExecutionContext::FrameGuard frame_guard;
+
+    /// The instance of the entry function.
+    Instance& entry_instance;
+
+    /// The index of the entry function.
+    const FuncIdx entry_func_idx;
+
+    /// The instance of the function being executed when suspended.
+    Instance* instance = nullptr;
+
+    /// The code of the function being executed when suspended.
+    const Code* code = nullptr;
+
+    /// The instruction to continue with, or nullptr if the execution has not started yet.
+    const uint8_t* pc = nullptr;
+
+    /// The operand stack frame of the function being executed when suspended.
+    OperandStack::Frame stack_frame{};
+
+    /// The call depth of the function being executed when suspended.
+    int depth = 0;
+
+    /// Whether the execution waits for the result of the host function call
+    /// (see complete_host_call()).
+    bool host_call_pending = false;
+
+    /// Prepares the execution of the function defined in the module (not imported)
+    /// with the given arguments.
+    SuspendedExecution(Instance& _instance, FuncIdx func_idx, const Value* args);
+
+    SuspendedExecution(const SuspendedExecution&) = delete;
+    SuspendedExecution& operator=(const SuspendedExecution&) = delete;
+};
+}  // namespace fizzy
@@ -0,0 +1,29 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include <setjmp.h>
+#include <cstdint>
+
+namespace fizzy
+{
+/// The handler of the faults caused by accessing the guard pages of a linear memory
+/// by the wasm code executed in the current thread. Used when Fizzy is built with guard pages.
+struct MemoryFaultHandler
+{
+    /// The execution state to jump back to when the fault happens, set with sigsetjmp().
+    sigjmp_buf jump_buffer;
+
+    /// The data of the linear memory accessed by the executed code or nullptr.
+    /// Only the faults inside this memory's reservation are handled.
+    const uint8_t* memory_data = nullptr;
+};
+
+/// Returns the reference to the memory fault handler of the current thread, nullptr if none.
+/// The SIGSEGV signal handler installed by the first LinearMemory with guard pages jumps
+/// to the state saved in this handler when the fault address is in its memory reservation.
+/// Otherwise, the fault is passed to the signal action installed before.
+MemoryFaultHandler*& current_memory_fault_handler() noexcept;
+}  // namespace fizzy
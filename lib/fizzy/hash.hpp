@@ -0,0 +1,32 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "bytes.hpp"
+#include <cstdint>
+#include <cstring>
+
+namespace fizzy
+{
+constexpr uint64_t HashSeed = 0xcbf29ce484222325;
+
+/// Returns the 64-bit FNV-1a-like hash of the bytes, taking 8 bytes at a time.
+/// This is not a cryptographic hash: the files checked with it are trusted.
+inline uint64_t hash_bytes(bytes_view data, uint64_t hash = HashSeed) noexcept
+{
+    constexpr uint64_t prime = 0x100000001b3;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= data.size(); i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, &data[i], sizeof(word));
+        hash = (hash ^ word) * prime;
+        hash ^= hash >> 32;
+    }
+    for (; i < data.size(); ++i)
+        hash = (hash ^ data[i]) * prime;
+    return hash;
+}
+}  // namespace fizzy
@@ -0,0 +1,153 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "instance_pool.hpp"
+#include <cassert>
+#include <new>
+#include <vector>
+
+namespace fizzy
+{
+InstancePool::InstancePool(Factory factory, size_t size)
+  : m_factory{std::move(factory)},
+    m_size{size},
+    m_ready{new std::atomic<Instance*>[size]},
+    m_released{new std::atomic<Instance*>[size]}
+{
+    std::vector<std::unique_ptr<Instance>> instances(size);
+    for (auto& instance : instances)
+        instance = create_instance();
+
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        m_ready[i] = instances[i].release();
+        m_released[i] = nullptr;
+    }
+
+    m_recycler = std::thread{[this] { recycle(); }};
+}
+
+InstancePool::~InstancePool() noexcept
+{
+    {
+        const std::lock_guard lock{m_mutex};
+        m_stopping = true;
+    }
+    m_wakeup.notify_one();
+    m_recycler.join();
+
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        delete m_ready[i].load();
+        delete m_released[i].load();
+    }
+}
+
+std::unique_ptr<Instance> InstancePool::acquire()
+{
+    if (auto* const instance = take(m_ready); instance != nullptr)
+        return std::unique_ptr<Instance>{instance};
+
+    return create_instance();
+}
+
+void InstancePool::release(std::unique_ptr<Instance> instance)
+{
+    assert(instance->snapshot != nullptr);
+
+    if (!put(m_released, instance.get()))
+    {
+        m_num_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    instance.release();
+
+    // The lock is only taken not to lose the wakeup of the background thread going to sleep.
+    {
+        const std::lock_guard lock{m_mutex};
+        m_released_pending = true;
+    }
+    m_wakeup.notify_one();
+}
+
+size_t InstancePool::num_ready() const noexcept
+{
+    size_t num_ready = 0;
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        if (m_ready[i].load(std::memory_order_relaxed) != nullptr)
+            ++num_ready;
+    }
+    return num_ready;
+}
+
+std::unique_ptr<Instance> InstancePool::create_instance()
+{
+    auto instance = m_factory();
+    snapshot_instance(*instance);
+    return instance;
+}
+
+bool InstancePool::put(const Slots& slots, Instance* instance) noexcept
+{
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        Instance* empty = nullptr;
+        if (slots[i].load(std::memory_order_relaxed) == nullptr &&
+            slots[i].compare_exchange_strong(empty, instance, std::memory_order_release))
+            return true;
+    }
+    return false;
+}
+
+Instance* InstancePool::take(const Slots& slots) noexcept
+{
+    for (size_t i = 0; i < m_size; ++i)
+    {
+        if (slots[i].load(std::memory_order_relaxed) != nullptr)
+        {
+            if (auto* const instance = slots[i].exchange(nullptr, std::memory_order_acquire);
+                instance != nullptr)
+                return instance;
+        }
+    }
+    return nullptr;
+}
+
+void InstancePool::recycle() noexcept
+{
+    std::unique_lock lock{m_mutex};
+    while (true)
+    {
+        m_wakeup.wait(lock, [this] { return m_released_pending || m_stopping; });
+        if (m_stopping)
+            return;
+        m_released_pending = false;
+        lock.unlock();
+
+        while (auto* const released = take(m_released))
+        {
+            std::unique_ptr<Instance> instance{released};
+            try
+            {
+                reset_instance(*instance);
+            }
+            catch (const std::bad_alloc&)
+            {
+                // The instance which cannot be reset is dropped. The next one is created
+                // by acquire() when the pool runs out of instances.
+                m_num_dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            if (put(m_ready, instance.get()))
+                instance.release();
+            else
+                m_num_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        lock.lock();
+    }
+}
+}  // namespace fizzy
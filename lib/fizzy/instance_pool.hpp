@@ -0,0 +1,96 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "instantiate.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace fizzy
+{
+/// The pool of instances ready to execute, which takes the instantiation off the execution path.
+///
+/// The pool creates the instances up front and saves their state with snapshot_instance().
+/// The instance released to the pool is reset to this state by the background thread and can be
+/// acquired again. The instances are acquired and released without locking: the pool keeps them
+/// in arrays of slots updated with atomic operations.
+class InstancePool
+{
+public:
+    /// The function creating the instances, usually calling instantiate() with the imports.
+    /// It may be called concurrently by the threads acquiring the instances.
+    using Factory = std::function<std::unique_ptr<Instance>()>;
+
+    /// Creates the pool of the given number of instances.
+    /// Throws the exceptions of the factory.
+    InstancePool(Factory factory, size_t size);
+
+    /// Stops the background thread and destroys the instances in the pool.
+    /// The acquired instances are not affected.
+    ~InstancePool() noexcept;
+
+    InstancePool(const InstancePool&) = delete;
+    InstancePool& operator=(const InstancePool&) = delete;
+
+    /// Takes an instance ready to execute out of the pool. If none is ready, creates a new one.
+    /// Throws the exceptions of the factory.
+    std::unique_ptr<Instance> acquire();
+
+    /// Returns the instance acquired from the pool, to be reset in the background and acquired
+    /// again. The instance is destroyed if the pool is full (see num_dropped()).
+    /// Throws std::system_error if the background thread cannot be woken up, then the instance
+    /// stays in the pool and is reset after the next release.
+    void release(std::unique_ptr<Instance> instance);
+
+    /// Returns the number of instances ready to be acquired.
+    size_t num_ready() const noexcept;
+
+    /// Returns the number of the released instances destroyed instead of being acquired again,
+    /// because the pool was full or they could not be reset. Many of them indicate the pool
+    /// is too small for the number of instances used at once.
+    size_t num_dropped() const noexcept { return m_num_dropped.load(std::memory_order_relaxed); }
+
+private:
+    using Slots = std::unique_ptr<std::atomic<Instance*>[]>;
+
+    /// Creates the instance and saves its state.
+    std::unique_ptr<Instance> create_instance();
+
+    /// Puts the instance in an empty slot. Returns false if all slots are taken.
+    bool put(const Slots& slots, Instance* instance) noexcept;
+
+    /// Takes an instance out of its slot. Returns nullptr if all slots are empty.
+    Instance* take(const Slots& slots) noexcept;
+
+    /// The loop of the background thread resetting the released instances.
+    void recycle() noexcept;
+
+    Factory m_factory;
+
+    /// The number of slots in each array.
+    size_t m_size = 0;
+
+    /// The instances ready to be acquired, nullptr in empty slots.
+    Slots m_ready;
+
+    /// The released instances waiting to be reset, nullptr in empty slots.
+    Slots m_released;
+
+    /// The number of the released instances destroyed (see num_dropped()).
+    std::atomic<size_t> m_num_dropped{0};
+
+    /// Wakes the background thread up when an instance is released or the pool is destroyed.
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    bool m_released_pending = false;
+    bool m_stopping = false;
+
+    std::thread m_recycler;
+};
+}  // namespace fizzy
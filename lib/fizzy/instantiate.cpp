@@ -4,8 +4,10 @@
 
 #include "instantiate.hpp"
 #include "execute.hpp"  // needed for table elements initialization
+#include "hash.hpp"
 #include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
 
 namespace fizzy
@@ -162,11 +164,11 @@ std::tuple<table_ptr, Limits> allocate_table(
         return {table_ptr{nullptr, null_delete}, Limits{}};
 }
 
-std::tuple<bytes_ptr, Limits> allocate_memory(const std::vector<Memory>& module_memories,
+std::tuple<memory_ptr, Limits> allocate_memory(const std::vector<Memory>& module_memories,
     const std::vector<ExternalMemory>& imported_memories, uint32_t memory_pages_limit)
 {
-    static const auto bytes_delete = [](bytes* b) noexcept { delete b; };
-    static const auto null_delete = [](bytes*) noexcept {};
+    static const auto memory_delete = [](LinearMemory* m) noexcept { delete m; };
+    static const auto null_delete = [](LinearMemory*) noexcept {};
 
     assert(module_memories.size() + imported_memories.size() <= 1);
 
@@ -183,8 +185,13 @@ std::tuple<bytes_ptr, Limits> allocate_memory(const std::vector<Memory>& module_
                                     std::to_string(memory_pages_limit * PageSize) + " bytes"};
         }
 
-        // NOTE: fill it with zeroes
-        bytes_ptr memory{new bytes(memory_min * PageSize, 0), bytes_delete};
+        // NOTE: it is filled with zeroes
+        // The address space for the memory of the maximum size is reserved up front,
+        // so memory.grow never moves the memory.
+        const auto memory_max_pages = memory_max.value_or(memory_pages_limit);
+        memory_ptr memory{new LinearMemory(size_t{memory_min} * PageSize,
+                              size_t{memory_max_pages} * PageSize),
+            memory_delete};
         return {std::move(memory), module_memories[0].limits};
     }
     else if (imported_memories.size() == 1)
@@ -200,12 +207,12 @@ std::tuple<bytes_ptr, Limits> allocate_memory(const std::vector<Memory>& module_
                                     std::to_string(memory_pages_limit * PageSize) + " bytes"};
         }
 
-        bytes_ptr memory{imported_memories[0].data, null_delete};
+        memory_ptr memory{imported_memories[0].data, null_delete};
         return {std::move(memory), imported_memories[0].limits};
     }
     else
     {
-        bytes_ptr memory{nullptr, null_delete};
+        memory_ptr memory{nullptr, null_delete};
         return {std::move(memory), Limits{}};
     }
 }
@@ -227,6 +234,52 @@ Value eval_constant_expression(ConstantExpression expr,
         return globals[global_idx - imported_globals.size()];
 }
 
+// The minimal total size of the data segments for which the memory image is built.
+// The smaller segments touch at most a couple of OS pages, which are as cheap to copy into each
+// instance as to copy on write, and don't need the memory file.
+constexpr size_t MinMemoryImageDataSize = LinearMemory::DirtyPageSize;
+
+// Returns the memory with the data segments applied, shared by the instances of the module,
+// or nullptr if the data segments are to be copied into each instance.
+std::shared_ptr<const MemoryImage> get_memory_image(const Module& module)
+{
+    if (auto image = std::atomic_load(&module.memory_image); image != nullptr)
+        return image;
+
+    // The image can be built only for the memory defined in the module and the data segments
+    // with the offsets not depending on the imported globals.
+    if (module.memorysec.empty())
+        return nullptr;
+
+    size_t data_size = 0;
+    uint64_t image_size = 0;
+    for (const auto& data : module.datasec)
+    {
+        if (data.offset.kind != ConstantExpression::Kind::Constant)
+            return nullptr;
+        data_size += data.init.size();
+        image_size = std::max(image_size, data.offset.value.constant.i64 + data.init.size());
+    }
+    // The segments out of memory bounds are reported by instantiate().
+    if (data_size < MinMemoryImageDataSize ||
+        image_size > uint64_t{module.memorysec[0].limits.min} * PageSize)
+        return nullptr;
+
+    bytes content(static_cast<size_t>(image_size), 0);
+    for (const auto& data : module.datasec)
+    {
+        std::copy(data.init.begin(), data.init.end(),
+            content.begin() + static_cast<ptrdiff_t>(data.offset.value.constant.i64));
+    }
+
+    // When instantiated concurrently, the image built first is shared.
+    std::shared_ptr<const MemoryImage> image = std::make_shared<MemoryImage>(content);
+    std::shared_ptr<const MemoryImage> expected;
+    if (!std::atomic_compare_exchange_strong(&module.memory_image, &expected, image))
+        return expected;
+    return image;
+}
+
 std::optional<uint32_t> find_export(const Module& module, ExternalKind kind, std::string_view name)
 {
     const auto it = std::find_if(module.exportsec.begin(), module.exportsec.end(),
@@ -235,14 +288,55 @@ std::optional<uint32_t> find_export(const Module& module, ExternalKind kind, std
     return (it != module.exportsec.end() ? std::make_optional(it->index) : std::nullopt);
 }
 
+
+// The magic number and the version of the instance image format.
+constexpr uint8_t ImageMagic[]{'f', 'i', 'z', 'z', 'y', 'i', 'm', 'g'};
+constexpr uint32_t ImageVersion = 2;
+// The function index of the null table element in the image.
+constexpr uint32_t ImageNullElement = 0xffffffff;
+
+// The header of the instance image file. It is followed by the values of the globals, the function
+// indices of the table elements and, at the offset aligned to PageSize so that it can be mapped,
+// the memory. The values are stored in the native byte order.
+struct ImageHeader
+{
+    uint8_t magic[sizeof(ImageMagic)];
+    uint32_t version;
+    uint32_t num_functions;
+    uint32_t num_globals;
+    uint32_t table_size;
+    uint64_t memory_size;
+    uint64_t memory_offset;
+    // The hash of the wasm binary of the module.
+    uint64_t binary_hash;
+};
+
+using file_ptr = std::unique_ptr<std::FILE, int (*)(std::FILE*)>;
+
+file_ptr open_file(const std::string& path, const char* mode)
+{
+    return {std::fopen(path.c_str(), mode), [](std::FILE* file) { return std::fclose(file); }};
+}
+
+template <typename T>
+bool write_items(std::FILE* file, const T* items, size_t count)
+{
+    return count == 0 || std::fwrite(items, sizeof(T), count, file) == count;
+}
+
+template <typename T>
+bool read_items(std::FILE* file, T* items, size_t count)
+{
+    return count == 0 || std::fread(items, sizeof(T), count, file) == count;
+}
 }  // namespace
 
-std::unique_ptr<Instance> instantiate(std::unique_ptr<const Module> module,
+std::unique_ptr<Instance> instantiate(std::shared_ptr<const Module> module,
     std::vector<ExternalFunction> imported_functions, std::vector<ExternalTable> imported_tables,
     std::vector<ExternalMemory> imported_memories, std::vector<ExternalGlobal> imported_globals,
     uint32_t memory_pages_limit /*= DefaultMemoryPagesLimit*/)
 {
-    assert(module->funcsec.size() == module->codesec.size());
+    assert(module->funcsec.size() == module->get_code_count());
 
     match_imported_functions(module->imported_function_types, imported_functions);
     match_imported_tables(module->imported_table_types, imported_tables);
@@ -307,11 +401,16 @@ std::unique_ptr<Instance> instantiate(std::unique_ptr<const Module> module,
     }
 
     // Fill out memory based on data segments
-    for (size_t i = 0; i < module->datasec.size(); ++i)
+    if (const auto memory_image = get_memory_image(*module); memory_image != nullptr)
+        memory->map_image(*memory_image);
+    else
     {
-        // NOTE: these instructions can overlap
-        std::copy(module->datasec[i].init.begin(), module->datasec[i].init.end(),
-            memory->data() + datasec_offsets[i]);
+        for (size_t i = 0; i < module->datasec.size(); ++i)
+        {
+            // NOTE: these instructions can overlap
+            std::copy(module->datasec[i].init.begin(), module->datasec[i].init.end(),
+                memory->data() + datasec_offsets[i]);
+        }
     }
 
     // We need to create instance before filling table,
@@ -368,6 +467,164 @@ std::unique_ptr<Instance> instantiate(std::unique_ptr<const Module> module,
     return instance;
 }
 
+void snapshot_instance(Instance& instance)
+{
+    auto snapshot = std::make_unique<InstanceSnapshot>();
+    if (!instance.module->memorysec.empty())
+        snapshot->memory = bytes{bytes_view{*instance.memory}};
+    if (!instance.module->tablesec.empty())
+        snapshot->table = *instance.table;
+    snapshot->globals = instance.globals;
+
+    if (!instance.module->memorysec.empty())
+        instance.memory->clear_dirty_pages();
+    instance.snapshot = std::move(snapshot);
+}
+
+void reset_instance(Instance& instance)
+{
+    assert(instance.snapshot != nullptr);
+    const auto& snapshot = *instance.snapshot;
+
+    if (!instance.module->memorysec.empty())
+        instance.memory->restore(snapshot.memory);
+    if (!instance.module->tablesec.empty())
+        *instance.table = snapshot.table;
+    instance.globals = snapshot.globals;
+}
+
+void save_instance_image(const Instance& instance, bytes_view wasm_binary, const std::string& path)
+{
+    const auto& module = *instance.module;
+
+    std::vector<uint32_t> table;
+    if (!module.tablesec.empty())
+    {
+        table.reserve(instance.table->size());
+        for (const auto& element : *instance.table)
+        {
+            if (element.instance != nullptr && element.instance != &instance)
+                throw image_error{"table element references a function of another instance"};
+            table.emplace_back(element.instance != nullptr ? element.func_idx : ImageNullElement);
+        }
+    }
+
+    ImageHeader header{};
+    std::copy(std::begin(ImageMagic), std::end(ImageMagic), header.magic);
+    header.version = ImageVersion;
+    header.num_functions =
+        static_cast<uint32_t>(instance.imported_functions.size() + module.funcsec.size());
+    header.num_globals = static_cast<uint32_t>(instance.globals.size());
+    header.table_size = static_cast<uint32_t>(table.size());
+    header.memory_size = !module.memorysec.empty() ? instance.memory->size() : 0;
+    const auto data_size = sizeof(header) + instance.globals.size() * sizeof(Value) +
+                           table.size() * sizeof(uint32_t);
+    header.memory_offset = (data_size + PageSize - 1) / PageSize * PageSize;
+    header.binary_hash = hash_bytes(wasm_binary);
+    const bytes padding(header.memory_offset - data_size, 0);
+    const uint8_t* memory_data = header.memory_size != 0 ? instance.memory->data() : nullptr;
+
+    const auto file = open_file(path, "wb");
+    if (file == nullptr || !write_items(file.get(), &header, 1) ||
+        !write_items(file.get(), instance.globals.data(), instance.globals.size()) ||
+        !write_items(file.get(), table.data(), table.size()) ||
+        !write_items(file.get(), padding.data(), padding.size()) ||
+        !write_items(file.get(), memory_data, header.memory_size) ||
+        std::fflush(file.get()) != 0)
+        throw image_error{"cannot write image file " + path};
+}
+
+std::unique_ptr<Instance> instantiate_from_image(std::shared_ptr<const Module> module,
+    bytes_view wasm_binary, const std::string& image_path,
+    std::vector<ExternalFunction> imported_functions,
+    std::vector<ExternalTable> imported_tables, std::vector<ExternalMemory> imported_memories,
+    std::vector<ExternalGlobal> imported_globals,
+    uint32_t memory_pages_limit /*= DefaultMemoryPagesLimit*/)
+{
+    assert(module->funcsec.size() == module->get_code_count());
+
+    match_imported_functions(module->imported_function_types, imported_functions);
+    match_imported_tables(module->imported_table_types, imported_tables);
+    match_imported_memories(module->imported_memory_types, imported_memories);
+    match_imported_globals(module->imported_global_types, imported_globals);
+
+    const auto file = open_file(image_path, "rb");
+    if (file == nullptr)
+        throw image_error{"cannot open image file " + image_path};
+
+    ImageHeader header;
+    if (!read_items(file.get(), &header, 1) ||
+        !std::equal(std::begin(ImageMagic), std::end(ImageMagic), header.magic) ||
+        header.version != ImageVersion || std::fseek(file.get(), 0, SEEK_END) != 0)
+        throw image_error{"invalid image file " + image_path};
+
+    // The sizes are checked against the file size before anything is allocated.
+    const auto file_size = static_cast<uint64_t>(std::ftell(file.get()));
+    const auto data_size = sizeof(header) + uint64_t{header.num_globals} * sizeof(Value) +
+                           uint64_t{header.table_size} * sizeof(uint32_t);
+    if (header.memory_offset % PageSize != 0 || data_size > header.memory_offset ||
+        header.memory_offset > file_size || header.memory_size > file_size - header.memory_offset ||
+        std::fseek(file.get(), sizeof(header), SEEK_SET) != 0)
+        throw image_error{"invalid image file " + image_path};
+
+    const auto num_functions = module->imported_function_types.size() + module->funcsec.size();
+    if (header.binary_hash != hash_bytes(wasm_binary) || header.num_functions != num_functions ||
+        header.num_globals != module->globalsec.size() ||
+        (module->tablesec.empty() && header.table_size != 0) ||
+        (module->memorysec.empty() && header.memory_size != 0))
+        throw image_error{"image doesn't match the module"};
+
+    std::vector<Value> globals(header.num_globals);
+    std::vector<uint32_t> table_func_indices(header.table_size);
+    if (!read_items(file.get(), globals.data(), globals.size()) ||
+        !read_items(file.get(), table_func_indices.data(), table_func_indices.size()))
+        throw image_error{"cannot read image file " + image_path};
+
+    auto [table, table_limits] = allocate_table(module->tablesec, imported_tables);
+    if (!module->tablesec.empty())
+    {
+        if (header.table_size < table_limits.min ||
+            (table_limits.max.has_value() && header.table_size > *table_limits.max) ||
+            std::any_of(table_func_indices.begin(), table_func_indices.end(),
+                [num_functions](uint32_t idx) {
+                    return idx != ImageNullElement && idx >= num_functions;
+                }))
+            throw image_error{"image doesn't match the module"};
+
+        table->resize(header.table_size);
+    }
+
+    auto [memory, memory_limits] =
+        allocate_memory(module->memorysec, imported_memories, memory_pages_limit);
+    if (!module->memorysec.empty())
+    {
+        if (header.memory_size % PageSize != 0 || header.memory_size < memory->size() ||
+            header.memory_size > memory->max_size())
+            throw image_error{"image doesn't match the module"};
+
+        memory->map_file(file.get(), header.memory_offset, header.memory_size);
+    }
+    // See instantiate().
+    if (memory_limits.max.has_value())
+    {
+        assert(*memory_limits.max <= memory_pages_limit);
+        memory_pages_limit = *memory_limits.max;
+    }
+
+    auto instance = std::make_unique<Instance>(std::move(module), std::move(memory), memory_limits,
+        // NOLINTNEXTLINE(clang-analyzer-cplusplus.NewDeleteLeaks)
+        memory_pages_limit, std::move(table), table_limits, std::move(globals),
+        std::move(imported_functions), std::move(imported_globals));
+
+    for (size_t i = 0; i < table_func_indices.size(); ++i)
+    {
+        if (table_func_indices[i] != ImageNullElement)
+            (*instance->table)[i] = {instance.get(), table_func_indices[i], {}};
+    }
+
+    return instance;
+}
+
 std::vector<ExternalFunction> resolve_imported_functions(
     const Module& module, std::vector<ImportedFunction> imported_functions)
 {
@@ -7,6 +7,7 @@
 #include "cxx20/span.hpp"
 #include "exceptions.hpp"
 #include "limits.hpp"
+#include "linear_memory.hpp"
 #include "module.hpp"
 #include "types.hpp"
 #include "value.hpp"
@@ -14,6 +15,7 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <string>
 #include <vector>
 
 namespace fizzy
@@ -22,6 +24,8 @@ namespace fizzy
 struct ExecutionResult;
 struct Instance;
 
+// The function provided by the host. It may return Suspended to make the call pending
+// (see complete_host_call()).
 struct ExternalFunction
 {
     std::function<ExecutionResult(Instance&, const Value*, int depth)> function;
@@ -52,7 +56,7 @@ struct ExternalTable
 
 struct ExternalMemory
 {
-    bytes* data = nullptr;
+    LinearMemory* data = nullptr;
     Limits limits;
 };
 
@@ -62,16 +66,27 @@ struct ExternalGlobal
     GlobalType type;
 };
 
-using bytes_ptr = std::unique_ptr<bytes, void (*)(bytes*)>;
+using memory_ptr = std::unique_ptr<LinearMemory, void (*)(LinearMemory*)>;
+
+// The state of an instance saved by snapshot_instance() and restored by reset_instance().
+// Only the state owned by the instance is saved, not the imported memory, table and globals.
+struct InstanceSnapshot
+{
+    bytes memory;
+    table_elements table;
+    std::vector<Value> globals;
+};
 
 // The module instance.
 struct Instance
 {
-    std::unique_ptr<const Module> module;
-    // Memory is either allocated and owned by the instance or imported as already allocated bytes
+    // The module is immutable and can be shared by any number of instances, also ones used
+    // in different threads.
+    std::shared_ptr<const Module> module;
+    // Memory is either allocated and owned by the instance or imported as already allocated memory
     // and owned externally.
     // For these cases unique_ptr would either have a normal deleter or noop deleter respectively
-    bytes_ptr memory = {nullptr, [](bytes*) {}};
+    memory_ptr memory = {nullptr, [](LinearMemory*) {}};
     Limits memory_limits;
     // Hard limit for memory growth in pages, checked when memory is defined as unbounded in module
     uint32_t memory_pages_limit = 0;
@@ -82,8 +97,10 @@ struct Instance
     std::vector<Value> globals;
     std::vector<ExternalFunction> imported_functions;
     std::vector<ExternalGlobal> imported_globals;
+    // The state saved by snapshot_instance() or nullptr.
+    std::unique_ptr<const InstanceSnapshot> snapshot;
 
-    Instance(std::unique_ptr<const Module> _module, bytes_ptr _memory, Limits _memory_limits,
+    Instance(std::shared_ptr<const Module> _module, memory_ptr _memory, Limits _memory_limits,
         uint32_t _memory_pages_limit, table_ptr _table, Limits _table_limits,
         std::vector<Value> _globals, std::vector<ExternalFunction> _imported_functions,
         std::vector<ExternalGlobal> _imported_globals)
@@ -100,7 +117,45 @@ struct Instance
 };
 
 // Instantiate a module.
-std::unique_ptr<Instance> instantiate(std::unique_ptr<const Module> module,
+// The instance shares the ownership of the module, so the same module can be instantiated many
+// times without parsing it again.
+std::unique_ptr<Instance> instantiate(std::shared_ptr<const Module> module,
+    std::vector<ExternalFunction> imported_functions = {},
+    std::vector<ExternalTable> imported_tables = {},
+    std::vector<ExternalMemory> imported_memories = {},
+    std::vector<ExternalGlobal> imported_globals = {},
+    uint32_t memory_pages_limit = DefaultMemoryPagesLimit);
+
+// Save the state of the instance, usually right after instantiate(), to be restored later
+// with reset_instance().
+// The modified memory pages are tracked only from then on, so the executions before any snapshot
+// don't pay for it.
+void snapshot_instance(Instance& instance);
+
+// Restore the state of the instance saved by snapshot_instance().
+// Only the memory pages modified since the snapshot or the last reset are copied back, so the cost
+// depends on what the executions touched, not on the memory size. The memory grown since then
+// is shrunk back.
+// Throws std::bad_alloc if the memory cannot be shrunk, then the instance is not reset.
+void reset_instance(Instance& instance);
+
+// Save the state owned by the instance to the image file, usually after instantiate() and
+// the execution of the initialization function exported by the module. The image contains
+// the memory, the globals and the table, which may reference only the functions of this instance.
+// The image is tied to the wasm binary the module was parsed from, passed as wasm_binary.
+// Throws image_error if the state cannot be saved.
+void save_instance_image(const Instance& instance, bytes_view wasm_binary, const std::string& path);
+
+// Instantiate a module with the state restored from the image file saved by
+// save_instance_image() for the same module, parsed from the wasm_binary. The image saved for
+// a different binary is rejected. The data and element segments are not applied and
+// the start function is not executed, as this was done before the image was saved.
+// The memory is mapped from the file copy-on-write where possible, so the instances created from
+// the same image share the memory pages they don't modify. The file must not be modified while
+// any such instance exists.
+// Throws image_error if the image cannot be read or doesn't match the module.
+std::unique_ptr<Instance> instantiate_from_image(std::shared_ptr<const Module> module,
+    bytes_view wasm_binary, const std::string& image_path,
     std::vector<ExternalFunction> imported_functions = {},
     std::vector<ExternalTable> imported_tables = {},
     std::vector<ExternalMemory> imported_memories = {},
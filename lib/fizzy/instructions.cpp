@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "instructions.hpp"
+#include <array>
 
 namespace fizzy
 {
@@ -444,6 +445,13 @@ constexpr uint8_t instruction_max_align_table[256] = {
     /* f32_reinterpret_i32 = 0xbe */ 0,
     /* f64_reinterpret_i64 = 0xbf */ 0,
 };
+
+constexpr auto default_instruction_cost_table = [] {
+    std::array<uint32_t, InstructionCostTableSize> table{};
+    for (auto& cost : table)
+        cost = 1;
+    return table;
+}();
 }  // namespace
 
 const InstructionType* get_instruction_type_table() noexcept
@@ -456,4 +464,119 @@ const uint8_t* get_instruction_max_align_table() noexcept
     return instruction_max_align_table;
 }
 
+const uint32_t* get_default_instruction_cost_table() noexcept
+{
+    return default_instruction_cost_table.data();
+}
+
+size_t get_instruction_size(const uint8_t* instr) noexcept
+{
+    // opcode + u32 immediate
+    constexpr size_t ImmediateU32InstructionSize = 1 + sizeof(uint32_t);
+    // opcode + arity + branch immediates
+    constexpr size_t BranchInstructionSize = 1 + sizeof(uint32_t) + BranchImmediateSize;
+
+    switch (static_cast<Instr>(*instr))
+    {
+    case Instr::if_:
+    case Instr::else_:
+    case Instr::call:
+    case Instr::call_indirect:
+    case Instr::local_get:
+    case Instr::local_set:
+    case Instr::local_tee:
+    case Instr::global_get:
+    case Instr::global_set:
+    case Instr::i32_const:
+    case Instr::f32_const:
+    case Instr::i32_load:
+    case Instr::i64_load:
+    case Instr::f32_load:
+    case Instr::f64_load:
+    case Instr::i32_load8_s:
+    case Instr::i32_load8_u:
+    case Instr::i32_load16_s:
+    case Instr::i32_load16_u:
+    case Instr::i64_load8_s:
+    case Instr::i64_load8_u:
+    case Instr::i64_load16_s:
+    case Instr::i64_load16_u:
+    case Instr::i64_load32_s:
+    case Instr::i64_load32_u:
+    case Instr::i32_store:
+    case Instr::i64_store:
+    case Instr::f32_store:
+    case Instr::f64_store:
+    case Instr::i32_store8:
+    case Instr::i32_store16:
+    case Instr::i64_store8:
+    case Instr::i64_store16:
+    case Instr::i64_store32:
+    case Instr::i32_add_imm:
+    case Instr::i32_and_imm:
+    case Instr::i32_or_imm:
+    case Instr::i32_xor_imm:
+    case Instr::i32_shl_imm:
+    case Instr::i32_shr_s_imm:
+    case Instr::i32_shr_u_imm:
+    case Instr::i32_rotl_imm:
+    case Instr::i32_rotr_imm:
+        return ImmediateU32InstructionSize;
+
+    case Instr::i64_const:
+    case Instr::f64_const:
+    case Instr::i64_add_imm:
+    case Instr::i64_and_imm:
+    case Instr::i64_or_imm:
+    case Instr::i64_xor_imm:
+    case Instr::i64_shl_imm:
+    case Instr::i64_shr_s_imm:
+    case Instr::i64_shr_u_imm:
+    case Instr::i64_rotl_imm:
+    case Instr::i64_rotr_imm:
+    case Instr::meter:
+        return 1 + sizeof(uint64_t);
+
+    case Instr::br:
+    case Instr::br_if:
+    case Instr::return_:
+    case Instr::br_no_drop:
+    case Instr::br_if_no_drop:
+    case Instr::br_void:
+    case Instr::br_if_void:
+        return BranchInstructionSize;
+
+    case Instr::br_table:
+    {
+        uint32_t br_table_size;
+        __builtin_memcpy(&br_table_size, instr + 1, sizeof(br_table_size));
+        // opcode + size + arity + branch immediates of all labels and the default label
+        return 1 + 2 * sizeof(uint32_t) + (size_t{br_table_size} + 1) * BranchImmediateSize;
+    }
+
+    case Instr::local_get_local_get_i32_add:
+        return 2 * ImmediateU32InstructionSize + 1;
+
+    case Instr::local_get_i32_load:
+    case Instr::local_tee_local_get:
+        return 2 * ImmediateU32InstructionSize;
+
+    case Instr::i32_eqz_br_if:
+    case Instr::i32_eq_br_if:
+    case Instr::i32_ne_br_if:
+    case Instr::i32_lt_s_br_if:
+    case Instr::i32_lt_u_br_if:
+    case Instr::i32_gt_s_br_if:
+    case Instr::i32_gt_u_br_if:
+    case Instr::i32_le_s_br_if:
+    case Instr::i32_le_u_br_if:
+    case Instr::i32_ge_s_br_if:
+    case Instr::i32_ge_u_br_if:
+        return 1 + BranchInstructionSize;
+
+    default:
+        return 1;
+    }
+}
+
 }  // namespace fizzy
@@ -27,4 +27,21 @@ const InstructionType* get_instruction_type_table() noexcept;
 /// It may contain invalid value for instructions not needing it.
 const uint8_t* get_instruction_max_align_table() noexcept;
 
+/// The number of entries of the instruction cost table used for metering: one for each opcode.
+constexpr size_t InstructionCostTableSize = 256;
+
+/// Returns the default instruction cost table used for metering, indexed by opcode.
+///
+/// The cost of every instruction is 1, so the metered execution is charged the number of
+/// the executed instructions.
+const uint32_t* get_default_instruction_cost_table() noexcept;
+
+/// The size of the branch immediate values in the internal code: code_offset and stack_drop.
+constexpr size_t BranchImmediateSize = 2 * sizeof(uint32_t);
+
+/// Returns the size of the instruction of the internal code at the given position,
+/// including the opcode and the decoded immediate values.
+/// For a superinstruction this is the size of the whole replaced sequence.
+size_t get_instruction_size(const uint8_t* instr) noexcept;
+
 }  // namespace fizzy
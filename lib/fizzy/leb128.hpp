@@ -7,6 +7,7 @@
 #include "exceptions.hpp"
 #include <cstdint>
 #include <limits>
+#include <type_traits>
 #include <utility>
 
 static_assert((int8_t{-1} >> 1) == int8_t{-1},
@@ -14,17 +15,24 @@ static_assert((int8_t{-1} >> 1) == int8_t{-1},
 
 namespace fizzy
 {
+/// The maximum length of the LEB128 encoding of the values of type T.
 template <typename T>
+constexpr int leb128_max_size = (std::numeric_limits<std::make_unsigned_t<T>>::digits + 6) / 7;
+
+namespace detail
+{
+/// Decodes the unsigned LEB128 value.
+/// With CheckEnd false the input must contain at least leb128_max_size<T> bytes. The loop then
+/// only looks for the end of the encoding and the compiler unrolls it.
+template <typename T, bool CheckEnd>
 inline std::pair<T, const uint8_t*> leb128u_decode(const uint8_t* pos, const uint8_t* end)
 {
-    static_assert(!std::numeric_limits<T>::is_signed);
-
     T result = 0;
     int result_shift = 0;
 
     for (; result_shift < std::numeric_limits<T>::digits; ++pos, result_shift += 7)
     {
-        if (pos == end)
+        if (CheckEnd && pos == end)
             throw parser_error{"unexpected EOF"};
 
         result |= static_cast<T>((static_cast<T>(*pos) & 0x7F) << result_shift);
@@ -40,18 +48,17 @@ inline std::pair<T, const uint8_t*> leb128u_decode(const uint8_t* pos, const uin
     throw parser_error{"invalid LEB128 encoding: too many bytes"};
 }
 
-template <typename T>
+/// Decodes the signed LEB128 value, see leb128u_decode() for CheckEnd.
+template <typename T, bool CheckEnd>
 inline std::pair<T, const uint8_t*> leb128s_decode(const uint8_t* pos, const uint8_t* end)
 {
-    static_assert(std::numeric_limits<T>::is_signed);
-
     using T_unsigned = typename std::make_unsigned<T>::type;
     T_unsigned result = 0;
     size_t result_shift = 0;
 
     for (; result_shift < std::numeric_limits<T_unsigned>::digits; ++pos, result_shift += 7)
     {
-        if (pos == end)
+        if (CheckEnd && pos == end)
             throw parser_error{"unexpected EOF"};
 
         result |= static_cast<T_unsigned>((static_cast<T_unsigned>(*pos) & 0x7F) << result_shift);
@@ -86,5 +93,38 @@ inline std::pair<T, const uint8_t*> leb128s_decode(const uint8_t* pos, const uin
 
     throw parser_error{"invalid LEB128 encoding: too many bytes"};
 }
+}  // namespace detail
+
+template <typename T>
+inline std::pair<T, const uint8_t*> leb128u_decode(const uint8_t* pos, const uint8_t* end)
+{
+    static_assert(!std::numeric_limits<T>::is_signed);
+
+    // Away from the end of the input the longest encoding fits, so skip checking for the end.
+    // This pays off for the long encodings of 64-bit values only: for 32-bit values, mostly
+    // encoded in 1 or 2 bytes, the additional branch costs more than the checks it saves.
+    if constexpr (sizeof(T) == sizeof(uint64_t))
+    {
+        if (end - pos >= leb128_max_size<T>)
+            return detail::leb128u_decode<T, false>(pos, end);
+    }
+
+    return detail::leb128u_decode<T, true>(pos, end);
+}
+
+template <typename T>
+inline std::pair<T, const uint8_t*> leb128s_decode(const uint8_t* pos, const uint8_t* end)
+{
+    static_assert(std::numeric_limits<T>::is_signed);
+
+    // See leb128u_decode().
+    if constexpr (sizeof(T) == sizeof(int64_t))
+    {
+        if (end - pos >= leb128_max_size<T>)
+            return detail::leb128s_decode<T, false>(pos, end);
+    }
+
+    return detail::leb128s_decode<T, true>(pos, end);
+}
 
 }  // namespace fizzy
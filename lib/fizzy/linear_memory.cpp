@@ -0,0 +1,344 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "linear_memory.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// The address space can be reserved up front where mmap() is available.
+#if defined(__unix__) || defined(__APPLE__)
+#define FIZZY_RESERVED_MEMORY 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define FIZZY_RESERVED_MEMORY 0
+#endif
+
+// The memory images are kept in anonymous memory files where memfd_create() is available.
+#if FIZZY_RESERVED_MEMORY && defined(__linux__)
+#define FIZZY_MEMORY_FILE 1
+#else
+#define FIZZY_MEMORY_FILE 0
+#endif
+
+#ifdef FIZZY_GUARD_PAGES
+#include "guard_pages.hpp"
+#include <signal.h>
+#include <mutex>
+#endif
+
+namespace fizzy
+{
+namespace
+{
+size_t get_num_dirty_pages(size_t size) noexcept
+{
+    return (size + LinearMemory::DirtyPageSize - 1) / LinearMemory::DirtyPageSize;
+}
+}  // namespace
+
+#ifdef FIZZY_GUARD_PAGES
+namespace
+{
+/// The maximum size of the memory with guard pages: 4 GiB, i.e. the whole 32-bit address space.
+/// The rest of the reservation is never accessible.
+constexpr size_t MaxGuardedMemorySize = size_t{4} << 30;
+
+thread_local MemoryFaultHandler* thread_memory_fault_handler = nullptr;
+
+/// The SIGSEGV action installed before the memory fault handler.
+struct sigaction prev_segv_action;
+
+void handle_memory_fault(int signum, siginfo_t* info, void* context) noexcept
+{
+    const auto* const handler = thread_memory_fault_handler;
+    if (handler != nullptr && handler->memory_data != nullptr)
+    {
+        const auto* const address = static_cast<const uint8_t*>(info->si_addr);
+        if (address >= handler->memory_data &&
+            address < handler->memory_data + LinearMemory::GuardedReservationSize)
+            siglongjmp(const_cast<MemoryFaultHandler*>(handler)->jump_buffer, 1);
+    }
+
+    // The fault is not caused by wasm code: pass it to the previous action, which stays installed
+    // behind this handler, so the faults it recovers from do not disable the wasm traps.
+    if ((prev_segv_action.sa_flags & SA_SIGINFO) != 0)
+        prev_segv_action.sa_sigaction(signum, info, context);
+    else if (prev_segv_action.sa_handler != SIG_DFL && prev_segv_action.sa_handler != SIG_IGN)
+        prev_segv_action.sa_handler(signum);
+    else
+    {
+        // The default action terminates the process. The memory fault cannot be ignored
+        // (the faulting instruction would be executed again forever), so SIG_IGN is handled
+        // the same way, like the kernel does for the faults.
+        struct sigaction default_action = {};
+        default_action.sa_handler = SIG_DFL;
+        sigemptyset(&default_action.sa_mask);
+        sigaction(SIGSEGV, &default_action, nullptr);
+        raise(SIGSEGV);
+    }
+}
+
+void install_memory_fault_handler()
+{
+    static std::once_flag once;
+    std::call_once(once, [] {
+        struct sigaction action = {};
+        action.sa_sigaction = handle_memory_fault;
+        // SA_NODEFER keeps SIGSEGV unblocked after jumping out of the handler.
+        action.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, &prev_segv_action);
+    });
+}
+}  // namespace
+
+MemoryFaultHandler*& current_memory_fault_handler() noexcept
+{
+    return thread_memory_fault_handler;
+}
+#endif
+
+#if FIZZY_RESERVED_MEMORY
+namespace
+{
+size_t round_up_to_os_pages(size_t size) noexcept
+{
+    static const auto os_page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return (size + os_page_size - 1) / os_page_size * os_page_size;
+}
+
+/// Maps the file fragment copy-on-write at the address, replacing the pages there.
+void map_file_pages(uint8_t* address, size_t size, int fd, uint64_t offset)
+{
+    if (size != 0 && mmap(address, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+                         static_cast<off_t>(offset)) == MAP_FAILED)
+        throw std::bad_alloc{};
+}
+
+/// Returns the size of the address space to reserve for the memory of the given maximum size.
+size_t get_reservation_size([[maybe_unused]] size_t max_size) noexcept
+{
+#ifdef FIZZY_GUARD_PAGES
+    return LinearMemory::GuardedReservationSize;
+#else
+    return round_up_to_os_pages(max_size);
+#endif
+}
+}  // namespace
+
+LinearMemory::LinearMemory(size_t size, size_t max_size) : m_max_size{max_size}
+{
+#ifdef FIZZY_GUARD_PAGES
+    install_memory_fault_handler();
+    m_max_size = std::min(m_max_size, MaxGuardedMemorySize);
+#endif
+
+    const auto reservation_size = get_reservation_size(m_max_size);
+    if (reservation_size != 0)
+    {
+        // The reserved pages are not accessible and are not backed by memory until committed.
+        auto* const reservation = mmap(nullptr, reservation_size, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (reservation == MAP_FAILED)
+            throw std::bad_alloc{};
+        m_data = static_cast<uint8_t*>(reservation);
+    }
+
+    try
+    {
+        resize(size);
+    }
+    catch (...)
+    {
+        if (m_data != nullptr)
+            munmap(m_data, reservation_size);
+        throw;
+    }
+}
+
+LinearMemory::~LinearMemory() noexcept
+{
+    if (m_data != nullptr)
+        munmap(m_data, get_reservation_size(m_max_size));
+}
+
+void LinearMemory::resize(size_t new_size)
+{
+    assert(new_size >= m_size);
+    if (new_size > m_max_size)
+        throw std::bad_alloc{};
+
+    resize_dirty_pages(new_size);
+
+    // Commit only the pages added to the memory. The operating system fills them with zeros
+    // on first access.
+    const auto committed_size = round_up_to_os_pages(m_size);
+    const auto new_committed_size = round_up_to_os_pages(new_size);
+    if (new_committed_size > committed_size &&
+        mprotect(m_data + committed_size, new_committed_size - committed_size,
+            PROT_READ | PROT_WRITE) != 0)
+        throw std::bad_alloc{};
+    m_size = new_size;
+}
+
+void LinearMemory::map_file(std::FILE* file, uint64_t offset, size_t new_size)
+{
+    assert(offset % PageSize == 0 && new_size % PageSize == 0);
+    resize(new_size);
+
+    // The private mapping replaces the committed pages. The pages of PageSize are aligned
+    // to the OS pages.
+    map_file_pages(m_data, new_size, fileno(file), offset);
+}
+
+void LinearMemory::shrink(size_t new_size)
+{
+    assert(new_size < m_size);
+
+    // Replace the released pages with new reserved ones, so that they are committed as zero pages
+    // when the memory grows again.
+    const auto committed_size = round_up_to_os_pages(m_size);
+    const auto new_committed_size = round_up_to_os_pages(new_size);
+    if (new_committed_size < committed_size &&
+        mmap(m_data + new_committed_size, committed_size - new_committed_size, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) == MAP_FAILED)
+        throw std::bad_alloc{};
+    std::memset(m_data + new_size, 0, new_committed_size - new_size);
+    m_size = new_size;
+    resize_dirty_pages(new_size);
+}
+#else
+LinearMemory::LinearMemory(size_t size, size_t max_size) : m_max_size{max_size}
+{
+    if (size > m_max_size)
+        throw std::bad_alloc{};
+    if (size == 0)
+        return;
+
+    m_data = static_cast<uint8_t*>(std::calloc(size, 1));
+    if (m_data == nullptr)
+        throw std::bad_alloc{};
+    m_size = size;
+}
+
+LinearMemory::~LinearMemory() noexcept
+{
+    std::free(m_data);
+}
+
+void LinearMemory::resize(size_t new_size)
+{
+    assert(new_size >= m_size);
+    if (new_size > m_max_size)
+        throw std::bad_alloc{};
+    if (new_size == m_size)
+        return;
+
+    resize_dirty_pages(new_size);
+
+    auto* const new_data = static_cast<uint8_t*>(std::realloc(m_data, new_size));
+    if (new_data == nullptr)
+        throw std::bad_alloc{};
+    std::memset(new_data + m_size, 0, new_size - m_size);
+    m_data = new_data;
+    m_size = new_size;
+}
+
+void LinearMemory::map_file(std::FILE* file, uint64_t offset, size_t new_size)
+{
+    assert(offset % PageSize == 0 && new_size % PageSize == 0);
+    resize(new_size);
+
+    if (std::fseek(file, static_cast<long>(offset), SEEK_SET) != 0 ||
+        std::fread(m_data, 1, new_size, file) != new_size)
+        throw std::bad_alloc{};
+}
+
+void LinearMemory::shrink(size_t new_size)
+{
+    assert(new_size < m_size);
+
+    // The allocation is kept, the bytes are zeroed when the memory grows again.
+    m_size = new_size;
+    resize_dirty_pages(new_size);
+}
+#endif
+
+MemoryImage::MemoryImage(bytes_view content)
+  : m_size{(content.size() + PageSize - 1) / PageSize * PageSize}
+{
+#if FIZZY_MEMORY_FILE
+    m_fd = memfd_create("fizzy-memory-image", MFD_CLOEXEC);
+    if (m_fd != -1)
+    {
+        void* data = MAP_FAILED;
+        if (ftruncate(m_fd, static_cast<off_t>(m_size)) == 0)
+            data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (data != MAP_FAILED)
+        {
+            std::memcpy(data, content.data(), content.size());
+            munmap(data, m_size);
+            return;
+        }
+        close(m_fd);
+        m_fd = -1;
+    }
+#endif
+
+    m_content.reserve(m_size);
+    m_content.assign(content);
+    m_content.resize(m_size, 0);
+}
+
+MemoryImage::~MemoryImage() noexcept
+{
+#if FIZZY_MEMORY_FILE
+    if (m_fd != -1)
+        close(m_fd);
+#endif
+}
+
+void LinearMemory::map_image(const MemoryImage& image)
+{
+    assert(image.m_size <= m_size);
+
+#if FIZZY_MEMORY_FILE
+    if (image.m_fd != -1)
+    {
+        map_file_pages(m_data, image.m_size, image.m_fd, 0);
+        return;
+    }
+#endif
+    std::copy(image.m_content.begin(), image.m_content.end(), m_data);
+}
+
+void LinearMemory::resize_dirty_pages(size_t new_size)
+{
+    if (m_dirty_tracking)
+        m_dirty_pages.resize(get_num_dirty_pages(new_size));
+}
+
+void LinearMemory::clear_dirty_pages()
+{
+    m_dirty_pages.assign(get_num_dirty_pages(m_size), uint8_t{0});
+    m_dirty_tracking = true;
+}
+
+void LinearMemory::restore(bytes_view state)
+{
+    assert(state.size() <= m_size);
+    if (state.size() < m_size)
+        shrink(state.size());
+
+    for (size_t offset = 0; offset < m_size; offset += DirtyPageSize)
+    {
+        if (is_dirty(offset))
+            std::memcpy(m_data + offset, &state[offset], std::min(DirtyPageSize, m_size - offset));
+    }
+    clear_dirty_pages();
+}
+}  // namespace fizzy
@@ -0,0 +1,208 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "bytes.hpp"
+#include "limits.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace fizzy
+{
+/// The initial content of the memories of many instances, built once and mapped into each
+/// of them with LinearMemory::map_image().
+///
+/// On Linux the image is kept in an anonymous memory file (memfd) which is mapped copy-on-write,
+/// so the memories share the pages of the image they don't write. Elsewhere, or if the memory
+/// file cannot be created, the image is kept on the heap and copied into each memory.
+class MemoryImage
+{
+    /// The file descriptor of the memory file or -1.
+    int m_fd = -1;
+
+    /// The image content when it is not kept in the memory file.
+    bytes m_content;
+
+    /// The image size in bytes, a multiple of PageSize.
+    size_t m_size = 0;
+
+    friend class LinearMemory;
+
+public:
+    /// Creates the image of the given content padded with zeros to a multiple of PageSize.
+    /// Throws std::bad_alloc if the image cannot be allocated.
+    explicit MemoryImage(bytes_view content);
+
+    ~MemoryImage() noexcept;
+
+    MemoryImage(const MemoryImage&) = delete;
+    MemoryImage& operator=(const MemoryImage&) = delete;
+
+    size_t size() const noexcept { return m_size; }
+};
+
+/// The linear memory of a wasm instance: the zero-initialized array of bytes which can only grow
+/// up to the maximum size.
+///
+/// The memory reserves the address space for the maximum size up front and only commits
+/// the pages of the current size. Growing the memory makes the next pages accessible in place:
+/// the data is never moved nor copied and the operating system provides the zero pages lazily,
+/// on first access. On systems without mmap() the data is allocated on the heap instead
+/// and may be moved when the memory grows.
+///
+/// When Fizzy is built with guard pages (the FIZZY_GUARD_PAGES option) the memory reserves
+/// GuardedReservationSize bytes of the address space regardless of the maximum size. The rest
+/// of the reservation after the first size() bytes consists of guard pages, so any wasm memory
+/// access outside of the memory faults.
+///
+/// After clear_dirty_pages() the memory tracks which of its DirtyPageSize-byte pages have been
+/// modified, so restore() only copies back the pages written since the last restore()
+/// or clear_dirty_pages(). Before that nothing is tracked and all pages count as modified.
+/// The wasm store instructions mark the pages they write with mark_stored(); the host writing
+/// to the memory directly must mark them with mark_dirty().
+class LinearMemory
+{
+    /// The memory data, the beginning of the reserved address space.
+    uint8_t* m_data = nullptr;
+
+    /// The memory size in bytes.
+    size_t m_size = 0;
+
+    /// The maximum memory size in bytes.
+    size_t m_max_size = 0;
+
+    /// The modification flags of the pages of the memory, non-zero for the modified ones.
+    /// Empty until the tracking is started.
+    std::vector<uint8_t> m_dirty_pages;
+
+    /// Whether the modified pages are tracked, i.e. clear_dirty_pages() has been called.
+    bool m_dirty_tracking = false;
+
+    /// Resizes the modification flags to the new memory size, if the pages are tracked.
+    void resize_dirty_pages(size_t new_size);
+
+    /// Shrinks the memory to the new size. The bytes after it are zeros when the memory grows
+    /// again.
+    void shrink(size_t new_size);
+
+public:
+    /// The default maximum size: the default hard limit of the memory size of an instance.
+    static constexpr size_t DefaultMaxSize = size_t{DefaultMemoryPagesLimit} * PageSize;
+
+    /// The size of the address space reserved for a memory with guard pages.
+    /// This covers any 32-bit address with any 32-bit static offset of a memory instruction.
+    static constexpr size_t GuardedReservationSize = (size_t{8} << 30) + 65536;
+
+    /// The granularity of the modification tracking: the size of the common OS page.
+    static constexpr size_t DirtyPageSize = 4096;
+
+    /// Allocates the memory of the given size filled with zeros, which can grow up to max_size.
+    /// Throws std::bad_alloc if the memory cannot be allocated.
+    explicit LinearMemory(size_t size = 0, size_t max_size = DefaultMaxSize);
+
+    ~LinearMemory() noexcept;
+
+    LinearMemory(const LinearMemory&) = delete;
+    LinearMemory& operator=(const LinearMemory&) = delete;
+
+    uint8_t* data() noexcept { return m_data; }
+    const uint8_t* data() const noexcept { return m_data; }
+
+    size_t size() const noexcept { return m_size; }
+
+    size_t max_size() const noexcept { return m_max_size; }
+
+    uint8_t* begin() noexcept { return m_data; }
+    const uint8_t* begin() const noexcept { return m_data; }
+
+    uint8_t* end() noexcept { return m_data + m_size; }
+    const uint8_t* end() const noexcept { return m_data + m_size; }
+
+    uint8_t& operator[](size_t index) noexcept
+    {
+        assert(index < m_size);
+        return m_data[index];
+    }
+
+    const uint8_t& operator[](size_t index) const noexcept
+    {
+        assert(index < m_size);
+        return m_data[index];
+    }
+
+    operator bytes_view() const noexcept { return {m_data, m_size}; }
+
+    /// Returns the copy of the memory fragment, like bytes::substr().
+    bytes substr(size_t pos, size_t count) const
+    {
+        return bytes{bytes_view{*this}.substr(pos, count)};
+    }
+
+    /// Grows the memory to the new size. The added bytes are zeros.
+    /// Throws std::bad_alloc if the new size exceeds the maximum size or the memory cannot
+    /// be grown, then the memory is not modified.
+    void resize(size_t new_size);
+
+    /// Grows the memory to the new size, not smaller than the current one, and replaces its
+    /// content with the file fragment at the offset. Both must be multiples of PageSize
+    /// and the file must contain the whole fragment.
+    /// Where mmap() is available the file is mapped copy-on-write: its pages are read on first
+    /// access and copied only when written, so the file must not be modified while the memory
+    /// exists. Otherwise the fragment is read into the memory.
+    /// Throws std::bad_alloc if the memory cannot be grown or the file cannot be mapped or read.
+    void map_file(std::FILE* file, uint64_t offset, size_t new_size);
+
+    /// Replaces the content of the first image.size() bytes of the memory with the image.
+    /// The memory must not be smaller than the image.
+    /// Throws std::bad_alloc if the image cannot be mapped.
+    void map_image(const MemoryImage& image);
+
+    /// Marks the pages of the memory fragment as modified.
+    void mark_dirty(uint64_t offset, size_t size) noexcept
+    {
+        assert(size != 0 && offset + size <= m_size);
+        if (!m_dirty_tracking)
+            return;
+        const auto first_page = offset / DirtyPageSize;
+        const auto last_page = (offset + size - 1) / DirtyPageSize;
+        for (auto page = first_page; page <= last_page; ++page)
+            m_dirty_pages[page] = 1;
+    }
+
+    /// Marks the pages written by the wasm store of Size bytes at the offset as modified.
+    /// The store spans at most two pages, so the first and the last one are marked directly.
+    template <size_t Size>
+    void mark_stored(uint64_t offset) noexcept
+    {
+        static_assert(Size <= DirtyPageSize);
+        assert(offset + Size <= m_size);
+        if (!m_dirty_tracking)
+            return;
+        m_dirty_pages[offset / DirtyPageSize] = 1;
+        m_dirty_pages[(offset + Size - 1) / DirtyPageSize] = 1;
+    }
+
+    /// Returns true if the page containing the given offset has been modified
+    /// or the pages are not tracked.
+    bool is_dirty(size_t offset) const noexcept
+    {
+        assert(offset < m_size);
+        return !m_dirty_tracking || m_dirty_pages[offset / DirtyPageSize] != 0;
+    }
+
+    /// Marks all pages of the memory as not modified and starts tracking the modified ones.
+    /// Throws std::bad_alloc if the modification flags cannot be allocated.
+    void clear_dirty_pages();
+
+    /// Restores the memory to the saved state, not smaller than the current size:
+    /// copies back the modified pages and shrinks the memory to the size of the state.
+    /// All pages are not modified afterwards.
+    /// Throws std::bad_alloc if the memory cannot be shrunk, then the memory is not restored.
+    void restore(bytes_view state);
+};
+}  // namespace fizzy
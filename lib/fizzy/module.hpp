@@ -5,12 +5,58 @@
 #pragma once
 
 #include "types.hpp"
+#include <atomic>
 #include <cassert>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <vector>
 
 namespace fizzy
 {
+class MemoryImage;
+struct Module;
+
+/// The code section of the module parsed with parse_lazy(): each function body is validated and
+/// translated on its first use. The parsed functions are shared by the threads executing them.
+class LazyCodeSection
+{
+    /// The copy of the function bodies of the wasm binary.
+    bytes m_binary;
+
+    /// The offsets of the function bodies in m_binary, followed by the end offset.
+    std::vector<size_t> m_offsets;
+
+    /// The instruction cost table to meter the code with or empty.
+    std::vector<uint32_t> m_cost_table;
+
+    /// The parsed functions, nullptr before the first use.
+    std::unique_ptr<std::atomic<const Code*>[]> m_codes;
+
+    /// The owner of the parsed functions, modified with the mutex locked.
+    mutable std::vector<std::unique_ptr<const Code>> m_parsed_codes;
+    mutable std::mutex m_mutex;
+
+    /// Parses the function body, or returns the code trapping immediately if it is invalid
+    /// or cannot be parsed now (the memory cannot be allocated or the mutex cannot be locked).
+    const Code& parse(size_t code_idx, const Module& module) const noexcept;
+
+public:
+    /// Creates the code section of the function bodies referencing the wasm binary.
+    LazyCodeSection(const std::vector<code_view>& code_binaries, const uint32_t* cost_table);
+
+    size_t size() const noexcept { return m_offsets.size() - 1; }
+
+    /// Returns the code of the function defined in the module, parsing it on first use.
+    const Code& get(size_t code_idx, const Module& module) const noexcept
+    {
+        assert(code_idx < size());
+        if (const auto* code = m_codes[code_idx].load(std::memory_order_acquire); code != nullptr)
+            return *code;
+        return parse(code_idx, module);
+    }
+};
+
 struct Module
 {
     // https://webassembly.github.io/spec/core/binary/modules.html#type-section
@@ -32,6 +78,7 @@ struct Module
     // https://webassembly.github.io/spec/core/binary/modules.html#element-section
     std::vector<Element> elementsec;
     // https://webassembly.github.io/spec/core/binary/modules.html#code-section
+    // Empty if the code section is parsed lazily (see lazy_codesec).
     std::vector<Code> codesec;
     // https://webassembly.github.io/spec/core/binary/modules.html#data-section
     std::vector<Data> datasec;
@@ -45,6 +92,24 @@ struct Module
     // Types of globals defined in import section
     std::vector<GlobalType> imported_global_types;
 
+    // Canonical identifiers of types defined in type section
+    std::vector<FuncTypeId> typesec_ids;
+    // Canonical identifiers of types of all functions (imported and defined in module)
+    std::vector<FuncTypeId> function_type_ids;
+
+    // The initial memory image shared by the instances, built by instantiate() on first use.
+    // Accessed with std::atomic_load() and std::atomic_compare_exchange_strong(), because
+    // the module may be instantiated concurrently.
+    mutable std::shared_ptr<const MemoryImage> memory_image;
+
+    // The code section parsed on first use of each function, or nullptr if parsed eagerly.
+    std::shared_ptr<const LazyCodeSection> lazy_codesec;
+
+    // The owner of the memory the Data::init views refer to: the copy of the data segment bytes
+    // or the mapped module cache file (see load_module_cache()), shared by the copies
+    // of the module. nullptr if they refer to the wasm binary (see parse_in_place()).
+    std::shared_ptr<const void> data_storage;
+
     size_t get_function_count() const noexcept
     {
         return imported_function_types.size() + funcsec.size();
@@ -63,6 +128,12 @@ struct Module
         return typesec[type_idx];
     }
 
+    FuncTypeId get_function_type_id(FuncIdx idx) const noexcept
+    {
+        assert(idx < function_type_ids.size());
+        return function_type_ids[idx];
+    }
+
     size_t get_global_count() const noexcept
     {
         return imported_global_types.size() + globalsec.size();
@@ -80,10 +151,17 @@ struct Module
     {
         assert(func_idx >= imported_function_types.size());  // Cannot be imported function.
         const auto code_idx = func_idx - imported_function_types.size();
+        if (lazy_codesec != nullptr)
+            return lazy_codesec->get(code_idx, *this);
         assert(code_idx < codesec.size());
         return codesec[code_idx];
     }
 
+    size_t get_code_count() const noexcept
+    {
+        return lazy_codesec != nullptr ? lazy_codesec->size() : codesec.size();
+    }
+
     bool has_table() const noexcept { return !tablesec.empty() || !imported_table_types.empty(); }
 
     bool has_memory() const noexcept
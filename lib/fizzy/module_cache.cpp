@@ -0,0 +1,611 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "module_cache.hpp"
+#include "asserts.hpp"
+#include "exceptions.hpp"
+#include "hash.hpp"
+#include "instructions.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+// The cache files are mapped into memory where mmap() is available.
+#if defined(__unix__) || defined(__APPLE__)
+#define FIZZY_MAPPED_FILES 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define FIZZY_MAPPED_FILES 0
+#endif
+
+#ifndef FIZZY_VERSION
+#define FIZZY_VERSION "unknown"
+#endif
+
+namespace fizzy
+{
+namespace
+{
+// The magic number and the version of the module cache format.
+constexpr uint8_t CacheMagic[]{'f', 'i', 'z', 'z', 'y', 'm', 'o', 'd'};
+// Bump the version whenever the internal code encoding changes in a way not reflected
+// by get_encoding_fingerprint().
+constexpr uint64_t CacheVersion = 2;
+
+// The header of the module cache file. It is followed by the payload: the sections of the module
+// and then the bytes of all data segments, so that they can be referred to in the mapped file.
+struct CacheHeader
+{
+    uint8_t magic[sizeof(CacheMagic)];
+    uint64_t version;
+    // The hash of the version of Fizzy, the internal code encoding, the wasm binary
+    // and the cost table.
+    uint64_t key;
+    uint64_t payload_size;
+    // The hash of the payload.
+    uint64_t checksum;
+};
+
+/// Returns the hash of the internal code encoding the cached functions are stored in:
+/// CacheVersion and, for each opcode, the size of the instruction with its immediate values,
+/// its stack operand types and its memory alignment. This way the cache files are not loaded
+/// by a build translating the code differently (e.g. with renumbered superinstructions).
+uint64_t get_encoding_fingerprint() noexcept
+{
+    static const uint64_t fingerprint = [] {
+        auto hash =
+            hash_bytes({reinterpret_cast<const uint8_t*>(&CacheVersion), sizeof(CacheVersion)});
+        const auto* const type_table = get_instruction_type_table();
+        const auto* const max_align_table = get_instruction_max_align_table();
+        for (size_t opcode = 0; opcode < InstructionCostTableSize; ++opcode)
+        {
+            // The immediate values are zeros, so e.g. br_table has only the default label.
+            const uint8_t instr[16]{static_cast<uint8_t>(opcode)};
+            const auto& type = type_table[opcode];
+            uint8_t entry[8]{static_cast<uint8_t>(get_instruction_size(instr)),
+                max_align_table[opcode], static_cast<uint8_t>(type.inputs.size()),
+                static_cast<uint8_t>(type.outputs.size())};
+            auto* out = &entry[4];
+            for (const auto input : type.inputs)
+                *out++ = static_cast<uint8_t>(input);
+            for (const auto output : type.outputs)
+                *out++ = static_cast<uint8_t>(output);
+            hash = hash_bytes({entry, sizeof(entry)}, hash);
+        }
+        return hash;
+    }();
+    return fingerprint;
+}
+
+uint64_t get_cache_key(bytes_view wasm_binary, const uint32_t* cost_table) noexcept
+{
+    static constexpr char version[] = FIZZY_VERSION;
+    auto key = hash_bytes({reinterpret_cast<const uint8_t*>(version), sizeof(version) - 1});
+    const auto fingerprint = get_encoding_fingerprint();
+    key = hash_bytes({reinterpret_cast<const uint8_t*>(&fingerprint), sizeof(fingerprint)}, key);
+    key = hash_bytes(wasm_binary, key);
+
+    const uint8_t metered = cost_table != nullptr;
+    key = hash_bytes({&metered, 1}, key);
+    if (cost_table != nullptr)
+    {
+        key = hash_bytes({reinterpret_cast<const uint8_t*>(cost_table),
+                             InstructionCostTableSize * sizeof(uint32_t)},
+            key);
+    }
+    return key;
+}
+
+/// Serializes the module sections into the payload, the values in the native byte order.
+class CacheWriter
+{
+    bytes m_payload;
+
+public:
+    bytes& payload() noexcept { return m_payload; }
+
+    template <typename T>
+    void write(T value)
+    {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+        m_payload.append(reinterpret_cast<const uint8_t*>(&value), sizeof(value));
+    }
+
+    void write(const std::string& str)
+    {
+        write(uint64_t{str.size()});
+        m_payload.append(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+    }
+
+    void write(const std::vector<uint8_t>& items)
+    {
+        write(uint64_t{items.size()});
+        m_payload.append(items.data(), items.size());
+    }
+
+    template <typename T>
+    void write(const std::vector<T>& items)
+    {
+        write(uint64_t{items.size()});
+        for (const auto& item : items)
+            write(item);
+    }
+
+    void write(const FuncType& type)
+    {
+        write(type.inputs);
+        write(type.outputs);
+    }
+
+    void write(const Limits& limits)
+    {
+        write(limits.min);
+        write(limits.max.has_value());
+        write(limits.max.value_or(0));
+    }
+
+    void write(const Table& table) { write(table.limits); }
+
+    void write(const Memory& memory) { write(memory.limits); }
+
+    void write(const GlobalType& type)
+    {
+        write(type.value_type);
+        write(type.is_mutable);
+    }
+
+    void write(const ConstantExpression& expression)
+    {
+        write(expression.kind);
+        if (expression.kind == ConstantExpression::Kind::Constant)
+            write(expression.value.constant.i64);
+        else
+            write(uint64_t{expression.value.global_index});
+    }
+
+    void write(const Import& import)
+    {
+        write(import.module);
+        write(import.name);
+        write(import.kind);
+        switch (import.kind)
+        {
+        case ExternalKind::Function:
+            write(import.desc.function_type_index);
+            break;
+        case ExternalKind::Table:
+            write(import.desc.table);
+            break;
+        case ExternalKind::Memory:
+            write(import.desc.memory);
+            break;
+        case ExternalKind::Global:
+            write(import.desc.global);
+            break;
+        default:                  // LCOV_EXCL_LINE
+            FIZZY_UNREACHABLE();  // LCOV_EXCL_LINE
+        }
+    }
+
+    void write(const Global& global)
+    {
+        write(global.type);
+        write(global.expression);
+    }
+
+    void write(const Export& export_)
+    {
+        write(export_.name);
+        write(export_.kind);
+        write(export_.index);
+    }
+
+    void write(const Element& element)
+    {
+        write(element.offset);
+        write(element.init);
+    }
+
+    void write(const Code& code)
+    {
+        write(code.max_stack_height);
+        write(code.local_count);
+        write(code.instructions);
+    }
+
+    /// Writes the data segment without its bytes, which are written after all sections.
+    void write(const Data& data)
+    {
+        write(data.offset);
+        write(uint64_t{data.init.size()});
+    }
+};
+
+/// Deserializes the module sections from the payload written by CacheWriter.
+/// Only checks that the payload is not read beyond its end.
+class CacheReader
+{
+    const uint8_t* m_pos = nullptr;
+    const uint8_t* m_end = nullptr;
+
+    const uint8_t* take(size_t size)
+    {
+        if (size > static_cast<size_t>(m_end - m_pos))
+            throw cache_error{"unexpected end of module cache"};
+        const auto* const pos = m_pos;
+        m_pos += size;
+        return pos;
+    }
+
+    /// Reads the number of items, each taking at least 1 byte.
+    size_t read_size()
+    {
+        const auto size = read<uint64_t>();
+        if (size > static_cast<uint64_t>(m_end - m_pos))
+            throw cache_error{"unexpected end of module cache"};
+        return static_cast<size_t>(size);
+    }
+
+public:
+    explicit CacheReader(bytes_view payload) noexcept
+      : m_pos{payload.data()}, m_end{payload.data() + payload.size()}
+    {}
+
+    const uint8_t* pos() const noexcept { return m_pos; }
+
+    template <typename T>
+    T read()
+    {
+        T value;
+        read(value);
+        return value;
+    }
+
+    template <typename T>
+    void read(T& value)
+    {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+        std::memcpy(&value, take(sizeof(value)), sizeof(value));
+    }
+
+    void read(std::string& str)
+    {
+        const auto size = read_size();
+        str.assign(reinterpret_cast<const char*>(take(size)), size);
+    }
+
+    void read(std::vector<uint8_t>& items)
+    {
+        const auto size = read_size();
+        const auto* const data = take(size);
+        items.assign(data, data + size);
+    }
+
+    template <typename T>
+    void read(std::vector<T>& items)
+    {
+        const auto size = read_size();
+        items.reserve(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            T item{};
+            read(item);
+            items.emplace_back(std::move(item));
+        }
+    }
+
+    void read(FuncType& type)
+    {
+        read(type.inputs);
+        read(type.outputs);
+    }
+
+    void read(Limits& limits)
+    {
+        read(limits.min);
+        const auto has_max = read<bool>();
+        const auto max = read<uint32_t>();
+        if (has_max)
+            limits.max = max;
+    }
+
+    void read(Table& table) { read(table.limits); }
+
+    void read(Memory& memory) { read(memory.limits); }
+
+    void read(GlobalType& type)
+    {
+        read(type.value_type);
+        read(type.is_mutable);
+    }
+
+    void read(ConstantExpression& expression)
+    {
+        read(expression.kind);
+        const auto value = read<uint64_t>();
+        if (expression.kind == ConstantExpression::Kind::Constant)
+            expression.value.constant = value;
+        else
+            expression.value.global_index = static_cast<uint32_t>(value);
+    }
+
+    void read(Import& import)
+    {
+        read(import.module);
+        read(import.name);
+        read(import.kind);
+        switch (import.kind)
+        {
+        case ExternalKind::Function:
+            read(import.desc.function_type_index);
+            break;
+        case ExternalKind::Table:
+            import.desc.table = {};
+            read(import.desc.table);
+            break;
+        case ExternalKind::Memory:
+            import.desc.memory = {};
+            read(import.desc.memory);
+            break;
+        case ExternalKind::Global:
+            import.desc.global = {};
+            read(import.desc.global);
+            break;
+        default:
+            throw cache_error{"invalid import kind in module cache"};
+        }
+    }
+
+    void read(Global& global)
+    {
+        read(global.type);
+        read(global.expression);
+    }
+
+    void read(Export& export_)
+    {
+        read(export_.name);
+        read(export_.kind);
+        read(export_.index);
+    }
+
+    void read(Element& element)
+    {
+        read(element.offset);
+        read(element.init);
+    }
+
+    void read(Code& code)
+    {
+        read(code.max_stack_height);
+        read(code.local_count);
+        read(code.instructions);
+    }
+
+    /// Reads the data segment without its bytes, leaving the view of their size with the null
+    /// data.
+    void read(Data& data)
+    {
+        read(data.offset);
+        data.init = {nullptr, read_size()};
+    }
+};
+
+/// Fills in the module information derived from the sections, as the parser does.
+void init_derived_info(Module& module)
+{
+    module.typesec_ids.reserve(module.typesec.size());
+    for (const auto& type : module.typesec)
+        module.typesec_ids.emplace_back(get_canonical_func_type_id(type));
+
+    for (const auto& import : module.importsec)
+    {
+        switch (import.kind)
+        {
+        case ExternalKind::Function:
+            if (import.desc.function_type_index >= module.typesec.size())
+                throw cache_error{"invalid type index in module cache"};
+            module.imported_function_types.emplace_back(
+                module.typesec[import.desc.function_type_index]);
+            module.function_type_ids.emplace_back(
+                module.typesec_ids[import.desc.function_type_index]);
+            break;
+        case ExternalKind::Table:
+            module.imported_table_types.emplace_back(import.desc.table);
+            break;
+        case ExternalKind::Memory:
+            module.imported_memory_types.emplace_back(import.desc.memory);
+            break;
+        case ExternalKind::Global:
+            module.imported_global_types.emplace_back(import.desc.global);
+            break;
+        default:                  // LCOV_EXCL_LINE
+            FIZZY_UNREACHABLE();  // LCOV_EXCL_LINE
+        }
+    }
+
+    for (const auto type_idx : module.funcsec)
+    {
+        if (type_idx >= module.typesec.size())
+            throw cache_error{"invalid type index in module cache"};
+        module.function_type_ids.emplace_back(module.typesec_ids[type_idx]);
+    }
+}
+
+/// The content of the cache file, mapped into memory where mmap() is available, otherwise read
+/// into the buffer.
+class CacheFile
+{
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    bytes m_content;
+
+public:
+    /// Throws cache_error if the file cannot be opened, mapped or read.
+    explicit CacheFile(const std::string& path)
+    {
+#if FIZZY_MAPPED_FILES
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+            throw cache_error{"cannot open module cache file " + path};
+
+        struct stat file_stat;
+        void* data = MAP_FAILED;
+        if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+        {
+            m_size = static_cast<size_t>(file_stat.st_size);
+            data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (data == MAP_FAILED)
+            throw cache_error{"cannot map module cache file " + path};
+        m_data = static_cast<const uint8_t*>(data);
+#else
+        const auto file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr)
+            throw cache_error{"cannot open module cache file " + path};
+
+        uint8_t buffer[4096];
+        size_t num_read;
+        while ((num_read = std::fread(buffer, 1, sizeof(buffer), file)) != 0)
+            m_content.append(buffer, num_read);
+        const auto failed = std::ferror(file) != 0;
+        std::fclose(file);
+        if (failed)
+            throw cache_error{"cannot read module cache file " + path};
+        m_data = m_content.data();
+        m_size = m_content.size();
+#endif
+    }
+
+    ~CacheFile() noexcept
+    {
+#if FIZZY_MAPPED_FILES
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+    }
+
+    CacheFile(const CacheFile&) = delete;
+    CacheFile& operator=(const CacheFile&) = delete;
+
+    bytes_view content() const noexcept { return {m_data, m_size}; }
+};
+
+std::unique_ptr<const Module> load_module(
+    std::shared_ptr<const CacheFile> file, uint64_t key, const std::string& path)
+{
+    const auto content = file->content();
+    CacheHeader header;
+    if (content.size() < sizeof(header))
+        throw cache_error{"invalid module cache file " + path};
+    std::memcpy(&header, content.data(), sizeof(header));
+
+    const auto payload = content.substr(sizeof(header));
+    if (!std::equal(std::begin(CacheMagic), std::end(CacheMagic), header.magic) ||
+        header.version != CacheVersion || header.payload_size != payload.size())
+        throw cache_error{"invalid module cache file " + path};
+    if (header.key != key)
+        throw cache_error{"module cache file " + path + " doesn't match the module"};
+    if (header.checksum != hash_bytes(payload))
+        throw cache_error{"corrupted module cache file " + path};
+
+    auto module = std::make_unique<Module>();
+    CacheReader reader{payload};
+    reader.read(module->typesec);
+    reader.read(module->importsec);
+    reader.read(module->funcsec);
+    reader.read(module->tablesec);
+    reader.read(module->memorysec);
+    reader.read(module->globalsec);
+    reader.read(module->exportsec);
+    if (reader.read<bool>())
+        module->startfunc = reader.read<uint32_t>();
+    reader.read(module->elementsec);
+    reader.read(module->codesec);
+    reader.read(module->datasec);
+
+    // The data segments refer to the rest of the payload, which is kept with the module.
+    const auto* data_pos = reader.pos();
+    const auto* const data_end = payload.data() + payload.size();
+    for (auto& data : module->datasec)
+    {
+        if (data.init.size() > static_cast<size_t>(data_end - data_pos))
+            throw cache_error{"unexpected end of module cache"};
+        data.init = {data_pos, data.init.size()};
+        data_pos += data.init.size();
+    }
+    if (data_pos != data_end)
+        throw cache_error{"invalid module cache file " + path};
+    if (!module->datasec.empty())
+        module->data_storage = std::move(file);
+
+    init_derived_info(*module);
+    return module;
+}
+}  // namespace
+
+void save_module_cache(const Module& module, bytes_view wasm_binary, const std::string& path,
+    const uint32_t* cost_table)
+{
+    if (module.lazy_codesec != nullptr)
+        throw cache_error{"module parsed lazily cannot be cached"};
+
+    CacheWriter writer;
+    writer.write(module.typesec);
+    writer.write(module.importsec);
+    writer.write(module.funcsec);
+    writer.write(module.tablesec);
+    writer.write(module.memorysec);
+    writer.write(module.globalsec);
+    writer.write(module.exportsec);
+    writer.write(module.startfunc.has_value());
+    if (module.startfunc.has_value())
+        writer.write(*module.startfunc);
+    writer.write(module.elementsec);
+    writer.write(module.codesec);
+    writer.write(module.datasec);
+    for (const auto& data : module.datasec)
+        writer.payload().append(data.init);
+    const auto& payload = writer.payload();
+
+    CacheHeader header{};
+    std::copy(std::begin(CacheMagic), std::end(CacheMagic), header.magic);
+    header.version = CacheVersion;
+    header.key = get_cache_key(wasm_binary, cost_table);
+    header.payload_size = payload.size();
+    header.checksum = hash_bytes(payload);
+
+    // The file is written under a temporary name and then renamed, so that the module is never
+    // loaded from the partially written file.
+    const auto tmp_path = path + ".tmp";
+    auto* const file = std::fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr)
+        throw cache_error{"cannot write module cache file " + path};
+    const auto written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                         std::fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+    if (std::fclose(file) != 0 || !written || std::rename(tmp_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(tmp_path.c_str());
+        throw cache_error{"cannot write module cache file " + path};
+    }
+}
+
+std::unique_ptr<const Module> load_module_cache(
+    bytes_view wasm_binary, const std::string& path, const uint32_t* cost_table)
+{
+    try
+    {
+        return load_module(
+            std::make_shared<const CacheFile>(path), get_cache_key(wasm_binary, cost_table), path);
+    }
+    catch (const cache_error&)
+    {
+        return nullptr;
+    }
+}
+}  // namespace fizzy
@@ -0,0 +1,43 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "bytes.hpp"
+#include "module.hpp"
+#include <memory>
+#include <string>
+
+namespace fizzy
+{
+/// Saves the module parsed from the wasm binary to the cache file, including the translated code
+/// of its functions, so that load_module_cache() can load it without parsing and validating.
+///
+/// The file is tied to the wasm binary, the cost table, the internal code encoding and the version
+/// of Fizzy: it is not loaded for a different one of any of them. The values are stored
+/// in the native byte order.
+///
+/// @param module      The module parsed from the binary by parse() with the cost table.
+///                    The module parsed lazily cannot be saved.
+/// @param wasm_binary The wasm binary the module was parsed from.
+/// @param path        The path of the cache file.
+/// @param cost_table  The instruction cost table the module was parsed with, or nullptr.
+/// Throws cache_error if the module cannot be saved.
+void save_module_cache(const Module& module, bytes_view wasm_binary, const std::string& path,
+    const uint32_t* cost_table = nullptr);
+
+/// Loads the module of the wasm binary from the cache file saved by save_module_cache().
+///
+/// The module is trusted: it is not validated again, only the checksum of the file is verified.
+/// Where mmap() is available the file is mapped into memory and the data segments of the module
+/// (Data::init) refer to the mapping, which is unmapped when the module and its copies are
+/// destroyed. The file must not be modified while the module exists. The translated code
+/// of the functions is copied out of the file.
+///
+/// Returns nullptr if the file doesn't exist or cannot be read, is corrupted, or was saved
+/// for a different binary, cost table, code encoding or version of Fizzy. The module should be
+/// parsed then.
+std::unique_ptr<const Module> load_module_cache(
+    bytes_view wasm_binary, const std::string& path, const uint32_t* cost_table = nullptr);
+}  // namespace fizzy
@@ -4,11 +4,21 @@
 
 #include "parser.hpp"
 #include "asserts.hpp"
+#include "instructions.hpp"
 #include "leb128.hpp"
 #include "limits.hpp"
+#include "peephole.hpp"
+#include "superinstructions.hpp"
 #include "types.hpp"
 #include "utf8.hpp"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <exception>
+#include <new>
+#include <optional>
+#include <system_error>
+#include <thread>
 #include <unordered_set>
 
 namespace fizzy
@@ -376,7 +386,8 @@ inline parser_result<code_view> parse(const uint8_t* pos, const uint8_t* end)
     return {{code_begin, code_size}, code_end};
 }
 
-inline Code parse_code(code_view code_binary, FuncIdx func_idx, const Module& module)
+inline Code parse_code(
+    code_view code_binary, FuncIdx func_idx, const Module& module, const uint32_t* cost_table)
 {
     const auto begin = code_binary.begin();
     const auto end = code_binary.end();
@@ -395,16 +406,91 @@ inline Code parse_code(code_view code_binary, FuncIdx func_idx, const Module& mo
     assert((uint64_t{local_count} + module.typesec[module.funcsec[func_idx]].inputs.size()) <=
            std::numeric_limits<uint32_t>::max());
 
-    auto [code, pos2] = parse_expr(pos1, end, func_idx, locals_vec, module);
+    auto [code, pos2] = parse_expr(pos1, end, func_idx, locals_vec, module, cost_table);
 
     // Size is the total bytes of locals and expressions.
     if (pos2 != end)
         throw parser_error{"malformed size field for function"};
 
     code.local_count = static_cast<uint32_t>(local_count);
+    peephole_optimize(code);
+    fuse_superinstructions(code);
     return code;
 }
 
+/// Parses the function bodies of the code section on the given number of threads, including
+/// the calling one, or on all hardware threads if 0.
+inline std::vector<Code> parse_code_section(const std::vector<code_view>& code_binaries,
+    const Module& module, const uint32_t* cost_table, unsigned num_threads)
+{
+    if (num_threads == 0)
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::vector<Code> codes;
+    if (num_threads == 1 || code_binaries.size() <= 1)
+    {
+        codes.reserve(code_binaries.size());
+        for (size_t i = 0; i < code_binaries.size(); ++i)
+        {
+            codes.emplace_back(
+                parse_code(code_binaries[i], static_cast<FuncIdx>(i), module, cost_table));
+        }
+        return codes;
+    }
+
+    // The functions are taken in the order of their indices, so all functions before the first
+    // invalid one are parsed and its error is reported, as in the serial parsing. The functions
+    // after it are skipped.
+    codes.resize(code_binaries.size());
+    std::vector<std::exception_ptr> errors(code_binaries.size());
+    std::atomic<size_t> next_idx{0};
+    std::atomic<size_t> first_error_idx{code_binaries.size()};
+    const auto parse_functions = [&]() noexcept {
+        while (true)
+        {
+            const auto i = next_idx.fetch_add(1, std::memory_order_relaxed);
+            if (i >= first_error_idx.load(std::memory_order_relaxed))
+                return;
+
+            try
+            {
+                codes[i] =
+                    parse_code(code_binaries[i], static_cast<FuncIdx>(i), module, cost_table);
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+                auto current_idx = first_error_idx.load(std::memory_order_relaxed);
+                while (i < current_idx && !first_error_idx.compare_exchange_weak(current_idx, i))
+                {
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(std::min(size_t{num_threads}, code_binaries.size()) - 1);
+    while (threads.size() < threads.capacity())
+    {
+        try
+        {
+            threads.emplace_back(parse_functions);
+        }
+        catch (const std::system_error&)
+        {
+            // Continue with the threads already running.
+            break;
+        }
+    }
+    parse_functions();
+    for (auto& thread : threads)
+        thread.join();
+
+    if (const auto error_idx = first_error_idx.load(); error_idx != code_binaries.size())
+        std::rethrow_exception(errors[error_idx]);
+    return codes;
+}
+
 template <>
 inline parser_result<Data> parse(const uint8_t* pos, const uint8_t* end)
 {
@@ -425,169 +511,164 @@ inline parser_result<Data> parse(const uint8_t* pos, const uint8_t* end)
     if ((end - pos) < size)
         throw parser_error{"unexpected EOF"};
 
-    auto init = bytes(pos, pos + size);
+    const bytes_view init{pos, size};
     pos += size;
 
-    return {{offset, std::move(init)}, pos};
+    return {{offset, init}, pos};
 }
 
-std::unique_ptr<const Module> parse(bytes_view input)
+/// Validates the section order: the non-custom sections must be in the order of their ids
+/// and appear at most once.
+inline void validate_section_order(SectionId id, SectionId& last_id)
 {
-    if (input.substr(0, wasm_prefix.size()) != wasm_prefix)
-        throw parser_error{"invalid wasm module prefix"};
-
-    input.remove_prefix(wasm_prefix.size());
-
-    auto module{std::make_unique<Module>()};
-    std::vector<code_view> code_binaries;
-    SectionId last_id = SectionId::custom;
-    for (auto it = input.begin(); it != input.end();)
+    if (id != SectionId::custom)
     {
-        const auto id = static_cast<SectionId>(*it++);
-        if (id != SectionId::custom)
-        {
-            if (id <= last_id)
-                throw parser_error{"unexpected out-of-order section type"};
-            last_id = id;
-        }
-
-        uint32_t size;
-        std::tie(size, it) = leb128u_decode<uint32_t>(it, input.end());
-
-        if ((input.end() - it) < size)
-            throw parser_error{"unexpected EOF"};
+        if (id <= last_id)
+            throw parser_error{"unexpected out-of-order section type"};
+        last_id = id;
+    }
+}
 
-        const auto expected_section_end = it + size;
-        switch (id)
-        {
-        case SectionId::type:
-            std::tie(module->typesec, it) = parse_vec<FuncType>(it, input.end());
-            break;
-        case SectionId::import:
-            std::tie(module->importsec, it) = parse_vec<Import>(it, input.end());
-            break;
-        case SectionId::function:
-            std::tie(module->funcsec, it) = parse_vec<TypeIdx>(it, input.end());
-            break;
-        case SectionId::table:
-            std::tie(module->tablesec, it) = parse_vec<Table>(it, input.end());
-            break;
-        case SectionId::memory:
-            std::tie(module->memorysec, it) = parse_vec<Memory>(it, input.end());
-            break;
-        case SectionId::global:
-            std::tie(module->globalsec, it) = parse_vec<Global>(it, input.end());
-            break;
-        case SectionId::export_:
-            std::tie(module->exportsec, it) = parse_vec<Export>(it, input.end());
-            break;
-        case SectionId::start:
-            std::tie(module->startfunc, it) = leb128u_decode<uint32_t>(it, input.end());
-            break;
-        case SectionId::element:
-            std::tie(module->elementsec, it) = parse_vec<Element>(it, input.end());
-            break;
-        case SectionId::code:
-            std::tie(code_binaries, it) = parse_vec<code_view>(it, input.end());
-            break;
-        case SectionId::data:
-            std::tie(module->datasec, it) = parse_vec<Data>(it, input.end());
-            break;
-        case SectionId::custom:
-            // NOTE: this section can be ignored, but the name must be parseable (and valid UTF-8)
-            parse_string(it, expected_section_end);
-            // These sections are ignored for now.
-            it += size;
-            break;
-        default:
-            throw parser_error{
-                "unknown section encountered " + std::to_string(static_cast<int>(id))};
-        }
+/// Parses the content of the section into the module, except the function bodies of the code
+/// section, which are only recorded in code_binaries.
+///
+/// @param pos           The beginning of the section content.
+/// @param section_end   The end of the section content as declared by the section size.
+/// @param end           The end of the binary input.
+/// @param code_binaries The references to the function bodies of the code section.
+inline void parse_section(Module& module, SectionId id, const uint8_t* pos,
+    const uint8_t* section_end, const uint8_t* end, std::vector<code_view>& code_binaries)
+{
+    switch (id)
+    {
+    case SectionId::type:
+        std::tie(module.typesec, pos) = parse_vec<FuncType>(pos, end);
+        break;
+    case SectionId::import:
+        std::tie(module.importsec, pos) = parse_vec<Import>(pos, end);
+        break;
+    case SectionId::function:
+        std::tie(module.funcsec, pos) = parse_vec<TypeIdx>(pos, end);
+        break;
+    case SectionId::table:
+        std::tie(module.tablesec, pos) = parse_vec<Table>(pos, end);
+        break;
+    case SectionId::memory:
+        std::tie(module.memorysec, pos) = parse_vec<Memory>(pos, end);
+        break;
+    case SectionId::global:
+        std::tie(module.globalsec, pos) = parse_vec<Global>(pos, end);
+        break;
+    case SectionId::export_:
+        std::tie(module.exportsec, pos) = parse_vec<Export>(pos, end);
+        break;
+    case SectionId::start:
+        std::tie(module.startfunc, pos) = leb128u_decode<uint32_t>(pos, end);
+        break;
+    case SectionId::element:
+        std::tie(module.elementsec, pos) = parse_vec<Element>(pos, end);
+        break;
+    case SectionId::code:
+        std::tie(code_binaries, pos) = parse_vec<code_view>(pos, end);
+        break;
+    case SectionId::data:
+        std::tie(module.datasec, pos) = parse_vec<Data>(pos, end);
+        break;
+    case SectionId::custom:
+        // NOTE: this section can be ignored, but the name must be parseable (and valid UTF-8)
+        parse_string(pos, section_end);
+        // These sections are ignored for now.
+        pos = section_end;
+        break;
+    default:
+        throw parser_error{"unknown section encountered " + std::to_string(static_cast<int>(id))};
+    }
 
-        if (it != expected_section_end)
-        {
-            throw parser_error{"incorrect section " + std::to_string(static_cast<int>(id)) +
-                               " size, difference: " + std::to_string(it - expected_section_end)};
-        }
+    if (pos != section_end)
+    {
+        throw parser_error{"incorrect section " + std::to_string(static_cast<int>(id)) +
+                           " size, difference: " + std::to_string(pos - section_end)};
     }
+}
 
-    // Validation checks
+/// Validates the sections preceding the code section and fills in the module type information
+/// the function bodies are validated with.
+inline void validate_sections(Module& module)
+{
+    module.typesec_ids.reserve(module.typesec.size());
+    for (const auto& type : module.typesec)
+        module.typesec_ids.emplace_back(get_canonical_func_type_id(type));
 
     // Split imports by kind
-    for (const auto& import : module->importsec)
+    for (const auto& import : module.importsec)
     {
         switch (import.kind)
         {
         case ExternalKind::Function:
-            if (import.desc.function_type_index >= module->typesec.size())
+            if (import.desc.function_type_index >= module.typesec.size())
                 throw validation_error{"invalid type index of an imported function"};
-            module->imported_function_types.emplace_back(
-                module->typesec[import.desc.function_type_index]);
+            module.imported_function_types.emplace_back(
+                module.typesec[import.desc.function_type_index]);
+            module.function_type_ids.emplace_back(
+                module.typesec_ids[import.desc.function_type_index]);
             break;
         case ExternalKind::Table:
-            module->imported_table_types.emplace_back(import.desc.table);
+            module.imported_table_types.emplace_back(import.desc.table);
             break;
         case ExternalKind::Memory:
-            module->imported_memory_types.emplace_back(import.desc.memory);
+            module.imported_memory_types.emplace_back(import.desc.memory);
             break;
         case ExternalKind::Global:
-            module->imported_global_types.emplace_back(import.desc.global);
+            module.imported_global_types.emplace_back(import.desc.global);
             break;
         default:                  // LCOV_EXCL_LINE
             FIZZY_UNREACHABLE();  // LCOV_EXCL_LINE
         }
     }
 
-    for (const auto type_idx : module->funcsec)
+    for (const auto type_idx : module.funcsec)
     {
-        if (type_idx >= module->typesec.size())
+        if (type_idx >= module.typesec.size())
             throw validation_error{"invalid function type index"};
     }
 
-    if (module->tablesec.size() > 1)
+    for (const auto type_idx : module.funcsec)
+        module.function_type_ids.emplace_back(module.typesec_ids[type_idx]);
+
+    if (module.tablesec.size() > 1)
         throw validation_error{"too many table sections (at most one is allowed)"};
 
-    if (module->memorysec.size() > 1)
+    if (module.memorysec.size() > 1)
         throw validation_error{"too many memory sections (at most one is allowed)"};
 
-    if (module->imported_memory_types.size() > 1)
+    if (module.imported_memory_types.size() > 1)
         throw validation_error{"too many imported memories (at most one is allowed)"};
 
-    if (!module->memorysec.empty() && !module->imported_memory_types.empty())
+    if (!module.memorysec.empty() && !module.imported_memory_types.empty())
     {
         throw validation_error{
             "both module memory and imported memory are defined (at most one of them is allowed)"};
     }
 
-    if (!module->datasec.empty() && !module->has_memory())
-        throw validation_error{"data section encountered without a memory section"};
-
-    for (const auto& data : module->datasec)
-    {
-        // Offset expression is required to have i32 result value
-        // https://webassembly.github.io/spec/core/valid/modules.html#data-segments
-        validate_constant_expression(data.offset, *module, ValType::i32);
-    }
-
-    if (module->imported_table_types.size() > 1)
+    if (module.imported_table_types.size() > 1)
         throw validation_error{"too many imported tables (at most one is allowed)"};
 
-    if (!module->tablesec.empty() && !module->imported_table_types.empty())
+    if (!module.tablesec.empty() && !module.imported_table_types.empty())
     {
         throw validation_error{
             "both module table and imported table are defined (at most one of them is allowed)"};
     }
 
-    if (!module->elementsec.empty() && !module->has_table())
+    if (!module.elementsec.empty() && !module.has_table())
         throw validation_error{"element section encountered without a table section"};
 
-    const auto total_func_count = module->get_function_count();
+    const auto total_func_count = module.get_function_count();
 
-    for (const auto& element : module->elementsec)
+    for (const auto& element : module.elementsec)
     {
         // Offset expression is required to have i32 result value
         // https://webassembly.github.io/spec/core/valid/modules.html#element-segments
-        validate_constant_expression(element.offset, *module, ValType::i32);
+        validate_constant_expression(element.offset, module, ValType::i32);
         for (const auto func_idx : element.init)
         {
             if (func_idx >= total_func_count)
@@ -595,28 +676,24 @@ std::unique_ptr<const Module> parse(bytes_view input)
         }
     }
 
-    const auto total_global_count = module->get_global_count();
-    for (const auto& global : module->globalsec)
+    const auto total_global_count = module.get_global_count();
+    for (const auto& global : module.globalsec)
     {
-        validate_constant_expression(global.expression, *module, global.type.value_type);
+        validate_constant_expression(global.expression, module, global.type.value_type);
 
         // Wasm spec section 3.3.7 constrains initialization by another global to const imports only
         // https://webassembly.github.io/spec/core/valid/instructions.html#expressions
         if (global.expression.kind == ConstantExpression::Kind::GlobalGet &&
-            global.expression.value.global_index >= module->imported_global_types.size())
+            global.expression.value.global_index >= module.imported_global_types.size())
         {
             throw validation_error{
                 "global can be initialized by another const global only if it's imported"};
         }
     }
 
-
-    if (module->funcsec.size() != code_binaries.size())
-        throw parser_error{"malformed binary: number of function and code entries must match"};
-
     // Validate exports.
     std::unordered_set<std::string_view> export_names;
-    for (const auto& export_ : module->exportsec)
+    for (const auto& export_ : module.exportsec)
     {
         switch (export_.kind)
         {
@@ -625,11 +702,11 @@ std::unique_ptr<const Module> parse(bytes_view input)
                 throw validation_error{"invalid index of an exported function"};
             break;
         case ExternalKind::Table:
-            if (export_.index != 0 || !module->has_table())
+            if (export_.index != 0 || !module.has_table())
                 throw validation_error{"invalid index of an exported table"};
             break;
         case ExternalKind::Memory:
-            if (export_.index != 0 || !module->has_memory())
+            if (export_.index != 0 || !module.has_memory())
                 throw validation_error{"invalid index of an exported memory"};
             break;
         case ExternalKind::Global:
@@ -643,25 +720,350 @@ std::unique_ptr<const Module> parse(bytes_view input)
             throw validation_error{"duplicate export name " + export_.name};
     }
 
-    if (module->startfunc)
+    if (module.startfunc)
     {
-        if (*module->startfunc >= total_func_count)
+        if (*module.startfunc >= total_func_count)
             throw validation_error{"invalid start function index"};
 
-        const auto& func_type = module->get_function_type(*module->startfunc);
+        const auto& func_type = module.get_function_type(*module.startfunc);
         if (!func_type.inputs.empty() || !func_type.outputs.empty())
             throw validation_error{"invalid start function type"};
     }
+}
 
-    // Process code. TODO: This can be done lazily.
-    module->codesec.reserve(code_binaries.size());
-    for (size_t i = 0; i < code_binaries.size(); ++i)
-        module->codesec.emplace_back(
-            parse_code(code_binaries[i], static_cast<FuncIdx>(i), *module));
+inline void validate_code_count(const Module& module, size_t code_count)
+{
+    if (module.funcsec.size() != code_count)
+        throw parser_error{"malformed binary: number of function and code entries must match"};
+}
+
+/// Validates the data section, which follows the code section.
+inline void validate_data_section(const Module& module)
+{
+    if (!module.datasec.empty() && !module.has_memory())
+        throw validation_error{"data section encountered without a memory section"};
+
+    for (const auto& data : module.datasec)
+    {
+        // Offset expression is required to have i32 result value
+        // https://webassembly.github.io/spec/core/valid/modules.html#data-segments
+        validate_constant_expression(data.offset, module, ValType::i32);
+    }
+}
+
+/// Copies the data segments into the storage owned by the module, so that they don't refer to
+/// the wasm binary.
+inline void copy_data_segments(Module& module)
+{
+    if (module.datasec.empty())
+        return;
+
+    size_t total_size = 0;
+    for (const auto& data : module.datasec)
+        total_size += data.init.size();
+
+    auto storage = std::make_shared<bytes>();
+    storage->reserve(total_size);
+    for (auto& data : module.datasec)
+    {
+        const auto offset = storage->size();
+        storage->append(data.init);
+        data.init = {storage->data() + offset, data.init.size()};
+    }
+    module.data_storage = std::move(storage);
+}
+
+/// Parses the module with the function bodies parsed either by parse_code_section() or lazily,
+/// and with the data segments either copied or referring to the input.
+inline std::unique_ptr<const Module> parse_module(bytes_view input, const uint32_t* cost_table,
+    unsigned num_threads, bool lazy, bool copy_data)
+{
+    if (input.substr(0, wasm_prefix.size()) != wasm_prefix)
+        throw parser_error{"invalid wasm module prefix"};
+
+    input.remove_prefix(wasm_prefix.size());
+
+    auto module{std::make_unique<Module>()};
+    std::vector<code_view> code_binaries;
+    SectionId last_id = SectionId::custom;
+    for (auto it = input.begin(); it != input.end();)
+    {
+        const auto id = static_cast<SectionId>(*it++);
+        validate_section_order(id, last_id);
+
+        uint32_t size;
+        std::tie(size, it) = leb128u_decode<uint32_t>(it, input.end());
+
+        if ((input.end() - it) < size)
+            throw parser_error{"unexpected EOF"};
+
+        parse_section(*module, id, it, it + size, input.end(), code_binaries);
+        it += size;
+    }
+
+    validate_sections(*module);
+    validate_code_count(*module, code_binaries.size());
+    validate_data_section(*module);
+    if (copy_data)
+        copy_data_segments(*module);
+
+    // Process code.
+    if (lazy)
+        module->lazy_codesec = std::make_shared<LazyCodeSection>(code_binaries, cost_table);
+    else
+        module->codesec = parse_code_section(code_binaries, *module, cost_table, num_threads);
 
     return module;
 }
 
+LazyCodeSection::LazyCodeSection(
+    const std::vector<code_view>& code_binaries, const uint32_t* cost_table)
+  : m_codes{new std::atomic<const Code*>[code_binaries.size()]},
+    m_parsed_codes(code_binaries.size())
+{
+    m_offsets.reserve(code_binaries.size() + 1);
+    for (size_t i = 0; i < code_binaries.size(); ++i)
+    {
+        m_offsets.emplace_back(m_binary.size());
+        m_binary.append(code_binaries[i]);
+        m_codes[i] = nullptr;
+    }
+    m_offsets.emplace_back(m_binary.size());
+
+    if (cost_table != nullptr)
+        m_cost_table.assign(cost_table, cost_table + InstructionCostTableSize);
+}
+
+const Code& LazyCodeSection::parse(size_t code_idx, const Module& module) const noexcept
+{
+    // The function which cannot be parsed traps when executed.
+    static const Code trap_code{0, 0, {static_cast<uint8_t>(Instr::unreachable)}};
+
+    std::unique_lock lock{m_mutex, std::defer_lock};
+    try
+    {
+        lock.lock();
+    }
+    catch (const std::system_error&)
+    {
+        // The function traps if the mutex cannot be locked. The parsing is retried on the next use.
+        return trap_code;
+    }
+    if (const auto* code = m_codes[code_idx].load(std::memory_order_relaxed); code != nullptr)
+        return *code;
+
+    const auto* code = &trap_code;
+    try
+    {
+        const code_view code_binary{
+            &m_binary[m_offsets[code_idx]], m_offsets[code_idx + 1] - m_offsets[code_idx]};
+        m_parsed_codes[code_idx] = std::make_unique<const Code>(
+            parse_code(code_binary, static_cast<FuncIdx>(code_idx), module,
+                !m_cost_table.empty() ? m_cost_table.data() : nullptr));
+        code = m_parsed_codes[code_idx].get();
+    }
+    catch (const std::bad_alloc&)
+    {
+        // Not stored, the parsing is retried on the next use.
+        return trap_code;
+    }
+    catch (...)
+    {
+    }
+    m_codes[code_idx].store(code, std::memory_order_release);
+    return *code;
+}
+
+std::unique_ptr<const Module> parse(
+    bytes_view input, const uint32_t* cost_table, unsigned num_threads)
+{
+    return parse_module(input, cost_table, num_threads, false, true);
+}
+
+std::unique_ptr<const Module> parse_in_place(
+    bytes_view input, const uint32_t* cost_table, unsigned num_threads)
+{
+    return parse_module(input, cost_table, num_threads, false, false);
+}
+
+std::unique_ptr<const Module> parse_lazy(bytes_view input, const uint32_t* cost_table)
+{
+    return parse_module(input, cost_table, 1, true, true);
+}
+
+namespace
+{
+/// Decodes the u32 LEB128 value like leb128u_decode() if all its bytes are available.
+/// Returns std::nullopt if the bytes may still arrive, unless the input is complete.
+std::optional<parser_result<uint32_t>> try_leb128u_decode_u32(
+    const uint8_t* pos, const uint8_t* end, bool complete)
+{
+    // The u32 value takes at most 5 bytes, the last one with the highest bit cleared.
+    constexpr ptrdiff_t max_size = 5;
+    if (!complete && end - pos < max_size &&
+        std::find_if(pos, end, [](uint8_t byte) { return (byte & 0x80) == 0; }) == end)
+        return std::nullopt;
+
+    return leb128u_decode<uint32_t>(pos, end);
+}
+}  // namespace
+
+StreamingParser::StreamingParser(const uint32_t* cost_table)
+  : m_cost_table{cost_table}, m_module{std::make_unique<Module>()}
+{}
+
+void StreamingParser::push(bytes_view chunk)
+{
+    assert(m_module != nullptr);
+
+    // The chunk is parsed in place and only the bytes of the incomplete item are kept.
+    if (m_buffer.empty())
+    {
+        const auto* const end = chunk.data() + chunk.size();
+        m_buffer.assign(parse_available(chunk.data(), end), end);
+    }
+    else
+    {
+        m_buffer.append(chunk);
+        const auto* const pos = parse_available(m_buffer.data(), m_buffer.data() + m_buffer.size());
+        m_buffer.erase(0, static_cast<size_t>(pos - m_buffer.data()));
+    }
+}
+
+std::unique_ptr<const Module> StreamingParser::finish()
+{
+    assert(m_module != nullptr);
+
+    if (m_state == State::prefix)
+        throw parser_error{"invalid wasm module prefix"};
+    if (m_state != State::section || !m_buffer.empty())
+        throw parser_error{"unexpected EOF"};
+
+    if (!m_sections_validated)
+    {
+        validate_sections(*m_module);
+        validate_code_count(*m_module, 0);
+    }
+    validate_data_section(*m_module);
+
+    return std::move(m_module);
+}
+
+const uint8_t* StreamingParser::parse_available(const uint8_t* pos, const uint8_t* end)
+{
+    while (true)
+    {
+        switch (m_state)
+        {
+        case State::prefix:
+        {
+            if (static_cast<size_t>(end - pos) < wasm_prefix.size())
+                return pos;
+            if (bytes_view{pos, wasm_prefix.size()} != wasm_prefix)
+                throw parser_error{"invalid wasm module prefix"};
+            pos += wasm_prefix.size();
+            m_state = State::section;
+            break;
+        }
+
+        case State::section:
+        {
+            if (pos == end)
+                return pos;
+
+            const auto id = static_cast<SectionId>(*pos);
+            const auto size_result = try_leb128u_decode_u32(pos + 1, end, false);
+            if (!size_result)
+                return pos;
+            const auto [size, section_begin] = *size_result;
+
+            if (id == SectionId::code)
+            {
+                validate_section_order(id, m_last_id);
+                if (!m_sections_validated)
+                {
+                    validate_sections(*m_module);
+                    m_sections_validated = true;
+                }
+                m_code_section_size_left = size;
+                m_state = State::code_count;
+                pos = section_begin;
+                break;
+            }
+
+            // Other sections are parsed when complete.
+            if (end - section_begin < size)
+                return pos;
+
+            validate_section_order(id, m_last_id);
+            std::vector<code_view> code_binaries;
+            parse_section(*m_module, id, section_begin, section_begin + size, section_begin + size,
+                code_binaries);
+            // The buffer doesn't outlive the parser.
+            if (id == SectionId::data)
+                copy_data_segments(*m_module);
+            pos = section_begin + size;
+            break;
+        }
+
+        case State::code_count:
+        {
+            const auto num_available = static_cast<size_t>(end - pos);
+            const auto section_complete = num_available >= m_code_section_size_left;
+            const auto count_result = try_leb128u_decode_u32(
+                pos, section_complete ? pos + m_code_section_size_left : end, section_complete);
+            if (!count_result)
+                return pos;
+            const auto [count, next] = *count_result;
+
+            validate_code_count(*m_module, count);
+            m_module->codesec.reserve(count);
+            m_code_section_size_left -= static_cast<size_t>(next - pos);
+            pos = next;
+            m_state = State::code_entry;
+            break;
+        }
+
+        case State::code_entry:
+        {
+            if (m_module->codesec.size() == m_module->funcsec.size())
+            {
+                if (m_code_section_size_left != 0)
+                {
+                    throw parser_error{"incorrect section " +
+                                       std::to_string(static_cast<int>(SectionId::code)) +
+                                       " size, difference: -" +
+                                       std::to_string(m_code_section_size_left)};
+                }
+                m_state = State::section;
+                break;
+            }
+
+            const auto num_available = static_cast<size_t>(end - pos);
+            const auto section_complete = num_available >= m_code_section_size_left;
+            const auto* const section_end = section_complete ? pos + m_code_section_size_left : end;
+            const auto size_result = try_leb128u_decode_u32(pos, section_end, section_complete);
+            if (!size_result)
+                return pos;
+            const auto [size, code_begin] = *size_result;
+
+            if (m_code_section_size_left - static_cast<size_t>(code_begin - pos) < size)
+                throw parser_error{"unexpected EOF"};
+            if (end - code_begin < size)
+                return pos;
+
+            // The function body is validated as soon as it arrives.
+            const auto func_idx = static_cast<FuncIdx>(m_module->codesec.size());
+            m_module->codesec.emplace_back(
+                parse_code(code_view{code_begin, size}, func_idx, *m_module, m_cost_table));
+            m_code_section_size_left -= static_cast<size_t>(code_begin + size - pos);
+            pos = code_begin + size;
+            break;
+        }
+        }
+    }
+}
+
 parser_result<std::vector<uint32_t>> parse_vec_i32(const uint8_t* pos, const uint8_t* end)
 {
     return parse_vec<uint32_t>(pos, end);
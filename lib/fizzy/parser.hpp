@@ -17,7 +17,90 @@ constexpr bytes_view wasm_prefix{wasm_prefix_data, sizeof(wasm_prefix_data)};
 template <typename T>
 using parser_result = std::pair<T, const uint8_t*>;
 
-std::unique_ptr<const Module> parse(bytes_view input);
+/// Parses and validates the wasm binary module.
+///
+/// @param input       The wasm binary.
+/// @param cost_table  The instruction cost table (see get_default_instruction_cost_table()) to
+///                    meter the code of the module with, or nullptr to not meter it.
+///                    The metered execution is charged the costs of the executed instructions
+///                    (see ExecutionContext::charge_gas()).
+/// @param num_threads The number of threads parsing and validating the function bodies in
+///                    parallel, including the calling one, or 0 to use all hardware threads.
+///                    The error of the invalid function of the lowest index is reported
+///                    regardless of the number of threads.
+std::unique_ptr<const Module> parse(
+    bytes_view input, const uint32_t* cost_table = nullptr, unsigned num_threads = 1);
+
+/// Parses the wasm binary module like parse(), but without copying the data segments.
+///
+/// The data segments of the module (Data::init) refer to the input instead, so the input must
+/// outlive the module and its copies. This saves the copy of big data sections, especially of
+/// the binary mapped from a file: instantiate() copies the segments straight from the input.
+std::unique_ptr<const Module> parse_in_place(
+    bytes_view input, const uint32_t* cost_table = nullptr, unsigned num_threads = 1);
+
+/// Parses the wasm binary module like parse(), but without validating the function bodies.
+///
+/// Each function body is validated and translated on its first execution instead, which saves
+/// the time spent on the functions which are never executed. The function which turns out to be
+/// invalid traps when executed. The module keeps the copy of the function bodies and of the
+/// cost table, so the input doesn't need to outlive it.
+std::unique_ptr<const Module> parse_lazy(bytes_view input, const uint32_t* cost_table = nullptr);
+
+/// The parser of the wasm binary module arriving in chunks, e.g. read from a file or a pipe
+/// or received from the network.
+///
+/// Each section is parsed as soon as all its bytes arrive and each function body is validated
+/// as soon as it is complete, while the rest of the code section is still arriving. Only the bytes
+/// of the incomplete section or function body are kept, so the whole binary is never held
+/// in memory. The module is validated like by parse().
+class StreamingParser
+{
+public:
+    /// @param cost_table  The instruction cost table to meter the code with, see parse().
+    ///                    It must outlive the parser.
+    explicit StreamingParser(const uint32_t* cost_table = nullptr);
+
+    /// Parses the sections and the function bodies completed by the next chunk of the binary.
+    /// Throws parser_error or validation_error if the module is invalid, then the parser must
+    /// not be used anymore.
+    void push(bytes_view chunk);
+
+    /// Completes parsing at the end of the binary and returns the module.
+    /// Throws parser_error if the binary is incomplete or validation_error if the module is
+    /// invalid. The parser must not be used afterwards.
+    std::unique_ptr<const Module> finish();
+
+private:
+    enum class State
+    {
+        prefix,
+        section,
+        code_count,
+        code_entry,
+    };
+
+    /// Parses the complete items of the input and returns the position of the first incomplete
+    /// one.
+    const uint8_t* parse_available(const uint8_t* pos, const uint8_t* end);
+
+    const uint32_t* m_cost_table = nullptr;
+
+    std::unique_ptr<Module> m_module;
+
+    /// The bytes of the incomplete item, i.e. the section, the function body or the prefix.
+    bytes m_buffer;
+
+    State m_state = State::prefix;
+
+    SectionId m_last_id = SectionId::custom;
+
+    /// Whether the sections preceding the code section have been validated.
+    bool m_sections_validated = false;
+
+    /// The number of the bytes of the code section not parsed yet.
+    size_t m_code_section_size_left = 0;
+};
 
 inline parser_result<uint8_t> parse_byte(const uint8_t* pos, const uint8_t* end)
 {
@@ -47,8 +130,11 @@ inline parser_result<T> parse_value(const uint8_t* pos, const uint8_t* end)
 /// @param func_idx Index of the function being parsed.
 /// @param locals   Vector of local type and counts for the function being parsed.
 /// @param module   Module that this code is part of.
+/// @param cost_table The instruction cost table to meter the code with, or nullptr to not meter it.
+///                 The metered code is split into basic blocks, each starting with the meter
+///                 instruction charging the total cost of the block instructions.
 parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx func_idx,
-    const std::vector<Locals>& locals, const Module& module);
+    const std::vector<Locals>& locals, const Module& module, const uint32_t* cost_table = nullptr);
 
 parser_result<std::string> parse_string(const uint8_t* pos, const uint8_t* end);
 
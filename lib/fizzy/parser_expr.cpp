@@ -246,10 +246,29 @@ ValType find_local_type(
 
     throw validation_error{"invalid local index"};
 }
+
+/// Checks if the basic block of the metered code ends with the instruction, i.e. the next
+/// instruction is not always executed directly after it. The next instruction is then a branch
+/// target (after loop, else and end), begins the conditionally executed block (after if), or is
+/// skipped when the branch is taken (after br_if).
+inline bool ends_basic_block(Instr instr) noexcept
+{
+    switch (instr)
+    {
+    case Instr::loop:
+    case Instr::if_:
+    case Instr::else_:
+    case Instr::end:
+    case Instr::br_if:
+        return true;
+    default:
+        return false;
+    }
+}
 }  // namespace
 
 parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx func_idx,
-    const std::vector<Locals>& locals, const Module& module)
+    const std::vector<Locals>& locals, const Module& module, const uint32_t* cost_table)
 {
     Code code;
 
@@ -272,6 +291,13 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
     const auto type_table = get_instruction_type_table();
     const auto max_align_table = get_instruction_max_align_table();
 
+    // The metered code state: whether the next instruction begins a basic block,
+    // the offset of the immediate of the meter instruction of the current basic block
+    // and the total cost of its instructions.
+    bool begins_basic_block = true;
+    size_t meter_imm_offset = 0;
+    uint64_t basic_block_cost = 0;
+
     bool continue_parsing = true;
     while (continue_parsing)
     {
@@ -279,6 +305,25 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
         std::tie(opcode, pos) = parse_byte(pos, end);
 
         auto& frame = control_stack.top();
+
+        if (cost_table != nullptr)
+        {
+            if (begins_basic_block)
+            {
+                if (meter_imm_offset != 0)
+                    store(code.instructions.data() + meter_imm_offset, basic_block_cost);
+                code.instructions.push_back(static_cast<uint8_t>(Instr::meter));
+                meter_imm_offset = code.instructions.size();
+                push(code.instructions, uint64_t{0});  // Placeholder for the basic block cost.
+                basic_block_cost = 0;
+            }
+            begins_basic_block = ends_basic_block(static_cast<Instr>(opcode));
+
+            // The unreachable instructions (e.g. following br in the same block) are not executed
+            // when the basic block is, so they are free.
+            if (!frame.unreachable)
+                basic_block_cost += cost_table[opcode];
+        }
         const auto& type = type_table[opcode];
         const auto max_align = max_align_table[opcode];
 
@@ -876,6 +921,8 @@ parser_result<Code> parse_expr(const uint8_t* pos, const uint8_t* end, FuncIdx f
         code.instructions.emplace_back(opcode);
     }
     assert(control_stack.empty());
+    if (meter_imm_offset != 0)
+        store(code.instructions.data() + meter_imm_offset, basic_block_cost);
     return {code, pos};
 }
 }  // namespace fizzy
@@ -0,0 +1,255 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2019-2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "peephole.hpp"
+#include "instructions.hpp"
+#include <cassert>
+#include <limits>
+
+namespace fizzy
+{
+namespace
+{
+template <typename T>
+inline T load(const uint8_t* input) noexcept
+{
+    T ret;
+    __builtin_memcpy(&ret, input, sizeof(ret));
+    return ret;
+}
+
+template <typename T>
+inline void store(uint8_t* dst, T value) noexcept
+{
+    __builtin_memcpy(dst, &value, sizeof(value));
+}
+
+/// Calls the visitor with the offset of each branch target immediate of the instruction,
+/// relative to the instruction position.
+template <typename Visitor>
+void visit_branch_targets(const uint8_t* instr, Visitor visitor)
+{
+    switch (static_cast<Instr>(*instr))
+    {
+    case Instr::if_:
+    case Instr::else_:
+        visitor(size_t{1});
+        break;
+
+    case Instr::br:
+    case Instr::br_if:
+    case Instr::return_:
+        visitor(1 + sizeof(uint32_t));  // After the arity.
+        break;
+
+    case Instr::br_table:
+    {
+        const auto br_table_size = load<uint32_t>(instr + 1);
+        // After the size and the arity, for all labels and the default label.
+        for (size_t i = 0; i <= br_table_size; ++i)
+            visitor(1 + 2 * sizeof(uint32_t) + i * BranchImmediateSize);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+/// Returns the variant of the br, br_if or return instruction specialized for the given
+/// arity and stack_drop.
+Instr specialize_branch(Instr instr, uint32_t arity, uint32_t stack_drop) noexcept
+{
+    const auto is_br_if = instr == Instr::br_if;
+    // Without dropping, the result (if any) is already in place.
+    if (stack_drop == 0)
+        return is_br_if ? Instr::br_if_no_drop : Instr::br_no_drop;
+    if (arity == 0)
+        return is_br_if ? Instr::br_if_void : Instr::br_void;
+    return instr;
+}
+
+/// Returns the instruction with the immediate second operand replacing the given binary
+/// instruction following the const instruction, or Instr::unreachable if it cannot be folded.
+/// The sub instructions are replaced with the add instructions, so the constant must be negated.
+Instr fold_const_operand(Instr const_instr, Instr instr) noexcept
+{
+    if (const_instr == Instr::i32_const)
+    {
+        switch (instr)
+        {
+        case Instr::i32_add:
+        case Instr::i32_sub:
+            return Instr::i32_add_imm;
+        case Instr::i32_and:
+            return Instr::i32_and_imm;
+        case Instr::i32_or:
+            return Instr::i32_or_imm;
+        case Instr::i32_xor:
+            return Instr::i32_xor_imm;
+        case Instr::i32_shl:
+            return Instr::i32_shl_imm;
+        case Instr::i32_shr_s:
+            return Instr::i32_shr_s_imm;
+        case Instr::i32_shr_u:
+            return Instr::i32_shr_u_imm;
+        case Instr::i32_rotl:
+            return Instr::i32_rotl_imm;
+        case Instr::i32_rotr:
+            return Instr::i32_rotr_imm;
+        default:
+            return Instr::unreachable;
+        }
+    }
+
+    assert(const_instr == Instr::i64_const);
+    switch (instr)
+    {
+    case Instr::i64_add:
+    case Instr::i64_sub:
+        return Instr::i64_add_imm;
+    case Instr::i64_and:
+        return Instr::i64_and_imm;
+    case Instr::i64_or:
+        return Instr::i64_or_imm;
+    case Instr::i64_xor:
+        return Instr::i64_xor_imm;
+    case Instr::i64_shl:
+        return Instr::i64_shl_imm;
+    case Instr::i64_shr_s:
+        return Instr::i64_shr_s_imm;
+    case Instr::i64_shr_u:
+        return Instr::i64_shr_u_imm;
+    case Instr::i64_rotl:
+        return Instr::i64_rotl_imm;
+    case Instr::i64_rotr:
+        return Instr::i64_rotr_imm;
+    default:
+        return Instr::unreachable;
+    }
+}
+}  // namespace
+
+void peephole_optimize(Code& code)
+{
+    const auto& input = code.instructions;
+    const auto input_size = input.size();
+    assert(input_size != 0 && input.back() == static_cast<uint8_t>(Instr::end));
+
+    // Branches jump into the code only at these positions, so an instruction there cannot be
+    // folded into the preceding one.
+    std::vector<bool> is_branch_target(input_size + 1);
+    for (size_t pos = 0; pos < input_size; pos += get_instruction_size(&input[pos]))
+    {
+        visit_branch_targets(&input[pos], [&](size_t imm_offset) {
+            is_branch_target[load<uint32_t>(&input[pos + imm_offset])] = true;
+        });
+    }
+
+    std::vector<uint8_t> output;
+    output.reserve(input_size);
+
+    // The output positions of the instructions, indexed by their input positions.
+    // A removed instruction is relocated to the next one.
+    std::vector<uint32_t> relocations(input_size + 1);
+
+    // The output positions of the branch target immediates, to be relocated at the end.
+    std::vector<size_t> branch_target_positions;
+
+    // The output position of the preceding i32.const or i64.const instruction, if the constant
+    // can be folded into the current instruction.
+    constexpr auto NoConst = std::numeric_limits<size_t>::max();
+    auto const_pos = NoConst;
+
+    // The output position of the meter instruction, if it is the last one in the output
+    // and the following basic block can be merged into it.
+    constexpr auto NoMeter = std::numeric_limits<size_t>::max();
+    auto meter_pos = NoMeter;
+
+    for (size_t pos = 0; pos < input_size;)
+    {
+        const auto* const instr_ptr = &input[pos];
+        const auto instr = static_cast<Instr>(*instr_ptr);
+        const auto instr_size = get_instruction_size(instr_ptr);
+
+        relocations[pos] = static_cast<uint32_t>(output.size());
+        if (is_branch_target[pos])
+        {
+            const_pos = NoConst;
+            meter_pos = NoMeter;
+        }
+        pos += instr_size;
+
+        switch (instr)
+        {
+        case Instr::nop:
+        case Instr::block:
+        case Instr::loop:
+            continue;
+
+        case Instr::end:
+            // Only the final end instruction is kept.
+            if (pos == input_size)
+                output.push_back(static_cast<uint8_t>(Instr::end_function));
+            continue;
+
+        case Instr::meter:
+            // The basic block with the removed instructions only (e.g. the end of a loop)
+            // is merged into the following one, unless the branches jump in between.
+            if (meter_pos != NoMeter)
+            {
+                auto* const imm = &output[meter_pos + 1];
+                store(imm, load<uint64_t>(imm) + load<uint64_t>(instr_ptr + 1));
+                continue;
+            }
+            break;
+
+        default:
+            if (const_pos == NoConst)
+                break;
+
+            if (const auto folded =
+                    fold_const_operand(static_cast<Instr>(output[const_pos]), instr);
+                folded != Instr::unreachable)
+            {
+                auto* const imm = &output[const_pos + 1];
+                if (instr == Instr::i32_sub)
+                    store(imm, uint32_t{0} - load<uint32_t>(imm));
+                else if (instr == Instr::i64_sub)
+                    store(imm, uint64_t{0} - load<uint64_t>(imm));
+                output[const_pos] = static_cast<uint8_t>(folded);
+                const_pos = NoConst;
+                continue;
+            }
+            break;
+        }
+
+        const auto output_pos = output.size();
+        output.insert(output.end(), instr_ptr, instr_ptr + instr_size);
+
+        visit_branch_targets(instr_ptr,
+            [&](size_t imm_offset) { branch_target_positions.push_back(output_pos + imm_offset); });
+
+        if (instr == Instr::br || instr == Instr::br_if || instr == Instr::return_)
+        {
+            const auto arity = load<uint32_t>(instr_ptr + 1);
+            const auto stack_drop = load<uint32_t>(instr_ptr + 1 + 2 * sizeof(uint32_t));
+            output[output_pos] = static_cast<uint8_t>(specialize_branch(instr, arity, stack_drop));
+        }
+
+        if (instr == Instr::i32_const || instr == Instr::i64_const)
+            const_pos = output_pos;
+        else
+            const_pos = NoConst;
+
+        meter_pos = (instr == Instr::meter) ? output_pos : NoMeter;
+    }
+    relocations[input_size] = static_cast<uint32_t>(output.size());
+
+    for (const auto target_pos : branch_target_positions)
+        store(&output[target_pos], relocations[load<uint32_t>(&output[target_pos])]);
+
+    code.instructions = std::move(output);
+}
+}  // namespace fizzy
@@ -0,0 +1,27 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2019-2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "types.hpp"
+
+namespace fizzy
+{
+/// Optimizes the validated code produced by parse_expr().
+///
+/// - The nop, block and loop instructions and the end instructions other than the final one
+///   are removed, as their execution has no effect.
+/// - The final end instruction is replaced with end_function, returning without checking
+///   the position in the code.
+/// - The br, br_if and return instructions not dropping any stack items, or not keeping
+///   the result, are replaced with the specialized variants.
+/// - The i32.const and i64.const instructions followed by a binary instruction taking the constant
+///   as the second operand are folded into the immediate value of this instruction.
+/// - The meter instruction directly following another one (with only the removed instructions
+///   in between) is merged into it, if the branches do not jump in between.
+///
+/// The code is compacted and the branch targets are relocated, so this must be done before
+/// the in-place rewrites like fuse_superinstructions().
+void peephole_optimize(Code& code);
+}  // namespace fizzy
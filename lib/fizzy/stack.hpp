@@ -71,7 +71,7 @@ class OperandStack
     Value* m_top;
 
     /// The pointer to the beginning of the locals array.
-    /// This always points to one of the storages.
+    /// This always points to one of the storages or to the external storage space.
     Value* m_locals;
 
     /// The pointer to the bottom of the operand stack.
@@ -118,9 +118,54 @@ public:
         std::fill_n(local_variables, num_local_variables, 0);
     }
 
+    /// Constructs the stack in the storage space owned by the caller.
+    ///
+    /// Sets the top stack operand pointer to below the operand stack bottom.
+    /// @param storage              The storage space for the arguments, local variables and
+    ///                             the operand stack. The function arguments must already be
+    ///                             placed at the beginning of it, so they are not copied.
+    /// @param num_args             The number of the function arguments.
+    /// @param num_local_variables  The number of the function local variables (excluding
+    ///                             arguments). This number of values is zeroed in the storage space
+    ///                             after the arguments.
+    OperandStack(Value* storage, size_t num_args, size_t num_local_variables) noexcept
+    {
+        set_frame(storage, num_args, num_local_variables);
+    }
+
     OperandStack(const OperandStack&) = delete;
     OperandStack& operator=(const OperandStack&) = delete;
 
+    /// The pointers defining the frame of the stack.
+    struct Frame
+    {
+        Value* top;
+        Value* locals;
+        Value* bottom;
+    };
+
+    /// Returns the current frame of the stack, so it can be restored later with set_frame().
+    Frame frame() const noexcept { return {m_top, m_locals, m_bottom}; }
+
+    /// Switches the stack to the given frame.
+    void set_frame(const Frame& frame) noexcept
+    {
+        m_top = frame.top;
+        m_locals = frame.locals;
+        m_bottom = frame.bottom;
+    }
+
+    /// Switches the stack to a new frame in the storage space owned by the caller.
+    /// The parameters have the same meaning as for the constructor using external storage.
+    void set_frame(Value* storage, size_t num_args, size_t num_local_variables) noexcept
+    {
+        m_locals = storage;
+        m_bottom = m_locals + num_args + num_local_variables;
+        m_top = m_bottom - 1;
+
+        std::fill_n(m_locals + num_args, num_local_variables, 0);
+    }
+
     Value& local(size_t index) noexcept
     {
         assert(m_locals + index < m_bottom);
@@ -165,9 +210,128 @@ public:
     }
 
     /// Returns iterator to the bottom of the stack.
+    Value* rbegin() noexcept { return m_bottom; }
     const Value* rbegin() const noexcept { return m_bottom; }
 
     /// Returns end iterator counting from the bottom of the stack.
+    Value* rend() noexcept { return m_top + 1; }
     const Value* rend() const noexcept { return m_top + 1; }
 };
+
+
+/// The view of the OperandStack frame which caches the top item in a member variable.
+///
+/// When the view is a local variable of the interpreter loop, the compiler can keep the top item
+/// in a register across instructions. Then a binary instruction loads only one operand from
+/// memory and stores nothing. The other items are kept in the storage space of the frame and
+/// the top item is spilled there when a new item is pushed, or when the storage space
+/// is accessed directly by rend() or frame().
+///
+/// The top item of an empty stack is spilled to the slot directly below the operand stack bottom
+/// (and the item loaded from there is ignored), so the frame must have this slot reserved,
+/// e.g. as an additional local variable not accessed by the code.
+class CachedOperandStack
+{
+    /// The top item. Valid only if the stack is not empty.
+    Value m_top_item;
+
+    /// The pointer to the slot of the top item in the storage space,
+    /// or below the stack bottom if stack is empty. The value there may be stale.
+    Value* m_top;
+
+    /// The pointer to the beginning of the locals array.
+    Value* m_locals;
+
+    /// The pointer to the bottom of the operand stack.
+    Value* m_bottom;
+
+public:
+    using Frame = OperandStack::Frame;
+
+    /// Constructs the view of the current frame of the stack.
+    explicit CachedOperandStack(const OperandStack& stack) noexcept { set_frame(stack.frame()); }
+
+    CachedOperandStack(const CachedOperandStack&) = delete;
+    CachedOperandStack& operator=(const CachedOperandStack&) = delete;
+
+    /// Returns the current frame of the stack, so it can be restored later with set_frame().
+    /// The top item is spilled, so the whole stack is in the storage space.
+    Frame frame() noexcept
+    {
+        *m_top = m_top_item;
+        return {m_top, m_locals, m_bottom};
+    }
+
+    /// Switches the view to the given frame and loads its top item.
+    void set_frame(const Frame& frame) noexcept
+    {
+        m_top = frame.top;
+        m_locals = frame.locals;
+        m_bottom = frame.bottom;
+        m_top_item = *m_top;
+    }
+
+    /// Switches the view to a new frame in the storage space owned by the caller.
+    /// The parameters have the same meaning as for OperandStack::set_frame().
+    void set_frame(Value* storage, size_t num_args, size_t num_local_variables) noexcept
+    {
+        m_locals = storage;
+        m_bottom = m_locals + num_args + num_local_variables;
+        m_top = m_bottom - 1;
+
+        std::fill_n(m_locals + num_args, num_local_variables, 0);
+    }
+
+    Value& local(size_t index) noexcept
+    {
+        assert(m_locals + index < m_bottom);
+        return m_locals[index];
+    }
+
+    /// The current number of items on the stack (aka stack height).
+    size_t size() const noexcept { return static_cast<size_t>(m_top + 1 - m_bottom); }
+
+    /// Returns the reference to the top item.
+    /// Requires non-empty stack.
+    Value& top() noexcept
+    {
+        assert(size() != 0);
+        return m_top_item;
+    }
+
+    /// Pushes an item on the stack.
+    /// The stack max height limit is not checked.
+    void push(Value item) noexcept
+    {
+        *m_top++ = m_top_item;
+        m_top_item = item;
+    }
+
+    /// Returns an item popped from the top of the stack.
+    /// Requires non-empty stack.
+    Value pop() noexcept
+    {
+        assert(size() != 0);
+        const auto item = m_top_item;
+        m_top_item = *--m_top;
+        return item;
+    }
+
+    void drop(size_t num) noexcept
+    {
+        assert(num <= size());
+        if (num == 0)
+            return;  // The top item may not be spilled.
+        m_top -= num;
+        m_top_item = *m_top;
+    }
+
+    /// Returns end iterator counting from the bottom of the stack.
+    /// The top item is spilled, so the whole stack is in the storage space.
+    Value* rend() noexcept
+    {
+        *m_top = m_top_item;
+        return m_top + 1;
+    }
+};
 }  // namespace fizzy
@@ -0,0 +1,113 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2019-2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "superinstructions.hpp"
+#include "instructions.hpp"
+#include <cassert>
+
+namespace fizzy
+{
+namespace
+{
+/// Returns the superinstruction fusing the given i32 comparison with the following br_if,
+/// or Instr::unreachable if the instruction is not an i32 comparison.
+Instr fused_comparison_br_if(Instr comparison) noexcept
+{
+    switch (comparison)
+    {
+    case Instr::i32_eqz:
+        return Instr::i32_eqz_br_if;
+    case Instr::i32_eq:
+        return Instr::i32_eq_br_if;
+    case Instr::i32_ne:
+        return Instr::i32_ne_br_if;
+    case Instr::i32_lt_s:
+        return Instr::i32_lt_s_br_if;
+    case Instr::i32_lt_u:
+        return Instr::i32_lt_u_br_if;
+    case Instr::i32_gt_s:
+        return Instr::i32_gt_s_br_if;
+    case Instr::i32_gt_u:
+        return Instr::i32_gt_u_br_if;
+    case Instr::i32_le_s:
+        return Instr::i32_le_s_br_if;
+    case Instr::i32_le_u:
+        return Instr::i32_le_u_br_if;
+    case Instr::i32_ge_s:
+        return Instr::i32_ge_s_br_if;
+    case Instr::i32_ge_u:
+        return Instr::i32_ge_u_br_if;
+    default:
+        return Instr::unreachable;
+    }
+}
+
+/// Checks if the instruction is br_if, also specialized by peephole_optimize().
+inline bool is_br_if(Instr instr) noexcept
+{
+    return instr == Instr::br_if || instr == Instr::br_if_no_drop || instr == Instr::br_if_void;
+}
+}  // namespace
+
+void fuse_superinstructions(Code& code) noexcept
+{
+    auto* const begin = code.instructions.data();
+    auto* const end = begin + code.instructions.size();
+
+    // Returns the opcode of the instruction at the given position or Instr::end if the position
+    // is outside of the code (the final end instruction is never a part of a sequence).
+    const auto opcode_at = [end](const uint8_t* pos) noexcept {
+        return pos < end ? static_cast<Instr>(*pos) : Instr::end;
+    };
+
+    auto* pc = begin;
+    while (pc < end)
+    {
+        const auto instr = static_cast<Instr>(*pc);
+        auto* const next = pc + get_instruction_size(pc);
+        const auto next_instr = opcode_at(next);
+
+        // The sequence is fused by replacing the first opcode, then all instructions of
+        // the sequence are skipped, so sequences do not overlap.
+        auto* sequence_end = next;
+        switch (instr)
+        {
+        case Instr::local_get:
+            if (next_instr == Instr::local_get &&
+                opcode_at(next + get_instruction_size(next)) == Instr::i32_add)
+            {
+                *pc = static_cast<uint8_t>(Instr::local_get_local_get_i32_add);
+                sequence_end = next + get_instruction_size(next) + 1;
+            }
+            else if (next_instr == Instr::i32_load)
+            {
+                *pc = static_cast<uint8_t>(Instr::local_get_i32_load);
+                sequence_end = next + get_instruction_size(next);
+            }
+            break;
+
+        case Instr::local_tee:
+            if (next_instr == Instr::local_get)
+            {
+                *pc = static_cast<uint8_t>(Instr::local_tee_local_get);
+                sequence_end = next + get_instruction_size(next);
+            }
+            break;
+
+        default:
+            if (const auto fused = fused_comparison_br_if(instr);
+                fused != Instr::unreachable && is_br_if(next_instr))
+            {
+                *pc = static_cast<uint8_t>(fused);
+                sequence_end = next + get_instruction_size(next);
+            }
+            break;
+        }
+
+        assert(sequence_end <= end);
+        pc = sequence_end;
+    }
+    assert(pc == end);
+}
+}  // namespace fizzy
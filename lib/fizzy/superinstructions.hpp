@@ -0,0 +1,18 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2019-2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#pragma once
+
+#include "types.hpp"
+
+namespace fizzy
+{
+/// Replaces common sequences of instructions in the validated code with superinstructions.
+///
+/// The rewrite is done in place: only the opcode of the first instruction of a sequence is
+/// replaced, the remaining bytes of the sequence are kept intact and are skipped by
+/// the superinstruction handler in execute(). Therefore the size of the code and the branch
+/// targets are not changed.
+void fuse_superinstructions(Code& code) noexcept;
+}  // namespace fizzy
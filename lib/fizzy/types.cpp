@@ -0,0 +1,31 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "types.hpp"
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace fizzy
+{
+FuncTypeId get_canonical_func_type_id(const FuncType& type)
+{
+    // The registry key is the encoding of input types followed by output types. These are
+    // separated by the 0 byte, which is not a valid value type.
+    std::string key;
+    key.reserve(type.inputs.size() + 1 + type.outputs.size());
+    for (const auto input : type.inputs)
+        key.push_back(static_cast<char>(input));
+    key.push_back(0);
+    for (const auto output : type.outputs)
+        key.push_back(static_cast<char>(output));
+
+    static std::mutex registry_mutex;
+    static std::unordered_map<std::string, FuncTypeId> registry;
+
+    const std::lock_guard lock{registry_mutex};
+    const auto next_id = static_cast<FuncTypeId>(registry.size());
+    return registry.try_emplace(std::move(key), next_id).first->second;
+}
+}  // namespace fizzy
@@ -43,6 +43,15 @@ inline bool operator!=(const FuncType& lhs, const FuncType& rhs) noexcept
     return !(lhs == rhs);
 }
 
+/// The canonical identifier of a function type.
+/// Equal function types have equal identifiers in the whole process, also when they are defined
+/// in different modules. This makes the function signature check a single integer comparison.
+using FuncTypeId = uint32_t;
+
+/// Returns the canonical identifier of the function type, registering the type if it is seen
+/// for the first time. Thread-safe.
+FuncTypeId get_canonical_func_type_id(const FuncType& type);
+
 // https://webassembly.github.io/spec/core/binary/types.html#binary-limits
 struct Limits
 {
@@ -269,6 +278,56 @@ enum class Instr : uint8_t
     f32_reinterpret_i32 = 0xbe,
     f64_reinterpret_i64 = 0xbf,
 
+    // Internal superinstructions, each replacing a common sequence of instructions.
+    // These are not valid in the wasm binary and are introduced only by fuse_superinstructions().
+    local_get_local_get_i32_add = 0xc0,
+    local_get_i32_load = 0xc1,
+    local_tee_local_get = 0xc2,
+    i32_eqz_br_if = 0xc3,
+    i32_eq_br_if = 0xc4,
+    i32_ne_br_if = 0xc5,
+    i32_lt_s_br_if = 0xc6,
+    i32_lt_u_br_if = 0xc7,
+    i32_gt_s_br_if = 0xc8,
+    i32_gt_u_br_if = 0xc9,
+    i32_le_s_br_if = 0xca,
+    i32_le_u_br_if = 0xcb,
+    i32_ge_s_br_if = 0xcc,
+    i32_ge_u_br_if = 0xcd,
+
+    // Internal instructions introduced only by peephole_optimize().
+    // The final end of the function, returning from it unconditionally.
+    end_function = 0xd0,
+    // The br/br_if/return with stack_drop 0, only jumping to the target.
+    br_no_drop = 0xd1,
+    br_if_no_drop = 0xd2,
+    // The br/br_if/return with arity 0, not keeping the result.
+    br_void = 0xd3,
+    br_if_void = 0xd4,
+    // The binary instructions with the second operand folded from the preceding const instruction
+    // into the immediate value.
+    i32_add_imm = 0xe0,
+    i32_and_imm = 0xe1,
+    i32_or_imm = 0xe2,
+    i32_xor_imm = 0xe3,
+    i32_shl_imm = 0xe4,
+    i32_shr_s_imm = 0xe5,
+    i32_shr_u_imm = 0xe6,
+    i32_rotl_imm = 0xe7,
+    i32_rotr_imm = 0xe8,
+    i64_add_imm = 0xe9,
+    i64_and_imm = 0xea,
+    i64_or_imm = 0xeb,
+    i64_xor_imm = 0xec,
+    i64_shl_imm = 0xed,
+    i64_shr_s_imm = 0xee,
+    i64_shr_u_imm = 0xef,
+    i64_rotl_imm = 0xf0,
+    i64_rotr_imm = 0xf1,
+
+    // Internal instruction introduced only by parse_expr() in the metered code.
+    // Charges the cost of the basic block starting with it.
+    meter = 0xf8,
 };
 
 // https://webassembly.github.io/spec/core/binary/modules.html#table-section
@@ -378,7 +437,9 @@ struct code_view : public bytes_view
 struct Data
 {
     ConstantExpression offset;
-    bytes init;
+    // The segment bytes, referring to the copy owned by the module (Module::data_storage)
+    // or to the wasm binary.
+    bytes_view init;
 };
 
 enum class SectionId : uint8_t
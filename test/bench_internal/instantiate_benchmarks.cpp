@@ -0,0 +1,86 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "instantiate.hpp"
+#include "parser.hpp"
+#include <benchmark/benchmark.h>
+#include <test/utils/hex.hpp>
+#include <memory>
+#include <vector>
+
+namespace
+{
+/* wat2wasm
+(memory 1)
+(data (i32.const 0) "\2a")
+(global (mut i32) (i32.const 1))
+(func (param i32) (result i32)
+  (loop
+    local.get 0
+    i32.const 1
+    i32.sub
+    local.tee 0
+    br_if 0
+  )
+  local.get 0
+)
+(func (result i32)
+  (i32.store (i32.const 0) (i32.add (i32.load (i32.const 0)) (i32.const 1)))
+  (i32.load (i32.const 0))
+)
+*/
+const auto wasm = fizzy::test::from_hex(
+    "0061736d01000000010a0260017f017f6000017f030302000105030100010606017f0141010b0a2702100003"
+    "40200041016b22000d000b20000b14004100410028020041016a36020041002802000b0b07010041000b012a");
+}  // namespace
+
+static void instantiate_parsed_module(benchmark::State& state)
+{
+    const auto num_instances = static_cast<size_t>(state.range(0));
+    std::vector<std::unique_ptr<fizzy::Instance>> instances(num_instances);
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        for (auto& instance : instances)
+            instance = fizzy::instantiate(fizzy::parse(wasm));
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(num_instances) * state.iterations());
+}
+BENCHMARK(instantiate_parsed_module)->RangeMultiplier(4)->Range(1, 256);
+
+static void instantiate_shared_module(benchmark::State& state)
+{
+    const auto num_instances = static_cast<size_t>(state.range(0));
+    std::vector<std::unique_ptr<fizzy::Instance>> instances(num_instances);
+    const std::shared_ptr<const fizzy::Module> module = fizzy::parse(wasm);
+
+    for ([[maybe_unused]] auto _ : state)
+    {
+        for (auto& instance : instances)
+            instance = fizzy::instantiate(module);
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(num_instances) * state.iterations());
+}
+BENCHMARK(instantiate_shared_module)->RangeMultiplier(4)->Range(1, 256);
+
+static void instantiate_data_segment(benchmark::State& state)
+{
+    // The segments smaller than 4096 bytes are copied, the bigger ones are mapped from
+    // the memory image.
+    const auto init = fizzy::bytes(static_cast<size_t>(state.range(0)), 0x2a);
+    const auto module = std::make_shared<fizzy::Module>();
+    module->memorysec.emplace_back(fizzy::Memory{{16, 16}});
+    module->datasec.emplace_back(
+        fizzy::Data{{fizzy::ConstantExpression::Kind::Constant, {0}}, init});
+
+    for ([[maybe_unused]] auto _ : state)
+        benchmark::DoNotOptimize(fizzy::instantiate(module));
+}
+BENCHMARK(instantiate_data_segment)
+    ->Arg(1024)
+    ->Arg(4096)
+    ->Arg(fizzy::PageSize)
+    ->Arg(16 * fizzy::PageSize);
@@ -7,6 +7,7 @@
 #include <benchmark/benchmark.h>
 #include <test/utils/leb128_encode.hpp>
 #include <algorithm>
+#include <limits>
 #include <random>
 #include <vector>
 
@@ -14,6 +15,8 @@ namespace
 {
 std::mt19937_64 g_gen{std::random_device{}()};
 
+constexpr size_t num_leb128_samples = 1024;
+
 template <typename T>
 std::vector<T> generate_samples(size_t count)
 {
@@ -25,6 +28,18 @@ std::vector<T> generate_samples(size_t count)
     return samples;
 }
 
+/// Generates the values of the random bit width, so of the random length of LEB128 encoding.
+template <typename T>
+std::vector<T> generate_mixed_width_samples(size_t count)
+{
+    std::uniform_int_distribution<int> width_dist{0, std::numeric_limits<T>::digits - 1};
+
+    auto samples = generate_samples<T>(count);
+    for (auto& sample : samples)
+        sample >>= width_dist(g_gen);
+    return samples;
+}
+
 fizzy::bytes generate_ascii_vec(size_t size)
 {
     std::uniform_int_distribution<uint8_t> dist{0, 0x7f};
@@ -51,16 +66,15 @@ fizzy::bytes generate_ascii_vec(size_t size)
 {
     return fizzy::leb128u_decode<uint64_t>(input, end);
 }
-}  // namespace
 
-template <decltype(fizzy::leb128u_decode<uint64_t>) Fn>
-static void leb128u_decode_u64(benchmark::State& state)
+/// Decodes the LEB128 encodings of the samples one after another.
+template <typename T, decltype(fizzy::leb128u_decode<T>) Fn>
+void benchmark_leb128u_decode(benchmark::State& state, const std::vector<T>& samples)
 {
-    constexpr size_t size = 1024;
-    const auto samples = generate_samples<uint64_t>(size);
+    constexpr size_t size = num_leb128_samples;
 
     fizzy::bytes input;
-    input.reserve(size * ((sizeof(uint64_t) * 8) / 7 + 1));
+    input.reserve(size * static_cast<size_t>(fizzy::leb128_max_size<T>));
     for (const auto sample : samples)
         input += fizzy::test::leb128u_encode(sample);
 
@@ -80,10 +94,30 @@ static void leb128u_decode_u64(benchmark::State& state)
             state.SkipWithError("Not all input processed");
     }
 }
+}  // namespace
+
+template <decltype(fizzy::leb128u_decode<uint64_t>) Fn>
+static void leb128u_decode_u64(benchmark::State& state)
+{
+    const auto samples = generate_samples<uint64_t>(num_leb128_samples);
+    benchmark_leb128u_decode<uint64_t, Fn>(state, samples);
+}
 BENCHMARK_TEMPLATE(leb128u_decode_u64, nop);
 BENCHMARK_TEMPLATE(leb128u_decode_u64, fizzy::leb128u_decode<uint64_t>);
 BENCHMARK_TEMPLATE(leb128u_decode_u64, leb128u_decode_u64_noinline);
 BENCHMARK_TEMPLATE(leb128u_decode_u64, decodeULEB128);
+// The decoding checking for the end of the input at every byte, used near the end of it.
+BENCHMARK_TEMPLATE(leb128u_decode_u64, fizzy::detail::leb128u_decode<uint64_t, true>);
+
+template <decltype(fizzy::leb128u_decode<uint64_t>) Fn>
+static void leb128u_decode_u64_mixed(benchmark::State& state)
+{
+    const auto samples = generate_mixed_width_samples<uint64_t>(num_leb128_samples);
+    benchmark_leb128u_decode<uint64_t, Fn>(state, samples);
+}
+BENCHMARK_TEMPLATE(leb128u_decode_u64_mixed, fizzy::leb128u_decode<uint64_t>);
+BENCHMARK_TEMPLATE(leb128u_decode_u64_mixed, decodeULEB128);
+BENCHMARK_TEMPLATE(leb128u_decode_u64_mixed, fizzy::detail::leb128u_decode<uint64_t, true>);
 
 static void parse_string(benchmark::State& state)
 {
@@ -49,7 +49,7 @@ const auto spectest_bin = fizzy::test::from_hex(
     "0003097072696e745f6633320004097072696e745f66363400050a676c6f62616c5f69333203000a676c6f62616c5f"
     "66333203010a676c6f62616c5f6636340302057461626c650100066d656d6f727902000a130602000b02000b02000b"
     "02000b02000b02000b");
-const auto spectest_module = fizzy::parse(spectest_bin);
+const std::shared_ptr<const fizzy::Module> spectest_module = fizzy::parse(spectest_bin);
 const std::string spectest_name = "spectest";
 
 fizzy::bytes load_wasm_file(const fs::path& json_file_path, std::string_view filename)
@@ -89,8 +89,7 @@ public:
     explicit test_runner(const test_settings& ts)
       : m_settings{ts}, m_registered_names{{spectest_name, spectest_name}}
     {
-        m_instances[spectest_name] =
-            fizzy::instantiate(std::make_unique<fizzy::Module>(*spectest_module));
+        m_instances[spectest_name] = fizzy::instantiate(spectest_module);
     }
 
     test_results run_from_file(const fs::path& path)
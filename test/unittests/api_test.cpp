@@ -538,7 +538,7 @@ TEST(api, find_exported_memory)
         "0061736d010000000104016000000211010474657374066d656d6f72790201010a030201000404017000000606"
         "017f0041000b071604036d656d02000166000002673103000374616201000a05010300010b");
 
-    bytes memory(PageSize, 0);
+    LinearMemory memory(PageSize);
     auto instance_reexported_memory =
         instantiate(parse(wasm_reexported_memory), {}, {}, {ExternalMemory{&memory, {1, 4}}});
 
@@ -579,7 +579,7 @@ TEST(api, find_exported_memory_reimport)
         from_hex("0061736d010000000211010474657374066d656d6f72790201010a070701036d656d0200");
 
     // importing the memory with limits narrower than defined in the module
-    bytes memory(2 * PageSize, 0);
+    LinearMemory memory(2 * PageSize);
     auto instance = instantiate(parse(wasm), {}, {}, {ExternalMemory{&memory, {2, 5}}});
 
     auto opt_memory = find_exported_memory(*instance, "mem");
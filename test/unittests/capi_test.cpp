@@ -6,6 +6,7 @@
 #include <gtest/gtest.h>
 #include <test/utils/asserts.hpp>
 #include <test/utils/hex.hpp>
+#include <cstdio>
 
 using namespace fizzy::test;
 
@@ -116,6 +117,7 @@ TEST(capi, find_exported_table)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     FizzyExternalTable table;
@@ -146,6 +148,7 @@ TEST(capi, find_exported_table_no_max)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     FizzyExternalTable table;
@@ -175,6 +178,7 @@ TEST(capi, find_exported_memory)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     FizzyExternalMemory memory;
@@ -205,6 +209,7 @@ TEST(capi, find_exported_memory_no_max)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     FizzyExternalMemory memory;
@@ -234,6 +239,7 @@ TEST(capi, find_exported_global)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     FizzyExternalGlobal global;
@@ -257,6 +263,7 @@ TEST(capi, instantiate)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     EXPECT_NE(instance, nullptr);
 
     fizzy_free_instance(instance);
@@ -272,17 +279,19 @@ TEST(capi, instantiate_imported_function)
     ASSERT_NE(module, nullptr);
 
     EXPECT_EQ(fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0), nullptr);
+    fizzy_free_module(module);
 
     module = fizzy_parse(wasm.data(), wasm.size());
     ASSERT_NE(module, nullptr);
 
     FizzyExternalFunction host_funcs[] = {{{FizzyValueTypeI32, nullptr, 0},
         [](void*, FizzyInstance*, const FizzyValue*, int) {
-            return FizzyExecutionResult{false, true, {42}};
+            return FizzyExecutionResult{false, true, {42}, false};
         },
         nullptr}};
 
     auto instance = fizzy_instantiate(module, host_funcs, 1, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     EXPECT_NE(instance, nullptr);
 
     fizzy_free_instance(instance);
@@ -318,6 +327,7 @@ TEST(capi, instantiate_imported_globals)
         {&g4, {FizzyValueTypeF64, true}}};
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, globals, 4);
+    fizzy_free_module(module);
     EXPECT_NE(instance, nullptr);
 
     EXPECT_THAT(fizzy_execute(instance, 0, nullptr, 0), CResult(42));
@@ -331,11 +341,13 @@ TEST(capi, instantiate_imported_globals)
     module = fizzy_parse(wasm.data(), wasm.size());
     ASSERT_NE(module, nullptr);
     EXPECT_EQ(fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0), nullptr);
+    fizzy_free_module(module);
 
     // Not enough globals provided.
     module = fizzy_parse(wasm.data(), wasm.size());
     ASSERT_NE(module, nullptr);
     EXPECT_EQ(fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, globals, 3), nullptr);
+    fizzy_free_module(module);
 
     // Incorrect order or globals.
     module = fizzy_parse(wasm.data(), wasm.size());
@@ -347,6 +359,7 @@ TEST(capi, instantiate_imported_globals)
 
     EXPECT_EQ(fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, globals_incorrect_order, 4),
         nullptr);
+    fizzy_free_module(module);
 
     // Global type mismatch.
     module = fizzy_parse(wasm.data(), wasm.size());
@@ -358,6 +371,44 @@ TEST(capi, instantiate_imported_globals)
 
     EXPECT_EQ(
         fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, globals_type_mismatch, 4), nullptr);
+    fizzy_free_module(module);
+}
+
+TEST(capi, instantiate_shared_module)
+{
+    /* wat2wasm
+      (memory 1)
+      (func (result i32)
+        (i32.store (i32.const 0) (i32.add (i32.load (i32.const 0)) (i32.const 1)))
+        (i32.load (i32.const 0))
+      )
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000105016000017f0302010005030100010a160114004100410028020041016a3602004100"
+        "2802000b");
+    auto module = fizzy_parse(wasm.data(), wasm.size());
+    ASSERT_NE(module, nullptr);
+
+    auto instance1 = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    ASSERT_NE(instance1, nullptr);
+    auto instance2 = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    ASSERT_NE(instance2, nullptr);
+
+    // The module is kept alive by the instances.
+    fizzy_free_module(module);
+
+    // The instance module can be instantiated too.
+    auto instance3 = fizzy_instantiate(
+        fizzy_get_instance_module(instance1), nullptr, 0, nullptr, nullptr, nullptr, 0);
+    ASSERT_NE(instance3, nullptr);
+    fizzy_free_instance(instance1);
+
+    EXPECT_THAT(fizzy_execute(instance2, 0, nullptr, 0), CResult(1));
+    EXPECT_THAT(fizzy_execute(instance2, 0, nullptr, 0), CResult(2));
+    EXPECT_THAT(fizzy_execute(instance3, 0, nullptr, 0), CResult(1));
+
+    fizzy_free_instance(instance3);
+    fizzy_free_instance(instance2);
 }
 
 TEST(capi, resolve_instantiate_no_imports)
@@ -370,6 +421,7 @@ TEST(capi, resolve_instantiate_no_imports)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_resolve_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     EXPECT_NE(instance, nullptr);
 
     fizzy_free_instance(instance);
@@ -383,6 +435,7 @@ TEST(capi, resolve_instantiate_no_imports)
             nullptr}}};
 
     instance = fizzy_resolve_instantiate(module, host_funcs, 1, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     EXPECT_NE(instance, nullptr);
 
     fizzy_free_instance(instance);
@@ -403,12 +456,13 @@ TEST(capi, resolve_instantiate)
     ASSERT_NE(module, nullptr);
 
     EXPECT_EQ(fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0), nullptr);
+    fizzy_free_module(module);
 
     module = fizzy_parse(wasm.data(), wasm.size());
     ASSERT_NE(module, nullptr);
 
     FizzyExternalFn host_fn = [](void* context, FizzyInstance*, const FizzyValue*, int) {
-        return FizzyExecutionResult{true, false, *static_cast<FizzyValue*>(context)};
+        return FizzyExecutionResult{true, false, *static_cast<FizzyValue*>(context), false};
     };
 
     const FizzyValueType input_type = FizzyValueTypeI32;
@@ -426,6 +480,7 @@ TEST(capi, resolve_instantiate)
         {"mod2", "foo1", mod2foo1}, {"mod2", "foo2", mod2foo2}};
 
     auto instance = fizzy_resolve_instantiate(module, host_funcs, 4, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     EXPECT_NE(instance, nullptr);
     fizzy_free_instance(instance);
 
@@ -436,6 +491,7 @@ TEST(capi, resolve_instantiate)
         {"mod2", "foo1", mod2foo1}, {"mod2", "foo2", mod2foo2}, {"mod1", "foo1", mod1foo1}};
     instance =
         fizzy_resolve_instantiate(module, host_funcs_reordered, 4, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     EXPECT_NE(instance, nullptr);
     fizzy_free_instance(instance);
 
@@ -446,6 +502,7 @@ TEST(capi, resolve_instantiate)
         {"mod1", "foo2", mod1foo2}, {"mod2", "foo1", mod2foo1}, {"mod2", "foo2", mod2foo2},
         {"mod3", "foo1", mod1foo1}};
     instance = fizzy_resolve_instantiate(module, host_funcs_extra, 4, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     EXPECT_NE(instance, nullptr);
     fizzy_free_instance(instance);
 
@@ -454,6 +511,7 @@ TEST(capi, resolve_instantiate)
     ASSERT_NE(module, nullptr);
     EXPECT_EQ(
         fizzy_resolve_instantiate(module, host_funcs, 3, nullptr, nullptr, nullptr, 0), nullptr);
+    fizzy_free_module(module);
 }
 
 TEST(capi, free_instance_null)
@@ -471,6 +529,7 @@ TEST(capi, get_instance_module)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     auto instance_module = fizzy_get_instance_module(instance);
@@ -491,6 +550,7 @@ TEST(capi, memory_access_no_memory)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     EXPECT_EQ(fizzy_get_instance_memory_data(instance), nullptr);
@@ -516,6 +576,7 @@ TEST(capi, memory_access)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     uint8_t* memory = fizzy_get_instance_memory_data(instance);
@@ -533,6 +594,83 @@ TEST(capi, memory_access)
     fizzy_free_instance(instance);
 }
 
+TEST(capi, reset_instance)
+{
+    /* wat2wasm
+      (memory 1)
+      (func (result i32)
+        (i32.store (i32.const 0) (i32.add (i32.load (i32.const 0)) (i32.const 1)))
+        (i32.load (i32.const 0))
+      )
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000105016000017f0302010005030100010a160114004100410028020041016a3602004100"
+        "2802000b");
+    auto module = fizzy_parse(wasm.data(), wasm.size());
+    ASSERT_NE(module, nullptr);
+    auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
+    ASSERT_NE(instance, nullptr);
+
+    ASSERT_TRUE(fizzy_snapshot_instance(instance));
+    EXPECT_THAT(fizzy_execute(instance, 0, nullptr, 0), CResult(1));
+    EXPECT_THAT(fizzy_execute(instance, 0, nullptr, 0), CResult(2));
+
+    EXPECT_TRUE(fizzy_reset_instance(instance));
+    EXPECT_THAT(fizzy_execute(instance, 0, nullptr, 0), CResult(1));
+
+    EXPECT_TRUE(fizzy_reset_instance(instance));
+    fizzy_get_instance_memory_data(instance)[0] = 10;
+    fizzy_mark_instance_memory_dirty(instance, 0, 1);
+    EXPECT_THAT(fizzy_execute(instance, 0, nullptr, 0), CResult(11));
+    EXPECT_TRUE(fizzy_reset_instance(instance));
+    EXPECT_THAT(fizzy_execute(instance, 0, nullptr, 0), CResult(1));
+
+    fizzy_free_instance(instance);
+}
+
+TEST(capi, instance_image)
+{
+    /* wat2wasm
+      (memory 1)
+      (func (result i32)
+        (i32.store (i32.const 0) (i32.add (i32.load (i32.const 0)) (i32.const 1)))
+        (i32.load (i32.const 0))
+      )
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000105016000017f0302010005030100010a160114004100410028020041016a3602004100"
+        "2802000b");
+    auto module = fizzy_parse(wasm.data(), wasm.size());
+    ASSERT_NE(module, nullptr);
+    auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    ASSERT_NE(instance, nullptr);
+
+    EXPECT_THAT(fizzy_execute(instance, 0, nullptr, 0), CResult(1));
+    const auto path = ::testing::TempDir() + "capi_instance_image.img";
+    ASSERT_TRUE(fizzy_save_instance_image(instance, wasm.data(), wasm.size(), path.c_str()));
+
+    auto image_instance = fizzy_instantiate_from_image(
+        module, wasm.data(), wasm.size(), path.c_str(), nullptr, 0, nullptr, nullptr, nullptr, 0);
+    ASSERT_NE(image_instance, nullptr);
+    EXPECT_THAT(fizzy_execute(image_instance, 0, nullptr, 0), CResult(2));
+    EXPECT_THAT(fizzy_execute(image_instance, 0, nullptr, 0), CResult(3));
+    EXPECT_THAT(fizzy_execute(instance, 0, nullptr, 0), CResult(2));
+
+    // The image is tied to the wasm binary.
+    EXPECT_EQ(fizzy_instantiate_from_image(module, wasm.data(), wasm.size() - 1, path.c_str(),
+                  nullptr, 0, nullptr, nullptr, nullptr, 0),
+        nullptr);
+    EXPECT_EQ(fizzy_instantiate_from_image(module, wasm.data(), wasm.size(), "/nonexistent/image",
+                  nullptr, 0, nullptr, nullptr, nullptr, 0),
+        nullptr);
+
+    fizzy_free_instance(image_instance);
+    fizzy_free_instance(instance);
+    fizzy_free_module(module);
+    std::remove(path.c_str());
+}
+
 TEST(capi, imported_memory_access)
 {
     /* wat2wasm
@@ -543,6 +681,7 @@ TEST(capi, imported_memory_access)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     EXPECT_EQ(instance, nullptr);
 }
 
@@ -564,6 +703,7 @@ TEST(capi, execute)
     ASSERT_NE(module, nullptr);
 
     auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     EXPECT_THAT(fizzy_execute(instance, 0, nullptr, 0), CResult());
@@ -575,6 +715,126 @@ TEST(capi, execute)
     fizzy_free_instance(instance);
 }
 
+TEST(capi, execute_batch)
+{
+    /* wat2wasm
+      (func (param i32 i32) (result i32)
+        local.get 0
+        local.get 1
+        i32.div_u
+      )
+    */
+    const auto wasm =
+        from_hex("0061736d0100000001070160027f7f017f030201000a09010700200020016e0b");
+
+    auto module = fizzy_parse(wasm.data(), wasm.size());
+    ASSERT_NE(module, nullptr);
+    auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
+    ASSERT_NE(instance, nullptr);
+
+    const FizzyValue args_batch[] = {{7}, {2}, {9}, {0}, {12}, {5}};
+    FizzyExecutionResult results[3];
+    fizzy_execute_batch(instance, 0, args_batch, 3, results);
+    EXPECT_THAT(results[0], CResult(3));
+    EXPECT_THAT(results[1], CTraps());
+    EXPECT_THAT(results[2], CResult(2));
+
+    fizzy_execute_batch(instance, 0, nullptr, 0, nullptr);
+
+    fizzy_free_instance(instance);
+}
+
+TEST(capi, execute_metered)
+{
+    /* wat2wasm
+      (func (param i32) (result i32)
+        (loop
+          local.get 0
+          i32.const 1
+          i32.sub
+          local.tee 0
+          br_if 0
+        )
+        local.get 0
+      )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f030201000a120110000340200041016b22000d000b20000b");
+
+    auto module = fizzy_parse_metered(wasm.data(), wasm.size(), nullptr);
+    ASSERT_NE(module, nullptr);
+    auto instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
+    ASSERT_NE(instance, nullptr);
+
+    FizzyValue args[] = {{3}};
+    int64_t gas_left = 100;
+    EXPECT_THAT(fizzy_execute_metered(instance, 0, args, &gas_left, 0), CResult(0));
+    EXPECT_EQ(gas_left, 100 - 19);
+
+    gas_left = 18;
+    EXPECT_THAT(fizzy_execute_metered(instance, 0, args, &gas_left, 0), CTraps());
+    EXPECT_EQ(gas_left, -1);
+
+    EXPECT_THAT(fizzy_execute(instance, 0, args, 0), CResult(0));
+    fizzy_free_instance(instance);
+
+    uint32_t cost_table[FizzyInstructionCostTableSize] = {};
+    cost_table[0x6b] = 10;  // i32.sub
+    module = fizzy_parse_metered(wasm.data(), wasm.size(), cost_table);
+    ASSERT_NE(module, nullptr);
+    instance = fizzy_instantiate(module, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
+    ASSERT_NE(instance, nullptr);
+
+    gas_left = 100;
+    EXPECT_THAT(fizzy_execute_metered(instance, 0, args, &gas_left, 0), CResult(0));
+    EXPECT_EQ(gas_left, 100 - 30);
+    fizzy_free_instance(instance);
+
+    EXPECT_EQ(fizzy_parse_metered(wasm.data(), wasm.size() - 1, nullptr), nullptr);
+}
+
+TEST(capi, interrupt)
+{
+    /* wat2wasm
+      (func (import "m" "f"))
+      (func (loop (call 0) (br 0)))
+    */
+    const auto wasm = from_hex(
+        "0061736d01000000010401600000020701016d01660000030201000a0b010900034010000c000b0b");
+
+    auto module = fizzy_parse(wasm.data(), wasm.size());
+    ASSERT_NE(module, nullptr);
+
+    // The host function interrupts the execution calling it.
+    FizzyExternalFunction host_funcs[] = {{{FizzyValueTypeVoid, nullptr, 0},
+        [](void*, FizzyInstance*, const FizzyValue*, int) {
+            fizzy_interrupt(fizzy_get_thread_execution_context());
+            return FizzyExecutionResult{false, false, {}, false};
+        },
+        nullptr}};
+
+    auto instance = fizzy_instantiate(module, host_funcs, 1, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
+    ASSERT_NE(instance, nullptr);
+
+    auto* context = fizzy_get_thread_execution_context();
+    ASSERT_NE(context, nullptr);
+    EXPECT_EQ(fizzy_get_thread_execution_context(), context);
+
+    // The request made while nothing is executed is discarded.
+    fizzy_interrupt(context);
+    EXPECT_THAT(fizzy_execute(instance, 0, nullptr, 0), CResult());
+
+    const auto result = fizzy_execute(instance, 1, nullptr, 0);
+    EXPECT_THAT(result, CTraps());
+    EXPECT_TRUE(result.interrupted);
+
+    fizzy_free_instance(instance);
+}
+
 TEST(capi, execute_with_host_function)
 {
     /* wat2wasm
@@ -589,18 +849,20 @@ TEST(capi, execute_with_host_function)
 
     const FizzyValueType inputs[] = {FizzyValueTypeI32, FizzyValueTypeI32};
 
-    FizzyExternalFunction host_funcs[] = {{{FizzyValueTypeI32, nullptr, 0},
-                                              [](void*, FizzyInstance*, const FizzyValue*, int) {
-                                                  return FizzyExecutionResult{false, true, {42}};
-                                              },
-                                              nullptr},
+    FizzyExternalFunction host_funcs[] = {
+        {{FizzyValueTypeI32, nullptr, 0},
+            [](void*, FizzyInstance*, const FizzyValue*, int) {
+                return FizzyExecutionResult{false, true, {42}, false};
+            },
+            nullptr},
         {{FizzyValueTypeI32, &inputs[0], 2},
             [](void*, FizzyInstance*, const FizzyValue* args, int) {
-                return FizzyExecutionResult{false, true, {args[0].i64 / args[1].i64}};
+                return FizzyExecutionResult{false, true, {args[0].i64 / args[1].i64}, false};
             },
             nullptr}};
 
     auto instance = fizzy_instantiate(module, host_funcs, 2, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     EXPECT_THAT(fizzy_execute(instance, 0, nullptr, 0), CResult(42));
@@ -626,11 +888,12 @@ TEST(capi, imported_function_traps)
 
     FizzyExternalFunction host_funcs[] = {{{FizzyValueTypeI32, nullptr, 0},
         [](void*, FizzyInstance*, const FizzyValue*, int) {
-            return FizzyExecutionResult{true, false, {}};
+            return FizzyExecutionResult{true, false, {}, false};
         },
         nullptr}};
 
     auto instance = fizzy_instantiate(module, host_funcs, 1, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     EXPECT_THAT(fizzy_execute(instance, 1, nullptr, 0), CTraps());
@@ -638,6 +901,42 @@ TEST(capi, imported_function_traps)
     fizzy_free_instance(instance);
 }
 
+TEST(capi, imported_function_interrupted_flag_ignored_when_not_trapped)
+{
+    /* wat2wasm
+      (func (import "m" "foo") (result i32))
+      (func (result i32)
+        call 0
+      )
+    */
+    const auto wasm =
+        from_hex("0061736d010000000105016000017f020901016d03666f6f0000030201000a0601040010000b");
+    auto module = fizzy_parse(wasm.data(), wasm.size());
+    ASSERT_NE(module, nullptr);
+
+    // The host function written before the interrupted flag existed may leave it set to garbage.
+    FizzyExternalFunction host_funcs[] = {{{FizzyValueTypeI32, nullptr, 0},
+        [](void*, FizzyInstance*, const FizzyValue*, int) {
+            FizzyExecutionResult result;
+            result.trapped = false;
+            result.has_value = true;
+            result.value.i64 = 42;
+            result.interrupted = true;
+            return result;
+        },
+        nullptr}};
+
+    auto instance = fizzy_instantiate(module, host_funcs, 1, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
+    ASSERT_NE(instance, nullptr);
+
+    const auto result = fizzy_execute(instance, 1, nullptr, 0);
+    EXPECT_THAT(result, CResult(42));
+    EXPECT_FALSE(result.interrupted);
+
+    fizzy_free_instance(instance);
+}
+
 TEST(capi, imported_function_void)
 {
     /* wat2wasm
@@ -655,11 +954,12 @@ TEST(capi, imported_function_void)
     FizzyExternalFunction host_funcs[] = {{{},
         [](void* context, FizzyInstance*, const FizzyValue*, int) {
             *static_cast<bool*>(context) = true;
-            return FizzyExecutionResult{false, false, {}};
+            return FizzyExecutionResult{false, false, {}, false};
         },
         &called}};
 
     auto instance = fizzy_instantiate(module, host_funcs, 1, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module);
     ASSERT_NE(instance, nullptr);
 
     EXPECT_THAT(fizzy_execute(instance, 1, nullptr, 0), CResult());
@@ -705,6 +1005,7 @@ TEST(capi, imported_function_from_another_module)
 
     uint32_t func_idx;
     ASSERT_TRUE(fizzy_find_exported_function(module1, "sub", &func_idx));
+    fizzy_free_module(module1);
 
     auto host_context = std::make_pair(instance1, func_idx);
 
@@ -721,6 +1022,7 @@ TEST(capi, imported_function_from_another_module)
     FizzyExternalFunction host_funcs[] = {{{FizzyValueTypeI32, &inputs[0], 2}, sub, &host_context}};
 
     auto instance2 = fizzy_instantiate(module2, host_funcs, 1, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module2);
     ASSERT_NE(instance2, nullptr);
 
     FizzyValue args[] = {{44}, {2}};
@@ -743,6 +1045,7 @@ TEST(capi, imported_table_from_another_module)
     auto module1 = fizzy_parse(bin1.data(), bin1.size());
     ASSERT_NE(module1, nullptr);
     auto instance1 = fizzy_instantiate(module1, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module1);
     ASSERT_NE(instance1, nullptr);
 
     /* wat2wasm
@@ -761,6 +1064,7 @@ TEST(capi, imported_table_from_another_module)
     ASSERT_TRUE(fizzy_find_exported_table(instance1, "t", &table));
 
     auto instance2 = fizzy_instantiate(module2, nullptr, 0, &table, nullptr, nullptr, 0);
+    fizzy_free_module(module2);
     ASSERT_NE(instance2, nullptr);
 
     EXPECT_THAT(fizzy_execute(instance2, 0, nullptr, 0), CResult(42));
@@ -779,6 +1083,7 @@ TEST(capi, imported_memory_from_another_module)
     auto module1 = fizzy_parse(bin1.data(), bin1.size());
     ASSERT_NE(module1, nullptr);
     auto instance1 = fizzy_instantiate(module1, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module1);
     ASSERT_NE(instance1, nullptr);
 
     /* wat2wasm
@@ -797,6 +1102,7 @@ TEST(capi, imported_memory_from_another_module)
     ASSERT_TRUE(fizzy_find_exported_memory(instance1, "m", &memory));
 
     auto instance2 = fizzy_instantiate(module2, nullptr, 0, nullptr, &memory, nullptr, 0);
+    fizzy_free_module(module2);
     ASSERT_NE(instance2, nullptr);
 
     EXPECT_THAT(fizzy_execute(instance2, 0, nullptr, 0), CResult(0x00ffaa00));
@@ -814,6 +1120,7 @@ TEST(capi, imported_global_from_another_module)
     auto module1 = fizzy_parse(bin1.data(), bin1.size());
     ASSERT_NE(module1, nullptr);
     auto instance1 = fizzy_instantiate(module1, nullptr, 0, nullptr, nullptr, nullptr, 0);
+    fizzy_free_module(module1);
     ASSERT_NE(instance1, nullptr);
 
     /* wat2wasm
@@ -833,6 +1140,7 @@ TEST(capi, imported_global_from_another_module)
     ASSERT_TRUE(fizzy_find_exported_global(instance1, "g", &global));
 
     auto instance2 = fizzy_instantiate(module2, nullptr, 0, nullptr, nullptr, &global, 1);
+    fizzy_free_module(module2);
     ASSERT_NE(instance2, nullptr);
 
     EXPECT_THAT(fizzy_execute(instance2, 0, nullptr, 0), CResult(42));
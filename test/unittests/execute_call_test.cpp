@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: Apache-2.0
 
 #include "execute.hpp"
+#include "execution_context.hpp"
 #include "limits.hpp"
 #include "parser.hpp"
 #include <gtest/gtest.h>
@@ -84,6 +85,132 @@ TEST(execute_call, call_shared_stack_space)
     EXPECT_THAT(execute(*instance, 1, {2, 3}), Result(10));  // double(2+3)
 }
 
+TEST(execute_call, call_local_variables_zeroed)
+{
+    /* wat2wasm
+    (module
+      (func $f (param i32) (result i32) (local i32)
+        local.get 1
+        local.get 0
+        i32.add
+      )
+
+      (func $main (result i32)
+        i32.const 1
+        i32.const 2
+        i32.const 3
+        drop
+        drop
+        call $f
+      )
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d01000000010a0260017f017f6000017f03030200010a18020901017f200120006a0b0c004101410241"
+        "031a1a10000b");
+
+    // The frame of $f is placed over the dropped values of $main's operand stack.
+    EXPECT_THAT(execute(parse(wasm), 1, {}), Result(1));
+}
+
+TEST(execute_call, call_frames_exceeding_stack_space)
+{
+    /* wat2wasm
+    (func $f (param i32) (result i32) (local i64)
+      local.get 0
+      i32.eqz
+      if (result i32)
+        local.get 1
+        i32.wrap_i64
+      else
+        local.get 0
+        i32.const 1
+        i32.sub
+        call $f
+        i32.const 1
+        i32.add
+      end
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f030201000a1a011801017e200045047f2001a705200041016b100041"
+        "016a0b0b");
+    const auto module = parse(wasm);
+
+    // Increase the number of local variables so that the frames of the deep recursion
+    // do not fit in the execution context stack space.
+    constexpr uint32_t local_count = 10000;
+    static_assert(10 * local_count < ExecutionContext::DefaultStackSpaceSize);
+    static_assert(100 * local_count > ExecutionContext::DefaultStackSpaceSize);
+    const_cast<Code&>(module->codesec[0]).local_count = local_count;
+
+    EXPECT_THAT(execute(module, 0, {10}), Result(10));
+
+    // The call exhausting the stack space traps instead of recursing natively.
+    EXPECT_THAT(execute(module, 0, {100}), Traps());
+    EXPECT_EQ(get_thread_execution_context().num_call_frames(), 0);
+}
+
+TEST(execute_call, call_depth_limit)
+{
+    /* wat2wasm
+    (func $f (param i32) (result i32)
+      local.get 0
+      i32.eqz
+      if (result i32)
+        i32.const 0
+      else
+        local.get 0
+        i32.const 1
+        i32.sub
+        call $f
+        i32.const 1
+        i32.add
+      end
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f030201000a17011500200045047f410005200041016b100041016a0b"
+        "0b");
+    const auto module = parse(wasm);
+
+    reset_thread_execution_context(ExecutionContext::DefaultStackSpaceSize, 10);
+    EXPECT_THAT(execute(module, 0, {10}), Result(10));
+    EXPECT_THAT(execute(module, 0, {11}), Traps());
+    reset_thread_execution_context(ExecutionContext::DefaultStackSpaceSize, CallStackLimit);
+
+    EXPECT_THAT(execute(module, 0, {11}), Result(11));
+}
+
+TEST(execute_call, imported_function_args_preserved_by_nested_execute)
+{
+    /* wat2wasm
+    (import "m" "f" (func $f (param i32) (result i32)))
+    (func $g (param i32) (result i32)
+      local.get 0
+      i32.const 1000
+      i32.add
+    )
+    (func $main (param i32) (result i32)
+      local.get 0
+      call $f
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f020701016d0166000003030200000a11020800200041e8076a0b0600"
+        "200010000b");
+
+    const auto module = parse(wasm);
+    auto host_f = [](Instance& instance, const Value* args, int) -> ExecutionResult {
+        const auto result = execute(instance, 1, {uint32_t{99}});
+        // The args are still valid after the nested execution.
+        return Value{args[0].as<uint32_t>() + result.value.as<uint32_t>()};
+    };
+
+    auto instance = instantiate(*module, {{host_f, module->typesec[0]}});
+    EXPECT_THAT(execute(*instance, 2, {5}), Result(1104));
+}
+
 TEST(execute_call, call_indirect)
 {
     /* wat2wasm
@@ -209,6 +336,59 @@ TEST(execute_call, call_indirect_imported_table)
     EXPECT_THAT(execute(*instance, 0, {5}), Traps());
 }
 
+TEST(execute_call, call_indirect_imported_table_different_type_indices)
+{
+    /* wat2wasm
+    (module
+     (table 5 20 anyfunc)
+     (export "t" (table 0))
+     (elem (i32.const 0) $f3 $f2 $f1 $f4 $f5)
+     (func $f1 (result i32) (i32.const 1))
+     (func $f2 (result i32) (i32.const 2))
+     (func $f3 (result i32) (i32.const 3))
+     (func $f4 (result i64) (i64.const 4))
+     (func $f5 (result i32) unreachable)
+    )
+    */
+    const auto bin_exported_table = from_hex(
+        "0061736d010000000109026000017f6000017e03060500000001000405017001051407050101740100090b0100"
+        "41000b0502010003040a1905040041010b040041020b040041030b040042040b0300000b");
+    auto instance_exported_table = instantiate(parse(bin_exported_table));
+    auto table = find_exported_table(*instance_exported_table, "t");
+    ASSERT_TRUE(table.has_value());
+
+    // The types have different indices than in the module exporting the table.
+    /* wat2wasm
+    (module
+      (type $out_i64 (func (result i64)))
+      (type $out_i32 (func (result i32)))
+      (import "m" "t" (table 5 20 anyfunc))
+
+      (func (param i32) (result i32)
+        (call_indirect (type $out_i32) (get_local 0))
+      )
+      (func (param i32) (result i64)
+        (call_indirect (type $out_i64) (get_local 0))
+      )
+    )
+    */
+    const auto bin = from_hex(
+        "0061736d010000000113046000017e6000017f60017f017f60017f017e020a01016d01740170010514030302"
+        "02030a1102070020001101000b070020001100000b");
+    auto module = parse(bin);
+    EXPECT_NE(module->typesec_ids[0], module->typesec_ids[1]);
+    EXPECT_EQ(module->typesec_ids[0], instance_exported_table->module->typesec_ids[1]);
+    EXPECT_EQ(module->typesec_ids[1], instance_exported_table->module->typesec_ids[0]);
+
+    auto instance = instantiate(std::move(module), {}, {*table});
+
+    EXPECT_THAT(execute(*instance, 0, {0}), Result(3));
+    EXPECT_THAT(execute(*instance, 0, {2}), Result(1));
+    EXPECT_THAT(execute(*instance, 0, {3}), Traps());
+    EXPECT_THAT(execute(*instance, 1, {3}), Result(4));
+    EXPECT_THAT(execute(*instance, 1, {0}), Traps());
+}
+
 TEST(execute_call, call_indirect_uninited_table)
 {
     /* wat2wasm
@@ -519,6 +699,68 @@ TEST(execute_call, call_indirect_infinite_recursion)
 constexpr int MaxDepth = 2048;
 static_assert(MaxDepth == CallStackLimit);
 
+TEST(execute_call, trap_in_nested_call_releases_call_frames)
+{
+    /* wat2wasm
+    (func $f (param i32) (result i32)
+      local.get 0
+      i32.eqz
+      if
+        unreachable
+      end
+      local.get 0
+      i32.const 1
+      i32.sub
+      call $f
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f030201000a120110002000450440000b200041016b10000b");
+    auto instance = instantiate(parse(wasm));
+
+    auto& context = get_thread_execution_context();
+    const auto* const free_space = context.free_space();
+
+    EXPECT_THAT(execute(*instance, 0, {1000}), Traps());
+    EXPECT_EQ(context.num_call_frames(), 0);
+    EXPECT_EQ(context.free_space(), free_space);
+}
+
+TEST(execute_call, out_of_bounds_memory_access_in_nested_call_releases_call_frames)
+{
+    /* wat2wasm
+    (memory 1)
+    (func $f (param i32) (result i32)
+      local.get 0
+      i32.eqz
+      if
+        i32.const 65536
+        i32.load
+        drop
+      end
+      local.get 0
+      i32.const 1
+      i32.sub
+      call $f
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f0302010005030100010a190117002000450440418080042802001a0b"
+        "200041016b10000b");
+    auto instance = instantiate(parse(wasm));
+
+    auto& context = get_thread_execution_context();
+    const auto* const free_space = context.free_space();
+
+    EXPECT_THAT(execute(*instance, 0, {1000}), Traps());
+    EXPECT_EQ(context.num_call_frames(), 0);
+    EXPECT_EQ(context.free_space(), free_space);
+
+    // The execution is not affected by the previous trap.
+    EXPECT_THAT(execute(*instance, 0, {1}), Traps());
+    EXPECT_EQ(context.num_call_frames(), 0);
+}
+
 TEST(execute_call, call_max_depth)
 {
     /* wat2wasm
@@ -534,6 +776,37 @@ TEST(execute_call, call_max_depth)
     EXPECT_THAT(execute(*instance, 1, {}, MaxDepth), Traps());
 }
 
+TEST(execute_call, call_max_depth_recursion)
+{
+    /* wat2wasm
+    (func $f (param i32) (result i32)
+      local.get 0
+      i32.eqz
+      if (result i32)
+        i32.const 0
+      else
+        local.get 0
+        i32.const 1
+        i32.sub
+        call $f
+        i32.const 1
+        i32.add
+      end
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f030201000a17011500200045047f410005200041016b100041016a0b"
+        "0b");
+    auto instance = instantiate(parse(wasm));
+
+    EXPECT_THAT(execute(*instance, 0, {MaxDepth}), Result(MaxDepth));
+    EXPECT_THAT(execute(*instance, 0, {MaxDepth + 1}), Traps());
+    const Value args[]{uint32_t{MaxDepth - 10}};
+    EXPECT_THAT(execute(*instance, 0, args, 10), Result(MaxDepth - 10));
+    EXPECT_THAT(execute(*instance, 0, args, 11), Traps());
+    EXPECT_EQ(get_thread_execution_context().num_call_frames(), 0);
+}
+
 // A regression test for incorrect number of arguments passed to a call.
 TEST(execute_call, call_nonempty_stack)
 {
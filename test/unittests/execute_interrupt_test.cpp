@@ -0,0 +1,163 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2019-2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "execution_context.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+#include <atomic>
+#include <thread>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+(func (loop (br 0)))
+*/
+const auto infinite_loop_wasm =
+    from_hex("0061736d01000000010401600000030201000a0901070003400c000b0b");
+
+/* wat2wasm
+(func (param i32) (result i32)
+  (loop
+    local.get 0
+    i32.const 1
+    i32.sub
+    local.tee 0
+    br_if 0
+  )
+  local.get 0
+)
+*/
+const auto countdown_wasm = from_hex(
+    "0061736d0100000001060160017f017f030201000a120110000340200041016b22000d000b20000b");
+}  // namespace
+
+TEST(execute_interrupt, interrupt_before_execution_discarded)
+{
+    auto& context = get_thread_execution_context();
+
+    // The request made while nothing is executed does not stop the next execution.
+    context.interrupt();
+    const auto result = execute(parse(countdown_wasm), 0, {1000});
+    EXPECT_THAT(result, Result(0));
+    EXPECT_FALSE(result.interrupted);
+    EXPECT_FALSE(context.interrupt_requested());
+    EXPECT_EQ(context.num_call_frames(), 0);
+}
+
+TEST(execute_interrupt, infinite_loop_interrupted_from_other_thread)
+{
+    const auto module = parse(infinite_loop_wasm);
+    auto instance = instantiate(*module);
+
+    std::atomic<ExecutionContext*> worker_context{nullptr};
+    std::atomic<bool> done{false};
+    bool interrupted = false;
+    std::thread worker{[&] {
+        worker_context = &get_thread_execution_context();
+        interrupted = execute(*instance, 0, {}).interrupted;
+        done = true;
+    }};
+
+    while (worker_context == nullptr)
+        std::this_thread::yield();
+    // The request made before the execution starts is discarded, so it is repeated.
+    while (!done)
+    {
+        worker_context.load()->interrupt();
+        std::this_thread::yield();
+    }
+    worker.join();
+
+    EXPECT_TRUE(interrupted);
+    // The context of this thread is not affected.
+    EXPECT_FALSE(get_thread_execution_context().interrupt_requested());
+}
+
+TEST(execute_interrupt, recursion_interrupted_at_call)
+{
+    /* wat2wasm
+    (func (import "m" "f"))
+    (func (call 0) (call 1))
+    */
+    const auto wasm = from_hex(
+        "0061736d01000000010401600000020701016d01660000030201000a08010600100010010b");
+    const auto module = parse(wasm);
+    bool interrupt = true;
+    const auto host = [&interrupt](Instance&, const Value*, int) {
+        if (interrupt)
+            get_thread_execution_context().interrupt();
+        return Void;
+    };
+    auto instance = instantiate(*module, {{host, module->typesec[0]}});
+
+    const auto result = execute(*instance, 1, {});
+    EXPECT_THAT(result, Traps());
+    EXPECT_TRUE(result.interrupted);
+
+    // Without the interruption, the call depth limit is reached.
+    interrupt = false;
+    const auto trap = execute(*instance, 1, {});
+    EXPECT_THAT(trap, Traps());
+    EXPECT_FALSE(trap.interrupted);
+}
+
+TEST(execute_interrupt, nested_execution_interrupted)
+{
+    /* wat2wasm
+    (func (import "m" "f"))
+    (func
+      call 0
+      (loop (br 0))
+    )
+    (func (loop (br 0)))
+    */
+    const auto wasm = from_hex(
+        "0061736d01000000010401600000020701016d0166000003030200000a13020900100003400c000b0b070003"
+        "400c000b0b");
+    const auto module = parse(wasm);
+
+    // The interruption of the nested execution is propagated to the outer one.
+    const auto host = [](Instance& host_instance, const Value*, int depth) {
+        get_thread_execution_context().interrupt();
+        const auto result = execute(host_instance, 2, nullptr, depth + 1);
+        EXPECT_TRUE(result.interrupted);
+        EXPECT_TRUE(get_thread_execution_context().interrupt_requested());
+        return result;
+    };
+    auto instance = instantiate(*module, {{host, module->typesec[0]}});
+
+    const auto result = execute(*instance, 1, {});
+    EXPECT_TRUE(result.interrupted);
+    EXPECT_FALSE(get_thread_execution_context().interrupt_requested());
+
+    // The outer execution is interrupted even if the host function does not propagate
+    // the result of the nested one.
+    const auto void_host = [](Instance& host_instance, const Value*, int depth) {
+        get_thread_execution_context().interrupt();
+        EXPECT_TRUE(execute(host_instance, 2, nullptr, depth + 1).interrupted);
+        return Void;
+    };
+    auto void_host_instance = instantiate(*module, {{void_host, module->typesec[0]}});
+
+    EXPECT_TRUE(execute(*void_host_instance, 1, {}).interrupted);
+    EXPECT_FALSE(get_thread_execution_context().interrupt_requested());
+}
+
+TEST(execute_interrupt, trap_not_interrupted)
+{
+    /* wat2wasm
+    (func unreachable)
+    */
+    const auto wasm = from_hex("0061736d01000000010401600000030201000a05010300000b");
+    const auto result = execute(parse(wasm), 0, {});
+    EXPECT_THAT(result, Traps());
+    EXPECT_FALSE(result.interrupted);
+}
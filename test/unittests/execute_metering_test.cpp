@@ -0,0 +1,204 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2019-2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "instructions.hpp"
+#include "parser.hpp"
+#include <gmock/gmock.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+#include <array>
+
+using namespace fizzy;
+using namespace fizzy::test;
+using testing::ElementsAre;
+
+namespace
+{
+/* wat2wasm
+(func (param i32) (result i32)
+  (loop
+    local.get 0
+    i32.const 1
+    i32.sub
+    local.tee 0
+    br_if 0
+  )
+  local.get 0
+)
+*/
+const auto loop_wasm = from_hex(
+    "0061736d0100000001060160017f017f030201000a120110000340200041016b22000d000b20000b");
+}  // namespace
+
+TEST(execute_metering, not_metered_without_cost_table)
+{
+    const auto module = parse(loop_wasm);
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::i32_add_imm, 0xff, 0xff, 0xff, 0xff,
+            Instr::local_tee, 0, 0, 0, 0, Instr::br_if_no_drop, /*arity:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 0, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::local_get, 0, 0, 0, 0,
+            Instr::end_function));
+}
+
+TEST(execute_metering, basic_blocks)
+{
+    const auto module = parse(loop_wasm, get_default_instruction_cost_table());
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::meter, /*cost:*/ 1, 0, 0, 0, 0, 0, 0, 0,  // loop
+            /*9:*/ Instr::meter, /*cost:*/ 5, 0, 0, 0, 0, 0, 0, 0,   // the loop body
+            Instr::local_get, 0, 0, 0, 0, Instr::i32_add_imm, 0xff, 0xff, 0xff, 0xff,
+            Instr::local_tee, 0, 0, 0, 0, Instr::br_if_no_drop, /*arity:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 9, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            // The block of the loop end merged with the following one.
+            Instr::meter, /*cost:*/ 3, 0, 0, 0, 0, 0, 0, 0, Instr::local_get, 0, 0, 0, 0,
+            Instr::end_function));
+}
+
+TEST(execute_metering, loop_charged_per_iteration)
+{
+    const auto module = parse(loop_wasm, get_default_instruction_cost_table());
+    auto instance = instantiate(*module);
+
+    for (const uint32_t n : {1u, 3u, 10u})
+    {
+        int64_t gas_left = 1000;
+        const Value args[]{n};
+        EXPECT_THAT(execute(*instance, 0, args, gas_left), Result(0));
+        EXPECT_EQ(gas_left, 1000 - (4 + 5 * int64_t{n}));
+    }
+}
+
+TEST(execute_metering, out_of_gas)
+{
+    const auto module = parse(loop_wasm, get_default_instruction_cost_table());
+    auto instance = instantiate(*module);
+    const Value args[]{3};
+
+    int64_t gas_left = 19;
+    EXPECT_THAT(execute(*instance, 0, args, gas_left), Result(0));
+    EXPECT_EQ(gas_left, 0);
+
+    gas_left = 18;
+    EXPECT_THAT(execute(*instance, 0, args, gas_left), Traps());
+    EXPECT_EQ(gas_left, -1);
+
+    gas_left = 0;
+    EXPECT_THAT(execute(*instance, 0, args, gas_left), Traps());
+    EXPECT_EQ(gas_left, -1);
+
+    // The execution without the gas budget is not limited.
+    EXPECT_THAT(execute(*instance, 0, {1000}), Result(0));
+}
+
+TEST(execute_metering, custom_cost_table)
+{
+    auto cost_table = std::array<uint32_t, InstructionCostTableSize>{};
+    cost_table[static_cast<uint8_t>(Instr::i32_sub)] = 10;
+    cost_table[static_cast<uint8_t>(Instr::br_if)] = 2;
+    cost_table[static_cast<uint8_t>(Instr::end)] = 1;
+
+    const auto module = parse(loop_wasm, cost_table.data());
+    auto instance = instantiate(*module);
+
+    int64_t gas_left = 100;
+    const Value args[]{3};
+    EXPECT_THAT(execute(*instance, 0, args, gas_left), Result(0));
+    EXPECT_EQ(gas_left, 100 - (2 + 12 * 3));
+}
+
+TEST(execute_metering, unreachable_code_not_charged)
+{
+    /* wat2wasm
+    (func (result i32)
+      (block (result i32)
+        i32.const 1
+        br 0
+        i32.const 2
+        drop
+      )
+    )
+    */
+    const auto wasm =
+        from_hex("0061736d010000000105016000017f030201000a0e010c00027f41010c0041021a0b0b");
+    const auto module = parse(wasm, get_default_instruction_cost_table());
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::meter, /*cost:*/ 3, 0, 0, 0, 0, 0, 0, 0, Instr::i32_const, 1, 0, 0, 0,
+            Instr::br_no_drop, /*arity:*/ 1, 0, 0, 0, /*code_offset:*/ 33, 0, 0, 0,
+            /*stack_drop:*/ 0, 0, 0, 0, Instr::i32_const, 2, 0, 0, 0, Instr::drop,
+            /*33:*/ Instr::meter, /*cost:*/ 1, 0, 0, 0, 0, 0, 0, 0, Instr::end_function));
+
+    auto instance = instantiate(*module);
+    int64_t gas_left = 10;
+    EXPECT_THAT(execute(*instance, 0, nullptr, gas_left), Result(1));
+    EXPECT_EQ(gas_left, 6);
+}
+
+TEST(execute_metering, call)
+{
+    /* wat2wasm
+    (func (param i32) (result i32)
+      local.get 0
+      call 1
+    )
+    (func (param i32) (result i32)
+      local.get 0
+      i32.const 1
+      i32.add
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f03030200000a10020600200010010b0700200041016a0b");
+    const auto module = parse(wasm, get_default_instruction_cost_table());
+    auto instance = instantiate(*module);
+
+    int64_t gas_left = 7;
+    const Value args[]{1};
+    EXPECT_THAT(execute(*instance, 0, args, gas_left), Result(2));
+    EXPECT_EQ(gas_left, 0);
+
+    gas_left = 6;
+    EXPECT_THAT(execute(*instance, 0, args, gas_left), Traps());
+    EXPECT_EQ(gas_left, -1);
+}
+
+TEST(execute_metering, host_function_execution_charged)
+{
+    /* wat2wasm
+    (func (import "m" "f") (result i32))
+    (func (result i32) call 0)
+    (func (result i32) i32.const 5)
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000105016000017f020701016d0166000003030200000a0b02040010000b040041050b");
+    const auto module = parse(wasm, get_default_instruction_cost_table());
+
+    // The nested execution is charged against the budget of the outer one.
+    const auto host = [](Instance& host_instance, const Value*, int depth) {
+        return execute(host_instance, 2, nullptr, depth + 1);
+    };
+    auto instance = instantiate(*module, {{host, module->typesec[0]}});
+
+    int64_t gas_left = 10;
+    EXPECT_THAT(execute(*instance, 1, nullptr, gas_left), Result(5));
+    EXPECT_EQ(gas_left, 6);
+
+    gas_left = 3;
+    EXPECT_THAT(execute(*instance, 1, nullptr, gas_left), Traps());
+    EXPECT_EQ(gas_left, -1);
+
+    // The nested execution with its own budget is independent.
+    const auto metered_host = [](Instance& host_instance, const Value*, int depth) {
+        int64_t nested_gas_left = 2;
+        const auto result = execute(host_instance, 2, nullptr, nested_gas_left, depth + 1);
+        EXPECT_EQ(nested_gas_left, 0);
+        return result;
+    };
+    auto metered_instance = instantiate(*module, {{metered_host, module->typesec[0]}});
+
+    gas_left = 2;
+    EXPECT_THAT(execute(*metered_instance, 1, nullptr, gas_left), Result(5));
+    EXPECT_EQ(gas_left, 0);
+}
@@ -0,0 +1,350 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2019-2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "instructions.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+(func (param i32) (result i32)
+  (loop
+    local.get 0
+    i32.const 1
+    i32.sub
+    local.tee 0
+    br_if 0
+  )
+  local.get 0
+)
+*/
+const auto loop_wasm = from_hex(
+    "0061736d0100000001060160017f017f030201000a120110000340200041016b22000d000b20000b");
+
+/* wat2wasm
+(func (param i64) (result i64)
+  (if (result i64) (i64.eqz (local.get 0))
+    (then (i64.const 1))
+    (else
+      (i64.mul (local.get 0) (call 0 (i64.sub (local.get 0) (i64.const 1))))
+    )
+  )
+)
+*/
+const auto factorial_wasm = from_hex(
+    "0061736d0100000001060160017e017e030201000a17011500200050047e4201052000200042017d10007e0b0b");
+
+/* wat2wasm
+(func (import "m" "f") (param i32) (result i32))
+(func (param i32) (result i32)
+  local.get 0
+  call 0
+  call 0
+)
+*/
+const auto host_calls_wasm = from_hex(
+    "0061736d0100000001060160017f017f020701016d01660000030201000a0a0108002000100010000b");
+
+/* wat2wasm
+(func (loop (br 0)))
+*/
+const auto infinite_loop_wasm =
+    from_hex("0061736d01000000010401600000030201000a0901070003400c000b0b");
+}  // namespace
+
+TEST(execute_resumable, suspend_and_resume)
+{
+    const auto module = parse(loop_wasm, get_default_instruction_cost_table());
+    auto instance = instantiate(*module);
+
+    // The loop of 10 iterations costs 1 + 10 * 5 + 3.
+    ExecutionHandle handle;
+    const Value args[]{10};
+    const auto result = execute(*instance, 0, args, 10, handle);
+    EXPECT_TRUE(result.suspended);
+    EXPECT_FALSE(result.trapped);
+    ASSERT_NE(handle, nullptr);
+
+    int num_suspensions = 1;
+    while (true)
+    {
+        const auto resumed_result = resume(handle, 10);
+        if (!resumed_result.suspended)
+        {
+            EXPECT_THAT(resumed_result, Result(0));
+            break;
+        }
+        ++num_suspensions;
+    }
+    EXPECT_EQ(handle, nullptr);
+    EXPECT_EQ(num_suspensions, 5);
+}
+
+TEST(execute_resumable, fuel_left_kept)
+{
+    const auto module = parse(loop_wasm, get_default_instruction_cost_table());
+    auto instance = instantiate(*module);
+
+    // The fuel of 5 is not enough for the loop body after the loop entry.
+    ExecutionHandle handle;
+    const Value args[]{1};
+    EXPECT_TRUE(execute(*instance, 0, args, 5, handle).suspended);
+    ASSERT_NE(handle, nullptr);
+    EXPECT_EQ(handle->context.gas_left(), 4);
+
+    // The loop body is charged again, so the fuel of 1 is enough with the fuel left.
+    EXPECT_TRUE(resume(handle, 1).suspended);
+    EXPECT_EQ(handle->context.gas_left(), 0);
+    EXPECT_THAT(resume(handle, 3), Result(0));
+    EXPECT_EQ(handle, nullptr);
+}
+
+TEST(execute_resumable, suspended_in_called_function)
+{
+    const auto module = parse(factorial_wasm, get_default_instruction_cost_table());
+    auto instance = instantiate(*module);
+
+    ExecutionHandle handle;
+    const Value args[]{uint64_t{20}};
+    EXPECT_TRUE(execute(*instance, 0, args, 1, handle).suspended);
+    size_t max_num_call_frames = 0;
+    while (true)
+    {
+        ASSERT_NE(handle, nullptr);
+        max_num_call_frames = std::max(max_num_call_frames, handle->context.num_call_frames());
+        const auto result = resume(handle, 1);
+        if (!result.suspended)
+        {
+            EXPECT_THAT(result, Result(uint64_t{2432902008176640000}));
+            break;
+        }
+    }
+    EXPECT_EQ(max_num_call_frames, 20);
+    EXPECT_EQ(get_thread_execution_context().num_call_frames(), 0);
+}
+
+TEST(execute_resumable, interleaved_executions)
+{
+    const auto module = parse(factorial_wasm, get_default_instruction_cost_table());
+    auto instance = instantiate(*module);
+
+    ExecutionHandle handles[3];
+    const uint64_t inputs[]{5, 10, 15};
+    const uint64_t expected_results[]{120, 3628800, 1307674368000};
+
+    for (size_t i = 0; i < std::size(handles); ++i)
+    {
+        const Value args[]{inputs[i]};
+        EXPECT_TRUE(execute(*instance, 0, args, 7, handles[i]).suspended);
+    }
+
+    size_t num_finished = 0;
+    while (num_finished != std::size(handles))
+    {
+        for (size_t i = 0; i < std::size(handles); ++i)
+        {
+            if (handles[i] == nullptr)
+                continue;
+
+            // The other executions on this thread do not affect the suspended ones.
+            EXPECT_THAT(execute(*instance, 0, {uint64_t{3}}), Result(6));
+
+            if (const auto result = resume(handles[i], 7); !result.suspended)
+            {
+                EXPECT_THAT(result, Result(expected_results[i]));
+                ++num_finished;
+            }
+        }
+    }
+}
+
+TEST(execute_resumable, not_metered)
+{
+    const auto module = parse(loop_wasm);
+    auto instance = instantiate(*module);
+
+    // The limited fuel would never run out.
+    ExecutionHandle handle;
+    const Value args[]{1000};
+    EXPECT_THAT(execute(*instance, 0, args, 1, handle), Traps());
+    EXPECT_EQ(handle, nullptr);
+    EXPECT_THAT(execute(*instance, 0, args, 0, handle), Traps());
+    EXPECT_EQ(handle, nullptr);
+
+    // With the unlimited fuel, the execution is suspended only at the host function calls.
+    EXPECT_THAT(execute(*instance, 0, args, ExecutionContext::UnlimitedGas, handle), Result(0));
+    EXPECT_EQ(handle, nullptr);
+}
+
+TEST(execute_resumable, trap_ends_execution)
+{
+    /* wat2wasm
+    (func nop unreachable)
+    */
+    const auto wasm = from_hex("0061736d01000000010401600000030201000a0601040001000b");
+    const auto module = parse(wasm, get_default_instruction_cost_table());
+    auto instance = instantiate(*module);
+
+    ExecutionHandle handle;
+    EXPECT_TRUE(execute(*instance, 0, nullptr, 1, handle).suspended);
+    ASSERT_NE(handle, nullptr);
+
+    EXPECT_THAT(resume(handle, 10), Traps());
+    EXPECT_EQ(handle, nullptr);
+}
+
+TEST(execute_resumable, host_call_pending)
+{
+    const auto module = parse(host_calls_wasm);
+
+    std::vector<uint32_t> host_args;
+    const auto host = [&host_args](Instance&, const Value* args, int) {
+        host_args.push_back(args[0].as<uint32_t>());
+        return Suspended;
+    };
+    auto instance = instantiate(*module, {{host, module->typesec[0]}});
+
+    ExecutionHandle handle;
+    const Value args[]{5};
+    EXPECT_TRUE(execute(*instance, 1, args, ExecutionContext::UnlimitedGas, handle).suspended);
+    ASSERT_NE(handle, nullptr);
+    EXPECT_TRUE(handle->host_call_pending);
+    EXPECT_EQ(host_args, std::vector<uint32_t>{5});
+
+    EXPECT_TRUE(complete_host_call(handle, Value{10}).suspended);
+    ASSERT_NE(handle, nullptr);
+    EXPECT_TRUE(handle->host_call_pending);
+    EXPECT_EQ(host_args, (std::vector<uint32_t>{5, 10}));
+
+    EXPECT_THAT(complete_host_call(handle, Value{20}), Result(20));
+    EXPECT_EQ(handle, nullptr);
+}
+
+TEST(execute_resumable, host_call_pending_trap)
+{
+    const auto module = parse(host_calls_wasm);
+    const auto host = [](Instance&, const Value*, int) { return Suspended; };
+    auto instance = instantiate(*module, {{host, module->typesec[0]}});
+
+    ExecutionHandle handle;
+    const Value args[]{5};
+    EXPECT_TRUE(execute(*instance, 1, args, ExecutionContext::UnlimitedGas, handle).suspended);
+    ASSERT_NE(handle, nullptr);
+
+    EXPECT_THAT(complete_host_call(handle, Trap), Traps());
+    EXPECT_EQ(handle, nullptr);
+
+    // The execution which is not resumable cannot wait for the host function call.
+    EXPECT_THAT(execute(*instance, 1, args), Traps());
+    EXPECT_EQ(get_thread_execution_context().num_call_frames(), 0);
+
+    // Neither can the host function executed directly.
+    EXPECT_THAT(execute(*instance, 0, args, ExecutionContext::UnlimitedGas, handle), Traps());
+    EXPECT_EQ(handle, nullptr);
+    EXPECT_THAT(execute(*instance, 0, args), Traps());
+    std::vector<ExecutionResult> batch_results;
+    execute_batch(*instance, 0, args, 1, std::back_inserter(batch_results));
+    ASSERT_EQ(batch_results.size(), 1);
+    EXPECT_THAT(batch_results[0], Traps());
+}
+
+TEST(execute_resumable, host_call_pending_with_fuel)
+{
+    const auto module = parse(host_calls_wasm, get_default_instruction_cost_table());
+    const auto host = [](Instance&, const Value*, int) { return Suspended; };
+    auto instance = instantiate(*module, {{host, module->typesec[0]}});
+
+    // The function costs 4, charged before the first call.
+    ExecutionHandle handle;
+    const Value args[]{5};
+    EXPECT_TRUE(execute(*instance, 1, args, 3, handle).suspended);
+    ASSERT_NE(handle, nullptr);
+    EXPECT_FALSE(handle->host_call_pending);
+
+    EXPECT_TRUE(resume(handle, 1).suspended);
+    ASSERT_NE(handle, nullptr);
+    EXPECT_TRUE(handle->host_call_pending);
+    EXPECT_EQ(handle->context.gas_left(), 0);
+
+    EXPECT_TRUE(complete_host_call(handle, Value{1}).suspended);
+    EXPECT_THAT(complete_host_call(handle, Value{2}), Result(2));
+}
+
+TEST(execute_resumable, interrupted_at_call)
+{
+    const auto module = parse(host_calls_wasm);
+    const auto host = [](Instance&, const Value* args, int) {
+        get_thread_execution_context().interrupt();
+        return ExecutionResult{args[0]};
+    };
+    auto instance = instantiate(*module, {{host, module->typesec[0]}});
+
+    // The private context of the execution checks the requests to interrupt the thread.
+    ExecutionHandle handle;
+    const Value args[]{5};
+    const auto result = execute(*instance, 1, args, ExecutionContext::UnlimitedGas, handle);
+    EXPECT_THAT(result, Traps());
+    EXPECT_TRUE(result.interrupted);
+    EXPECT_EQ(handle, nullptr);
+    EXPECT_FALSE(get_thread_execution_context().interrupt_requested());
+}
+
+TEST(execute_resumable, interrupt_while_suspended_discarded)
+{
+    const auto module = parse(loop_wasm, get_default_instruction_cost_table());
+    auto instance = instantiate(*module);
+
+    ExecutionHandle handle;
+    const Value args[]{10};
+    EXPECT_TRUE(execute(*instance, 0, args, 1, handle).suspended);
+    ASSERT_NE(handle, nullptr);
+
+    get_thread_execution_context().interrupt();
+    const auto result = resume(handle, ExecutionContext::UnlimitedGas);
+    EXPECT_THAT(result, Result(0));
+    EXPECT_FALSE(result.interrupted);
+    EXPECT_EQ(handle, nullptr);
+}
+
+TEST(execute_resumable, infinite_loop_interrupted_from_other_thread)
+{
+    const auto module = parse(infinite_loop_wasm);
+    auto instance = instantiate(*module);
+
+    std::atomic<ExecutionContext*> worker_context{nullptr};
+    std::atomic<bool> done{false};
+    bool interrupted = false;
+    std::thread worker{[&] {
+        worker_context = &get_thread_execution_context();
+        ExecutionHandle handle;
+        interrupted =
+            execute(*instance, 0, nullptr, ExecutionContext::UnlimitedGas, handle).interrupted;
+        done = true;
+    }};
+
+    while (worker_context == nullptr)
+        std::this_thread::yield();
+    // The request made before the execution starts is discarded, so it is repeated.
+    while (!done)
+    {
+        worker_context.load()->interrupt();
+        std::this_thread::yield();
+    }
+    worker.join();
+
+    EXPECT_TRUE(interrupted);
+}
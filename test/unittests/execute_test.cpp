@@ -9,6 +9,9 @@
 #include <test/utils/asserts.hpp>
 #include <test/utils/execute_helpers.hpp>
 #include <test/utils/hex.hpp>
+#include <iterator>
+#include <thread>
+#include <vector>
 
 using namespace fizzy;
 using namespace fizzy::test;
@@ -315,7 +318,7 @@ TEST(execute, i32_load_imported_memory)
     const auto wasm = from_hex(
         "0061736d0100000001060160017f017f020b01036d6f64016d02010101030201000a0901070020002802000b");
 
-    bytes memory(PageSize, 0);
+    LinearMemory memory(PageSize);
     auto instance = instantiate(parse(wasm), {}, {}, {{&memory, {1, 1}}});
     memory[1] = 42;
     EXPECT_THAT(execute(*instance, 0, {1}), Result(42));
@@ -380,6 +383,11 @@ TEST(execute, i32_load_all_variants)
         from_hex("0061736d0100000001060160017f017f030201000504010101010a0901070020002802000b");
     const auto module = parse(wasm);
 
+    // Split the local_get+i32_load superinstruction to execute the replaced load instruction.
+    auto* const get_instr = const_cast<uint8_t*>(&module->codesec[0].instructions[0]);
+    ASSERT_EQ(*get_instr, Instr::local_get_i32_load);
+    *get_instr = static_cast<uint8_t>(Instr::local_get);
+
     auto* const load_instr = const_cast<uint8_t*>(&module->codesec[0].instructions[5]);
     ASSERT_EQ(*load_instr, Instr::i32_load);
     ASSERT_EQ(bytes_view(load_instr + 1, 4), "00000000"_bytes);  // load offset.
@@ -459,7 +467,7 @@ TEST(execute, i32_store_imported_memory)
         "0061736d0100000001060160027f7f00020b01036d6f64016d02010101030201000a0b01090020012000360200"
         "0b");
 
-    bytes memory(PageSize, 0);
+    LinearMemory memory(PageSize);
     auto instance = instantiate(parse(wasm), {}, {}, {{&memory, {1, 1}}});
     EXPECT_THAT(execute(*instance, 0, {42, 0}), Result());
     EXPECT_EQ(memory.substr(0, 4), from_hex("2a000000"));
@@ -687,12 +695,12 @@ TEST(execute, memory_grow_custom_hard_limit)
 
     for (const auto& [input, expected] : test_cases)
     {
-        bytes memory(PageSize, 0);
+        LinearMemory memory(PageSize);
         const auto instance =
             instantiate(*module_imported, {}, {}, {{&memory, {1, std::nullopt}}}, {}, 16);
         EXPECT_THAT(execute(*instance, 0, {input}), Result(expected));
 
-        bytes memory_max_limit(PageSize, 0);
+        LinearMemory memory_max_limit(PageSize);
         const auto instance_max_limit =
             instantiate(*module_imported, {}, {}, {{&memory_max_limit, {1, 16}}}, {}, 32);
         EXPECT_THAT(execute(*instance_max_limit, 0, {input}), Result(expected));
@@ -712,7 +720,7 @@ TEST(execute, memory_grow_custom_hard_limit)
 
     for (const auto& [input, expected] : test_cases)
     {
-        bytes memory(PageSize, 0);
+        LinearMemory memory(PageSize);
         const auto instance =
             instantiate(*module_imported_max_limit, {}, {}, {{&memory, {1, 16}}}, {}, 32);
         EXPECT_THAT(execute(*instance, 0, {input}), Result(expected));
@@ -732,7 +740,7 @@ TEST(execute, memory_grow_custom_hard_limit)
 
     for (const auto& [input, expected] : test_cases)
     {
-        bytes memory(PageSize, 0);
+        LinearMemory memory(PageSize);
         const auto instance =
             instantiate(*module_imported_max_limit_narrowing, {}, {}, {{&memory, {1, 16}}}, {}, 32);
         EXPECT_THAT(execute(*instance, 0, {input}), Result(expected));
@@ -1002,3 +1010,120 @@ TEST(execute, stack_abuse)
 
     EXPECT_THAT(execute(parse(wasm), 0, {1000}), Result(1136));
 }
+
+TEST(execute, batch)
+{
+    /* wat2wasm
+    (func (import "m" "f") (param i32 i32) (result i32))
+    (func (param i32 i32) (result i32)
+      local.get 0
+      local.get 1
+      i32.div_u
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001070160027f7f017f020701016d01660000030201000a09010700200020016e0b");
+    const auto module = parse(wasm);
+    const auto host = [](Instance&, const Value* args, int) -> ExecutionResult {
+        if (args[1].as<uint32_t>() == 0)
+            return Trap;
+        return Value{args[0].as<uint32_t>() % args[1].as<uint32_t>()};
+    };
+    auto instance = instantiate(*module, {{host, module->typesec[0]}});
+
+    const Value args_batch[]{7, 2, 9, 0, 12, 5};
+    std::vector<ExecutionResult> results;
+    execute_batch(*instance, 1, args_batch, 3, std::back_inserter(results));
+    ASSERT_EQ(results.size(), 3);
+    EXPECT_THAT(results[0], Result(3));
+    EXPECT_THAT(results[1], Traps());
+    EXPECT_THAT(results[2], Result(2));
+
+    std::vector<ExecutionResult> host_results;
+    execute_batch(*instance, 0, args_batch, 3, std::back_inserter(host_results));
+    ASSERT_EQ(host_results.size(), 3);
+    EXPECT_THAT(host_results[0], Result(1));
+    EXPECT_THAT(host_results[1], Traps());
+    EXPECT_THAT(host_results[2], Result(2));
+
+    std::vector<ExecutionResult> no_results;
+    execute_batch(*instance, 1, nullptr, 0, std::back_inserter(no_results));
+    EXPECT_TRUE(no_results.empty());
+}
+
+TEST(execute, batch_locals_reset)
+{
+    /* wat2wasm
+    (func (param i32) (result i32) (local i32)
+      local.get 1
+      local.get 0
+      i32.add
+      local.set 1
+      local.get 1
+    )
+    */
+    const auto wasm =
+        from_hex("0061736d0100000001060160017f017f030201000a0f010d01017f200120006a210120010b");
+    const auto module = parse(wasm);
+    auto instance = instantiate(*module);
+
+    const Value args_batch[]{1, 2, 3};
+    std::vector<ExecutionResult> results;
+    execute_batch(*instance, 0, args_batch, 3, std::back_inserter(results));
+    ASSERT_EQ(results.size(), 3);
+    EXPECT_THAT(results[0], Result(1));
+    EXPECT_THAT(results[1], Result(2));
+    EXPECT_THAT(results[2], Result(3));
+}
+
+TEST(execute, lazy_module)
+{
+    /* wat2wasm --no-check
+    (func (param i32) (result i32) (call 1 (local.get 0)))
+    (func (param i32) (result i32) (i32.add (local.get 0) (i32.const 1)))
+    (func (param i32) (result i32) (i64.const 0))
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f0304030000000a15030600200010010b0700200041016a0b04004200"
+        "0b");
+    EXPECT_THROW_MESSAGE(parse(wasm), validation_error, "type mismatch");
+
+    const auto module = parse_lazy(wasm);
+    ASSERT_NE(module->lazy_codesec, nullptr);
+    EXPECT_TRUE(module->codesec.empty());
+    auto instance = instantiate(*module);
+
+    EXPECT_THAT(execute(*instance, 0, {41}), Result(42));
+    EXPECT_THAT(execute(*instance, 1, {1}), Result(2));
+    // The invalid function traps.
+    EXPECT_THAT(execute(*instance, 2, {0}), Traps());
+    EXPECT_THAT(execute(*instance, 2, {0}), Traps());
+}
+
+TEST(execute, lazy_module_concurrent_first_calls)
+{
+    /* wat2wasm
+    (func (param i32) (result i32) (call 1 (local.get 0)))
+    (func (param i32) (result i32) (i32.add (local.get 0) (i32.const 1)))
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f03030200000a10020600200010010b0700200041016a0b");
+    const std::shared_ptr<const Module> module = parse_lazy(wasm);
+
+    std::vector<std::thread> threads;
+    std::vector<uint64_t> results(8);
+    for (auto& result : results)
+    {
+        threads.emplace_back([&module, &result] {
+            auto instance = instantiate(module);
+            const auto execution_result = execute(*instance, 0, {1});
+            result = execution_result.has_value ? execution_result.value.i64 : 0;
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (const auto result : results)
+        EXPECT_EQ(result, 2);
+    EXPECT_EQ(&module->get_code(1), &module->get_code(1));
+}
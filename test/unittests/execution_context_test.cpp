@@ -0,0 +1,120 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2019-2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execution_context.hpp"
+#include <gtest/gtest.h>
+
+using namespace fizzy;
+
+TEST(execution_context, can_allocate)
+{
+    ExecutionContext context{10};
+    auto* const begin = context.free_space();
+
+    EXPECT_TRUE(context.can_allocate(begin, 0));
+    EXPECT_TRUE(context.can_allocate(begin, 10));
+    EXPECT_FALSE(context.can_allocate(begin, 11));
+    EXPECT_TRUE(context.can_allocate(begin + 4, 6));
+    EXPECT_FALSE(context.can_allocate(begin + 4, 7));
+    EXPECT_TRUE(context.can_allocate(begin + 10, 0));
+    EXPECT_FALSE(context.can_allocate(begin + 10, 1));
+
+    Value outside[1];
+    EXPECT_FALSE(context.can_allocate(outside, 1));
+}
+
+TEST(execution_context, frame_guard)
+{
+    ExecutionContext context{10};
+    auto* const begin = context.free_space();
+
+    {
+        const ExecutionContext::FrameGuard guard1{context, begin, 5};
+        EXPECT_EQ(context.free_space(), begin + 5);
+
+        {
+            // The frame starting below the free space, e.g. at the call arguments.
+            const ExecutionContext::FrameGuard guard2{context, begin + 3, 2};
+            EXPECT_EQ(context.free_space(), begin + 5);
+
+            const ExecutionContext::FrameGuard guard3{context, begin + 4, 6};
+            EXPECT_EQ(context.free_space(), begin + 10);
+        }
+        EXPECT_EQ(context.free_space(), begin + 5);
+    }
+    EXPECT_EQ(context.free_space(), begin);
+}
+
+TEST(execution_context, thread_local_context)
+{
+    auto& context = get_thread_execution_context();
+    EXPECT_EQ(&get_thread_execution_context(), &context);
+    EXPECT_TRUE(
+        context.can_allocate(context.free_space(), ExecutionContext::DefaultStackSpaceSize));
+}
+
+TEST(execution_context, reset_thread_local_context)
+{
+    EXPECT_EQ(get_thread_execution_context().call_depth_limit(), CallStackLimit);
+
+    reset_thread_execution_context(10, 5);
+    auto& context = get_thread_execution_context();
+    EXPECT_EQ(context.call_depth_limit(), 5);
+    EXPECT_TRUE(context.can_allocate(context.free_space(), 10));
+    EXPECT_FALSE(context.can_allocate(context.free_space(), 11));
+
+    reset_thread_execution_context(ExecutionContext::DefaultStackSpaceSize, CallStackLimit);
+    EXPECT_EQ(get_thread_execution_context().call_depth_limit(), CallStackLimit);
+}
+
+TEST(execution_context, call_depth_limit)
+{
+    EXPECT_EQ(ExecutionContext{}.call_depth_limit(), CallStackLimit);
+    EXPECT_EQ((ExecutionContext{10, 3}.call_depth_limit()), 3);
+}
+
+TEST(execution_context, interrupt)
+{
+    ExecutionContext context;
+    EXPECT_FALSE(context.interrupt_requested());
+
+    context.interrupt();
+    EXPECT_TRUE(context.interrupt_requested());
+    context.interrupt();
+    EXPECT_TRUE(context.interrupt_requested());
+
+    context.clear_interrupt();
+    EXPECT_FALSE(context.interrupt_requested());
+}
+
+TEST(execution_context, call_frames)
+{
+    ExecutionContext context{10};
+    auto* const begin = context.free_space();
+    const uint8_t instructions[3]{};
+    const auto* const pc = &instructions[0];
+    EXPECT_EQ(context.num_call_frames(), 0);
+
+    context.push_call_frame(nullptr, nullptr, pc, {begin, begin, begin + 1}, begin + 2, 3);
+    EXPECT_EQ(context.num_call_frames(), 1);
+    EXPECT_EQ(context.free_space(), begin + 5);
+
+    context.push_call_frame(
+        nullptr, nullptr, pc + 1, {begin + 4, begin + 2, begin + 4}, begin + 5, 5);
+    EXPECT_EQ(context.num_call_frames(), 2);
+    EXPECT_EQ(context.free_space(), begin + 10);
+
+    const auto call_frame = context.pop_call_frame();
+    EXPECT_EQ(call_frame.return_pc, pc + 1);
+    EXPECT_EQ(call_frame.stack.top, begin + 4);
+    EXPECT_EQ(call_frame.stack.locals, begin + 2);
+    EXPECT_EQ(call_frame.stack.bottom, begin + 4);
+    EXPECT_EQ(context.num_call_frames(), 1);
+    EXPECT_EQ(context.free_space(), begin + 5);
+
+    context.push_call_frame(nullptr, nullptr, pc + 2, {}, begin + 5, 1);
+    context.drop_call_frames(0);
+    EXPECT_EQ(context.num_call_frames(), 0);
+    EXPECT_EQ(context.free_space(), begin);
+}
@@ -0,0 +1,139 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "instantiate.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/hex.hpp>
+#include <test/utils/instantiate_helpers.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+(memory 1)
+(global (mut i32) (i32.const 0))
+(table 2 funcref)
+(elem (i32.const 0) 1)
+(start 0)
+(func (global.set 0 (i32.add (global.get 0) (i32.const 1))))
+(func (result i32) (global.get 0))
+(func (export "init")
+  (drop (memory.grow (i32.const 1)))
+  (i32.store (i32.const 65536) (i32.const 42))
+  (global.set 0 (i32.const 100))
+)
+(func (result i32) (i32.load (i32.const 65536)))
+(func (param i32) (result i32) (call_indirect (type 1) (local.get 0)))
+*/
+const auto wasm = from_hex(
+    "0061736d01000000010d036000006000017f60017f017f030605000100010204040170000205030100010606"
+    "017f0141000b07080104696e697400020801000907010041000b01010a38050900230041016a24000b040023"
+    "000b1500410140001a41808004412a36020041e40024000b0900418080042802000b070020001101000b");
+
+class instance_image : public testing::Test
+{
+protected:
+    const std::string path = testing::TempDir() + "fizzy_instance_image_test.img";
+
+    void TearDown() override { std::remove(path.c_str()); }
+};
+}  // namespace
+
+TEST_F(instance_image, save_and_instantiate)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    auto instance = instantiate(module);
+    EXPECT_THAT(execute(*instance, 2, {}), Result());
+    save_instance_image(*instance, wasm, path);
+
+    auto image_instance = instantiate_from_image(module, wasm, path);
+    // The start function is not executed again.
+    EXPECT_THAT(execute(*image_instance, 1, {}), Result(100));
+    EXPECT_THAT(execute(*image_instance, 3, {}), Result(42));
+    EXPECT_EQ(image_instance->memory->size(), 2 * PageSize);
+    EXPECT_THAT(execute(*image_instance, 4, {0}), Result(100));
+    EXPECT_THAT(execute(*image_instance, 4, {1}), Traps());
+    EXPECT_EQ((*image_instance->table)[0].instance, image_instance.get());
+
+    // The modifications are not written back to the image.
+    (*image_instance->memory)[PageSize] = 0;
+    EXPECT_THAT(execute(*image_instance, 3, {}), Result(0));
+    auto other_image_instance = instantiate_from_image(module, wasm, path);
+    EXPECT_THAT(execute(*other_image_instance, 3, {}), Result(42));
+
+    // The memory mapped from the image can still grow.
+    EXPECT_EQ(other_image_instance->memory->size(), 2 * PageSize);
+    other_image_instance->memory->resize(3 * PageSize);
+    EXPECT_EQ(other_image_instance->memory->substr(2 * PageSize, 4), "00000000"_bytes);
+}
+
+TEST_F(instance_image, table_element_of_other_instance)
+{
+    const std::shared_ptr<const Module> module = parse(wasm);
+    auto instance = instantiate(module);
+    auto other_instance = instantiate(module);
+    (*instance->table)[1] = {other_instance.get(), 1, {}};
+
+    EXPECT_THROW_MESSAGE(save_instance_image(*instance, wasm, path), image_error,
+        "table element references a function of another instance");
+}
+
+TEST_F(instance_image, module_mismatch)
+{
+    auto instance = instantiate(parse(wasm));
+    save_instance_image(*instance, wasm, path);
+
+    /* wat2wasm
+    (memory 1)
+    */
+    const auto other_wasm = from_hex("0061736d010000000503010001");
+    EXPECT_THROW_MESSAGE(instantiate_from_image(parse(other_wasm), other_wasm, path),
+        image_error, "image doesn't match the module");
+}
+
+TEST_F(instance_image, binary_mismatch)
+{
+    auto instance = instantiate(parse(wasm));
+    save_instance_image(*instance, wasm, path);
+
+    // The same module with the custom section appended.
+    const auto other_wasm = wasm + from_hex("00020161");
+    EXPECT_THROW_MESSAGE(instantiate_from_image(parse(other_wasm), other_wasm, path),
+        image_error, "image doesn't match the module");
+    EXPECT_THROW_MESSAGE(instantiate_from_image(parse(wasm), other_wasm, path), image_error,
+        "image doesn't match the module");
+}
+
+TEST_F(instance_image, invalid_image)
+{
+    EXPECT_THROW_MESSAGE(instantiate_from_image(parse(wasm), wasm, path), image_error,
+        ("cannot open image file " + path).c_str());
+
+    std::ofstream{path} << "not an image";
+    EXPECT_THROW_MESSAGE(instantiate_from_image(parse(wasm), wasm, path), image_error,
+        ("invalid image file " + path).c_str());
+}
+
+TEST_F(instance_image, truncated_image)
+{
+    auto instance = instantiate(parse(wasm));
+    save_instance_image(*instance, wasm, path);
+
+    std::string image;
+    {
+        std::ifstream file{path, std::ios::binary};
+        image.assign(std::istreambuf_iterator<char>{file}, {});
+    }
+    std::ofstream{path, std::ios::binary} << image.substr(0, image.size() - 1);
+    EXPECT_THROW_MESSAGE(instantiate_from_image(parse(wasm), wasm, path), image_error,
+        ("invalid image file " + path).c_str());
+}
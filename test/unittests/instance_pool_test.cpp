@@ -0,0 +1,111 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "instance_pool.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/hex.hpp>
+#include <thread>
+#include <vector>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+(memory 1)
+(global (mut i32) (i32.const 0))
+(func (result i32)
+  (i32.store (i32.const 0) (i32.add (i32.load (i32.const 0)) (i32.const 1)))
+  (global.set 0 (i32.add (global.get 0) (i32.const 1)))
+  (i32.add (i32.load (i32.const 0)) (global.get 0))
+)
+*/
+const auto wasm = from_hex(
+    "0061736d010000000105016000017f0302010005030100010606017f0141000b0a20011e0041004100280200"
+    "41016a360200230041016a2400410028020023006a0b");
+
+InstancePool::Factory make_factory()
+{
+    return [module = std::shared_ptr<const Module>{parse(wasm)}] { return instantiate(module); };
+}
+
+void wait_for_ready(const InstancePool& pool, size_t num_ready)
+{
+    while (pool.num_ready() != num_ready)
+        std::this_thread::yield();
+}
+}  // namespace
+
+TEST(instance_pool, acquire_and_release)
+{
+    InstancePool pool{make_factory(), 2};
+    EXPECT_EQ(pool.num_ready(), 2);
+
+    auto instance = pool.acquire();
+    ASSERT_NE(instance, nullptr);
+    EXPECT_EQ(pool.num_ready(), 1);
+    EXPECT_THAT(execute(*instance, 0, {}), Result(2));
+    EXPECT_THAT(execute(*instance, 0, {}), Result(4));
+
+    pool.release(std::move(instance));
+    wait_for_ready(pool, 2);
+
+    // The released instances are reset.
+    for (auto i = 0; i < 2; ++i)
+    {
+        instance = pool.acquire();
+        EXPECT_THAT(execute(*instance, 0, {}), Result(2));
+        pool.release(std::move(instance));
+    }
+}
+
+TEST(instance_pool, pool_exhausted)
+{
+    InstancePool pool{make_factory(), 1};
+
+    auto instance1 = pool.acquire();
+    auto instance2 = pool.acquire();
+    ASSERT_NE(instance1, nullptr);
+    ASSERT_NE(instance2, nullptr);
+    EXPECT_NE(instance1, instance2);
+    EXPECT_EQ(pool.num_ready(), 0);
+    EXPECT_THAT(execute(*instance2, 0, {}), Result(2));
+
+    // Only as many instances as the pool size are kept.
+    EXPECT_EQ(pool.num_dropped(), 0);
+    pool.release(std::move(instance1));
+    pool.release(std::move(instance2));
+    wait_for_ready(pool, 1);
+    while (pool.num_dropped() != 1)
+        std::this_thread::yield();
+}
+
+TEST(instance_pool, concurrent_use)
+{
+    InstancePool pool{make_factory(), 4};
+
+    std::vector<std::thread> workers;
+    std::vector<int> num_failures(4);
+    for (auto& failures : num_failures)
+    {
+        workers.emplace_back([&pool, &failures] {
+            for (auto i = 0; i < 200; ++i)
+            {
+                auto instance = pool.acquire();
+                if (execute(*instance, 0, {}).value.i64 != 2)
+                    ++failures;
+                pool.release(std::move(instance));
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    for (const auto failures : num_failures)
+        EXPECT_EQ(failures, 0);
+}
@@ -0,0 +1,101 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "instantiate.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/hex.hpp>
+#include <test/utils/instantiate_helpers.hpp>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+(memory 1 4)
+(data (i32.const 0) "\01\02")
+(global (mut i32) (i32.const 10))
+(table 2 funcref)
+(elem (i32.const 0) 0)
+(func (result i32) i32.const 7)
+(func (param i32)
+  (i32.store (i32.const 0) (local.get 0))
+  (drop (memory.grow (i32.const 1)))
+  (i32.store (i32.const 65536) (local.get 0))
+  (global.set 0 (local.get 0))
+)
+(func (result i32) (i32.load (i32.const 0)))
+(func (result i32) (global.get 0))
+*/
+const auto wasm = from_hex(
+    "0061736d010000000109026000017f60017f00030504000100000404017000020504010101040606017f0141"
+    "0a0b0907010041000b01000a2f04040041070b1b0041002000360200410140001a4180800420003602002000"
+    "24000b070041002802000b040023000b0b08010041000b020102");
+}  // namespace
+
+TEST(instance_snapshot, reset)
+{
+    auto instance = instantiate(parse(wasm));
+    snapshot_instance(*instance);
+    ASSERT_NE(instance->snapshot, nullptr);
+
+    for (const uint32_t input : {0x11u, 0x22u})
+    {
+        EXPECT_THAT(execute(*instance, 1, {input}), Result());
+        EXPECT_THAT(execute(*instance, 2, {}), Result(input));
+        EXPECT_THAT(execute(*instance, 3, {}), Result(input));
+        EXPECT_EQ(instance->memory->size(), 2 * PageSize);
+        (*instance->table)[1] = {instance.get(), 0, nullptr};
+
+        reset_instance(*instance);
+        EXPECT_THAT(execute(*instance, 2, {}), Result(0x0201));
+        EXPECT_THAT(execute(*instance, 3, {}), Result(10));
+        EXPECT_EQ(instance->memory->size(), PageSize);
+        EXPECT_EQ((*instance->table)[0].instance, instance.get());
+        EXPECT_EQ((*instance->table)[1].instance, nullptr);
+    }
+
+    // The memory grown again after the reset is zeroed.
+    instance->memory->resize(2 * PageSize);
+    EXPECT_EQ(instance->memory->substr(PageSize, 4), "00000000"_bytes);
+}
+
+TEST(instance_snapshot, host_memory_modification)
+{
+    auto instance = instantiate(parse(wasm));
+    snapshot_instance(*instance);
+
+    // The modification made by the host directly is not tracked.
+    (*instance->memory)[0] = 0xff;
+    reset_instance(*instance);
+    EXPECT_THAT(execute(*instance, 2, {}), Result(0x02ff));
+
+    // The modification marked by the host is reverted.
+    (*instance->memory)[0] = 0xff;
+    instance->memory->mark_dirty(0, 1);
+    reset_instance(*instance);
+    EXPECT_THAT(execute(*instance, 2, {}), Result(0x0201));
+}
+
+TEST(instance_snapshot, imported_memory_not_saved)
+{
+    /* wat2wasm
+    (memory (import "m" "mem") 1)
+    (func (i32.store (i32.const 0) (i32.const 5)))
+    */
+    const auto importing_wasm = from_hex(
+        "0061736d01000000010401600000020a01016d036d656d020001030201000a0b010900410041053602000b");
+
+    LinearMemory imported_memory(PageSize);
+    auto instance = instantiate(parse(importing_wasm), {}, {}, {{&imported_memory, {1, {}}}});
+    snapshot_instance(*instance);
+    EXPECT_TRUE(instance->snapshot->memory.empty());
+
+    EXPECT_THAT(execute(*instance, 0, {}), Result());
+    reset_instance(*instance);
+    EXPECT_EQ(imported_memory[0], 5);
+}
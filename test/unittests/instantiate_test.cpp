@@ -184,7 +184,7 @@ TEST(instantiate, imported_memory)
     */
     const auto bin = from_hex("0061736d01000000020b01036d6f64016d02010103");
 
-    bytes memory(PageSize, 0);
+    LinearMemory memory(PageSize);
     auto instance = instantiate(parse(bin), {}, {}, {{&memory, {1, 3}}});
 
     ASSERT_TRUE(instance->memory);
@@ -202,7 +202,7 @@ TEST(instantiate, imported_memory_unlimited)
     */
     const auto bin = from_hex("0061736d01000000020a01036d6f64016d020001");
 
-    bytes memory(PageSize, 0);
+    LinearMemory memory(PageSize);
     auto instance = instantiate(parse(bin), {}, {}, {{&memory, {1, std::nullopt}}});
 
     ASSERT_TRUE(instance->memory);
@@ -219,7 +219,7 @@ TEST(instantiate, imported_memory_stricter_limits)
     */
     const auto bin = from_hex("0061736d01000000020b01036d6f64016d02010103");
 
-    bytes memory(PageSize * 2, 0);
+    LinearMemory memory(PageSize * 2);
     auto instance = instantiate(parse(bin), {}, {}, {{&memory, {2, 2}}});
 
     ASSERT_TRUE(instance->memory);
@@ -238,7 +238,7 @@ TEST(instantiate, imported_memory_invalid)
     const auto bin = from_hex("0061736d01000000020b01036d6f64016d02010103");
     const auto module = parse(bin);
 
-    bytes memory(PageSize, 0);
+    LinearMemory memory(PageSize);
 
     // Providing more than 1 memory
     EXPECT_THROW_MESSAGE(instantiate(*module, {}, {}, {{&memory, {1, 3}}, {&memory, {1, 1}}}),
@@ -257,7 +257,7 @@ TEST(instantiate, imported_memory_invalid)
         "module defines an imported memory but none was provided");
 
     // Provided min too low
-    bytes memory_empty;
+    LinearMemory memory_empty;
     EXPECT_THROW_MESSAGE(instantiate(*module, {}, {}, {{&memory_empty, {0, 3}}}), instantiate_error,
         "provided import's min is below import's min defined in module");
 
@@ -278,7 +278,7 @@ TEST(instantiate, imported_memory_invalid)
         "provided imported memory doesn't fit provided limits");
 
     // Allocated more than max
-    bytes memory_big(PageSize * 4, 0);
+    LinearMemory memory_big(PageSize * 4);
     EXPECT_THROW_MESSAGE(instantiate(*module, {}, {}, {{&memory_big, {1, 3}}}), instantiate_error,
         "provided imported memory doesn't fit provided limits");
 
@@ -436,6 +436,7 @@ TEST(instantiate, memory_single)
     auto instance = instantiate(*module);
 
     ASSERT_EQ(instance->memory->size(), PageSize);
+    EXPECT_EQ(instance->memory->max_size(), PageSize);
     EXPECT_EQ(instance->memory_limits.min, 1);
     ASSERT_TRUE(instance->memory_limits.max.has_value());
     EXPECT_EQ(instance->memory_limits.max, 1);
@@ -449,6 +450,7 @@ TEST(instantiate, memory_single_unspecified_maximum)
     auto instance = instantiate(*module);
 
     ASSERT_EQ(instance->memory->size(), PageSize);
+    EXPECT_EQ(instance->memory->max_size(), DefaultMemoryPagesLimit * PageSize);
     EXPECT_EQ(instance->memory_limits.min, 1);
     EXPECT_FALSE(instance->memory_limits.max.has_value());
 }
@@ -496,7 +498,7 @@ TEST(instantiate, imported_memory_custom_hard_limit)
     const auto bin = from_hex("0061736d01000000020c01036d6f64036d656d020002");
     const auto module = parse(bin);
 
-    bytes memory(PageSize * 3, 0);
+    LinearMemory memory(PageSize * 3);
 
     EXPECT_THROW_MESSAGE(instantiate(*module, {}, {}, {{&memory, {3, 4}}}, {}, 1),
         instantiate_error, "imported memory limits cannot exceed hard memory limit of 65536 bytes");
@@ -703,12 +705,14 @@ TEST(instantiate, element_section_out_of_bounds_doesnt_change_imported_table)
 
 TEST(instantiate, data_section)
 {
+    const auto init1 = "aaff"_bytes;
+    const auto init2 = "5555"_bytes;
     const auto module{std::make_unique<Module>()};
     module->memorysec.emplace_back(Memory{{1, 1}});
     // Memory contents: 0, 0xaa, 0xff, 0, ...
-    module->datasec.emplace_back(Data{{ConstantExpression::Kind::Constant, {1}}, {0xaa, 0xff}});
+    module->datasec.emplace_back(Data{{ConstantExpression::Kind::Constant, {1}}, init1});
     // Memory contents: 0, 0xaa, 0x55, 0x55, 0, ...
-    module->datasec.emplace_back(Data{{ConstantExpression::Kind::Constant, {2}}, {0x55, 0x55}});
+    module->datasec.emplace_back(Data{{ConstantExpression::Kind::Constant, {2}}, init2});
 
     auto instance = instantiate(*module);
 
@@ -717,12 +721,13 @@ TEST(instantiate, data_section)
 
 TEST(instantiate, data_section_offset_from_global)
 {
+    const auto init = "aaff"_bytes;
     const auto module{std::make_unique<Module>()};
     module->memorysec.emplace_back(Memory{{1, 1}});
     module->globalsec.emplace_back(
         Global{{ValType::i32, false}, {ConstantExpression::Kind::Constant, {42}}});
     // Memory contents: 0, 0xaa, 0xff, 0, ...
-    module->datasec.emplace_back(Data{{ConstantExpression::Kind::GlobalGet, {0}}, {0xaa, 0xff}});
+    module->datasec.emplace_back(Data{{ConstantExpression::Kind::GlobalGet, {0}}, init});
 
     auto instance = instantiate(*module);
 
@@ -749,10 +754,11 @@ TEST(instantiate, data_section_offset_from_imported_global)
 
 TEST(instantiate, data_section_offset_too_large)
 {
+    const auto init = "aaff"_bytes;
     const auto module{std::make_unique<Module>()};
     module->memorysec.emplace_back(Memory{{0, 1}});
     // Memory contents: 0, 0xaa, 0xff, 0, ...
-    module->datasec.emplace_back(Data{{ConstantExpression::Kind::Constant, {1}}, {0xaa, 0xff}});
+    module->datasec.emplace_back(Data{{ConstantExpression::Kind::Constant, {1}}, init});
 
     EXPECT_THROW_MESSAGE(
         instantiate(*module), instantiate_error, "data segment is out of memory bounds");
@@ -768,7 +774,7 @@ TEST(instantiate, data_section_fills_imported_memory)
     const auto bin =
         from_hex("0061736d01000000020b01036d6f64016d020101010b0f020041010b02aaff0041020b025555");
 
-    bytes memory(PageSize, 0);
+    LinearMemory memory(PageSize);
     auto instance = instantiate(parse(bin), {}, {}, {{&memory, {1, 1}}});
 
     EXPECT_EQ(memory.substr(0, 6), from_hex("00aa55550000"));
@@ -786,13 +792,72 @@ TEST(instantiate, data_section_out_of_bounds_doesnt_change_imported_memory)
     const auto bin =
         from_hex("0061736d01000000020a01016d036d656d0200010b0f020041000b016100418080040b0161");
 
-    bytes memory(PageSize, 0);
+    LinearMemory memory(PageSize);
     EXPECT_THROW_MESSAGE(instantiate(parse(bin), {}, {}, {{&memory, {1, 1}}}), instantiate_error,
         "data segment is out of memory bounds");
 
     EXPECT_EQ(memory[0], 0);
 }
 
+TEST(instantiate, data_section_memory_image)
+{
+    const auto init1 = bytes(PageSize, 0xaa);
+    const auto init2 = "55"_bytes;
+    const auto module{std::make_shared<Module>()};
+    module->memorysec.emplace_back(Memory{{2, 2}});
+    module->datasec.emplace_back(Data{{ConstantExpression::Kind::Constant, {1}}, init1});
+    module->datasec.emplace_back(Data{{ConstantExpression::Kind::Constant, {0}}, init2});
+
+    auto instance1 = instantiate(module);
+    ASSERT_NE(module->memory_image, nullptr);
+    EXPECT_EQ(module->memory_image->size(), 2 * PageSize);
+    const auto memory_image = module->memory_image;
+    auto instance2 = instantiate(module);
+    EXPECT_EQ(module->memory_image, memory_image);
+
+    for (const auto* instance : {instance1.get(), instance2.get()})
+    {
+        EXPECT_EQ(instance->memory->size(), 2 * PageSize);
+        EXPECT_EQ(instance->memory->substr(0, 3), "55aaaa"_bytes);
+        EXPECT_EQ(instance->memory->substr(PageSize - 1, 3), "aaaa00"_bytes);
+    }
+
+    // The instances don't share the modified pages.
+    (*instance1->memory)[1] = 0;
+    EXPECT_EQ((*instance2->memory)[1], 0xaa);
+    auto instance3 = instantiate(module);
+    EXPECT_EQ((*instance3->memory)[1], 0xaa);
+}
+
+TEST(instantiate, data_section_memory_image_not_built)
+{
+    const auto small_init = "aaff"_bytes;
+    const auto big_init = bytes(PageSize, 0xaa);
+
+    // Small data segments are copied.
+    auto module{std::make_shared<Module>()};
+    module->memorysec.emplace_back(Memory{{1, 1}});
+    module->datasec.emplace_back(Data{{ConstantExpression::Kind::Constant, {1}}, small_init});
+    EXPECT_EQ(instantiate(module)->memory->substr(0, 3), "00aaff"_bytes);
+    EXPECT_EQ(module->memory_image, nullptr);
+
+    // The offset from the global is not known until instantiation.
+    module = std::make_shared<Module>();
+    module->memorysec.emplace_back(Memory{{2, 2}});
+    module->globalsec.emplace_back(
+        Global{{ValType::i32, false}, {ConstantExpression::Kind::Constant, {1}}});
+    module->datasec.emplace_back(Data{{ConstantExpression::Kind::GlobalGet, {0}}, big_init});
+    EXPECT_EQ(instantiate(module)->memory->substr(0, 2), "00aa"_bytes);
+    EXPECT_EQ(module->memory_image, nullptr);
+
+    module = std::make_shared<Module>();
+    module->memorysec.emplace_back(Memory{{1, 1}});
+    module->datasec.emplace_back(Data{{ConstantExpression::Kind::Constant, {1}}, big_init});
+    EXPECT_THROW_MESSAGE(
+        instantiate(module), instantiate_error, "data segment is out of memory bounds");
+    EXPECT_EQ(module->memory_image, nullptr);
+}
+
 TEST(instantiate, data_elem_section_errors_dont_change_imports)
 {
     /* wat2wasm
@@ -810,7 +875,7 @@ TEST(instantiate, data_elem_section_errors_dont_change_imports)
         "41000b0200000a0601040041010b0b0f020041000b016100418080040b0161");
 
     table_elements table(3);
-    bytes memory(PageSize, 0);
+    LinearMemory memory(PageSize);
     EXPECT_THROW_MESSAGE(
         instantiate(parse(bin_data_error), {}, {{&table, {3, std::nullopt}}}, {{&memory, {1, 1}}}),
         instantiate_error, "data segment is out of memory bounds");
@@ -954,3 +1019,31 @@ TEST(instantiate, start_unreachable)
     EXPECT_THROW_MESSAGE(
         instantiate(parse(wasm)), instantiate_error, "start function failed to execute");
 }
+
+TEST(instantiate, shared_module)
+{
+    /* wat2wasm
+      (memory 1)
+      (data (i32.const 0) "\2a")
+      (global (mut i32) (i32.const 1))
+    */
+    const auto wasm = from_hex("0061736d0100000005030100010606017f0141010b0b07010041000b012a");
+    std::shared_ptr<const Module> module = parse(wasm);
+
+    auto instance1 = instantiate(module);
+    auto instance2 = instantiate(module);
+    EXPECT_EQ(instance1->module, module);
+    EXPECT_EQ(instance2->module, module);
+    EXPECT_EQ(module.use_count(), 3);
+
+    // The instances share only the module.
+    instance1->globals[0] = Value{2};
+    (*instance1->memory)[0] = 0;
+    EXPECT_EQ(instance2->globals[0].i64, 1);
+    EXPECT_EQ((*instance2->memory)[0], 0x2a);
+
+    module.reset();
+    instance1.reset();
+    EXPECT_EQ(instance2->module.use_count(), 1);
+    EXPECT_EQ(instance2->module->memorysec.size(), 1);
+}
@@ -210,6 +210,30 @@ TEST(leb128, decode_out_of_buffer)
         parser_error, m);
 }
 
+TEST(leb128, decode_u64_followed_by_other_bytes)
+{
+    // With enough bytes following, the encoding is decoded without checking for the end.
+    const bytes padding(10, 0xff);
+
+    const auto input_624485 = bytes{0xe5, 0x8e, 0x26} + padding;
+    const auto res_624485 = leb128u_decode<uint64_t>(input_624485);
+    EXPECT_EQ(res_624485.first, 624485);
+    EXPECT_EQ(res_624485.second, &input_624485[3]);
+
+    const auto input_u64 =
+        bytes{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01} + padding;
+    const auto res_u64 = leb128u_decode<uint64_t>(input_u64);
+    EXPECT_EQ(res_u64.first, std::numeric_limits<uint64_t>::max());
+    EXPECT_EQ(res_u64.second, &input_u64[10]);
+
+    EXPECT_THROW_MESSAGE(leb128u_decode<uint64_t>(padding), parser_error,
+        "invalid LEB128 encoding: too many bytes");
+    EXPECT_THROW_MESSAGE(
+        leb128u_decode<uint64_t>(
+            bytes{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f} + padding),
+        parser_error, "invalid LEB128 encoding: unused bits set");
+}
+
 TEST(leb128, decode_s64)
 {
     // clang-format off
@@ -361,6 +385,30 @@ TEST(leb128, decode_s8_invalid)
         "invalid LEB128 encoding: unused bits not equal to sign bit");
 }
 
+TEST(leb128, decode_s64_followed_by_other_bytes)
+{
+    // With enough bytes following, the encoding is decoded without checking for the end.
+    const bytes padding(10, 0xff);
+
+    const auto input_minus_123456 = bytes{0xc0, 0xbb, 0x78} + padding;
+    const auto res_minus_123456 = leb128s_decode<int64_t>(input_minus_123456);
+    EXPECT_EQ(res_minus_123456.first, -123456);
+    EXPECT_EQ(res_minus_123456.second, &input_minus_123456[3]);
+
+    const auto input_s64 =
+        bytes{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x7f} + padding;
+    const auto res_s64 = leb128s_decode<int64_t>(input_s64);
+    EXPECT_EQ(res_s64.first, -1);
+    EXPECT_EQ(res_s64.second, &input_s64[10]);
+
+    EXPECT_THROW_MESSAGE(leb128s_decode<int64_t>(padding), parser_error,
+        "invalid LEB128 encoding: too many bytes");
+    EXPECT_THROW_MESSAGE(
+        leb128s_decode<int64_t>(
+            bytes{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01} + padding),
+        parser_error, "invalid LEB128 encoding: unused bits not equal to sign bit");
+}
+
 TEST(leb128, decode_s_out_of_buffer)
 {
     constexpr auto m = "unexpected EOF";
@@ -0,0 +1,206 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "limits.hpp"
+#include "linear_memory.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/hex.hpp>
+#include <algorithm>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+TEST(linear_memory, empty)
+{
+    const LinearMemory memory;
+    EXPECT_EQ(memory.size(), 0);
+    EXPECT_EQ(memory.max_size(), DefaultMemoryPagesLimit * PageSize);
+    EXPECT_EQ(memory.begin(), memory.end());
+    EXPECT_EQ(bytes_view{memory}.size(), 0);
+}
+
+TEST(linear_memory, construct_zeroed)
+{
+    const LinearMemory memory(2 * PageSize);
+    EXPECT_EQ(memory.size(), 2 * PageSize);
+    EXPECT_NE(memory.data(), nullptr);
+    EXPECT_TRUE(std::all_of(memory.begin(), memory.end(), [](uint8_t b) { return b == 0; }));
+}
+
+TEST(linear_memory, access)
+{
+    LinearMemory memory(PageSize);
+    memory[0] = 0xaa;
+    memory[PageSize - 1] = 0xbb;
+    std::fill_n(memory.begin() + 1, 2, uint8_t{0xcc});
+
+    EXPECT_EQ(memory.substr(0, 4), "aacccc00"_bytes);
+    EXPECT_EQ(memory.substr(PageSize - 2, 2), "00bb"_bytes);
+
+    const auto view = bytes_view{memory};
+    EXPECT_EQ(view.data(), memory.data());
+    EXPECT_EQ(view.size(), PageSize);
+    EXPECT_EQ(view[PageSize - 1], 0xbb);
+}
+
+TEST(linear_memory, resize)
+{
+    LinearMemory memory;
+    memory.resize(PageSize);
+    ASSERT_EQ(memory.size(), PageSize);
+    EXPECT_TRUE(std::all_of(memory.begin(), memory.end(), [](uint8_t b) { return b == 0; }));
+
+    memory[0] = 0x01;
+    memory[PageSize - 1] = 0x02;
+
+    memory.resize(3 * PageSize);
+    ASSERT_EQ(memory.size(), 3 * PageSize);
+    EXPECT_EQ(memory[0], 0x01);
+    EXPECT_EQ(memory[PageSize - 1], 0x02);
+    EXPECT_TRUE(
+        std::all_of(memory.begin() + PageSize, memory.end(), [](uint8_t b) { return b == 0; }));
+
+    // Resizing to the same size does nothing.
+    const auto* const data = memory.data();
+    memory.resize(3 * PageSize);
+    EXPECT_EQ(memory.size(), 3 * PageSize);
+    EXPECT_EQ(memory.data(), data);
+    EXPECT_EQ(memory[0], 0x01);
+}
+
+TEST(linear_memory, resize_in_place)
+{
+    LinearMemory memory(PageSize, 1024 * PageSize);
+    EXPECT_EQ(memory.max_size(), 1024 * PageSize);
+    memory[PageSize - 1] = 0xfe;
+
+    // The address space for the maximum size is reserved, so the data is never moved.
+    const auto* const data = memory.data();
+    for (size_t pages = 2; pages <= 1024; pages *= 2)
+    {
+        memory.resize(pages * PageSize);
+        ASSERT_EQ(memory.size(), pages * PageSize);
+        EXPECT_EQ(memory.data(), data);
+        EXPECT_EQ(memory[PageSize - 1], 0xfe);
+        EXPECT_EQ(memory[pages * PageSize - 1], 0);
+    }
+}
+
+TEST(linear_memory, resize_above_max_size)
+{
+    LinearMemory memory(PageSize, 2 * PageSize);
+    memory[0] = 0x01;
+
+    EXPECT_THROW(memory.resize(3 * PageSize), std::bad_alloc);
+    EXPECT_EQ(memory.size(), PageSize);
+    EXPECT_EQ(memory[0], 0x01);
+
+    memory.resize(2 * PageSize);
+    EXPECT_EQ(memory.size(), 2 * PageSize);
+    EXPECT_THROW(memory.resize(2 * PageSize + 1), std::bad_alloc);
+    EXPECT_EQ(memory.size(), 2 * PageSize);
+}
+
+TEST(linear_memory, construct_above_max_size)
+{
+    EXPECT_THROW(LinearMemory(2 * PageSize, PageSize), std::bad_alloc);
+}
+
+TEST(linear_memory, dirty_pages)
+{
+    LinearMemory memory(PageSize);
+    // All pages count as modified until the tracking starts.
+    memory.mark_dirty(0, 1);
+    for (size_t offset = 0; offset < PageSize; offset += LinearMemory::DirtyPageSize)
+        EXPECT_TRUE(memory.is_dirty(offset));
+
+    memory.clear_dirty_pages();
+    for (size_t offset = 0; offset < PageSize; offset += LinearMemory::DirtyPageSize)
+        EXPECT_FALSE(memory.is_dirty(offset));
+
+    memory.mark_dirty(LinearMemory::DirtyPageSize + 1, 1);
+    EXPECT_FALSE(memory.is_dirty(0));
+    EXPECT_TRUE(memory.is_dirty(LinearMemory::DirtyPageSize));
+    EXPECT_FALSE(memory.is_dirty(2 * LinearMemory::DirtyPageSize));
+
+    // The fragment crossing the page boundary marks both pages.
+    memory.mark_dirty(3 * LinearMemory::DirtyPageSize - 2, 4);
+    EXPECT_TRUE(memory.is_dirty(2 * LinearMemory::DirtyPageSize));
+    EXPECT_TRUE(memory.is_dirty(3 * LinearMemory::DirtyPageSize));
+    EXPECT_FALSE(memory.is_dirty(4 * LinearMemory::DirtyPageSize));
+
+    // The fragment spanning many pages marks all of them, not only the first and the last one.
+    memory.mark_dirty(5 * LinearMemory::DirtyPageSize - 1, 3 * LinearMemory::DirtyPageSize + 2);
+    for (size_t page = 4; page <= 8; ++page)
+        EXPECT_TRUE(memory.is_dirty(page * LinearMemory::DirtyPageSize));
+    EXPECT_FALSE(memory.is_dirty(9 * LinearMemory::DirtyPageSize));
+
+    memory.resize(2 * PageSize);
+    EXPECT_TRUE(memory.is_dirty(LinearMemory::DirtyPageSize));
+    EXPECT_FALSE(memory.is_dirty(PageSize));
+
+    memory.clear_dirty_pages();
+    for (size_t offset = 0; offset < memory.size(); offset += LinearMemory::DirtyPageSize)
+        EXPECT_FALSE(memory.is_dirty(offset));
+
+    // The store marks its page, or both pages when it crosses the page boundary.
+    memory.mark_stored<8>(PageSize);
+    EXPECT_TRUE(memory.is_dirty(PageSize));
+    EXPECT_FALSE(memory.is_dirty(PageSize + LinearMemory::DirtyPageSize));
+    memory.mark_stored<8>(PageSize + 2 * LinearMemory::DirtyPageSize - 4);
+    EXPECT_TRUE(memory.is_dirty(PageSize + LinearMemory::DirtyPageSize));
+    EXPECT_TRUE(memory.is_dirty(PageSize + 2 * LinearMemory::DirtyPageSize));
+    EXPECT_FALSE(memory.is_dirty(PageSize + 3 * LinearMemory::DirtyPageSize));
+}
+
+TEST(linear_memory, restore)
+{
+    LinearMemory memory(PageSize);
+    memory[0] = 0x01;
+    memory[PageSize - 1] = 0x02;
+    const auto state = bytes{bytes_view{memory}};
+    memory.clear_dirty_pages();
+
+    memory[0] = 0xaa;
+    memory.mark_dirty(0, 1);
+    // The modification which is not marked is not restored.
+    memory[PageSize - 1] = 0xbb;
+    memory.resize(3 * PageSize);
+    memory[2 * PageSize] = 0xcc;
+    memory.mark_dirty(2 * PageSize, 1);
+
+    memory.restore(state);
+    ASSERT_EQ(memory.size(), PageSize);
+    EXPECT_EQ(memory[0], 0x01);
+    EXPECT_EQ(memory[PageSize - 1], 0xbb);
+    EXPECT_FALSE(memory.is_dirty(0));
+
+    // The memory grown again after the restore is zeroed.
+    memory.resize(3 * PageSize);
+    EXPECT_TRUE(
+        std::all_of(memory.begin() + PageSize, memory.end(), [](uint8_t b) { return b == 0; }));
+}
+
+TEST(linear_memory, memory_image)
+{
+    const MemoryImage image{"0102"_bytes};
+    EXPECT_EQ(image.size(), PageSize);
+
+    LinearMemory memory1(2 * PageSize);
+    LinearMemory memory2(PageSize);
+    memory1[PageSize] = 0xff;
+    memory2[2] = 0xff;
+    memory1.map_image(image);
+    memory2.map_image(image);
+
+    EXPECT_EQ(memory1.substr(0, 3), "010200"_bytes);
+    EXPECT_EQ(memory1[PageSize], 0xff);
+    EXPECT_EQ(memory2.substr(0, 3), "010200"_bytes);
+
+    // The memories don't share the modifications.
+    memory1[0] = 0xaa;
+    EXPECT_EQ(memory2[0], 0x01);
+    memory2.resize(2 * PageSize);
+    EXPECT_EQ(memory2.substr(PageSize - 1, 2), "0000"_bytes);
+}
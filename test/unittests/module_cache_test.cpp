@@ -0,0 +1,158 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "instructions.hpp"
+#include "module_cache.hpp"
+#include "parser.hpp"
+#include <gtest/gtest.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/hex.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+using namespace fizzy;
+using namespace fizzy::test;
+
+namespace
+{
+/* wat2wasm
+(func $f (import "env" "f") (param i32) (result i32))
+(table 1 funcref)
+(memory 1)
+(global (mut i32) (i32.const 5))
+(export "add" (func 1))
+(elem (i32.const 0) 1)
+(func (param i32) (result i32) (i32.add (local.get 0) (global.get 0)))
+(data (i32.const 16) "hello")
+*/
+const auto wasm = from_hex(
+    "0061736d0100000001060160017f017f02090103656e76016600000302010004040170000105030100010606"
+    "017f0141050b0707010361646400010907010041000b01010a09010700200023006a0b0b0b010041100b0568"
+    "656c6c6f");
+
+class module_cache : public testing::Test
+{
+protected:
+    const std::string path = testing::TempDir() + "fizzy_module_cache_test.cache";
+
+    void TearDown() override { std::remove(path.c_str()); }
+
+    bytes read_file() const
+    {
+        std::ifstream file{path, std::ios::binary};
+        return bytes(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+    }
+
+    void write_file(bytes_view content) const
+    {
+        std::ofstream file{path, std::ios::binary};
+        file.write(reinterpret_cast<const char*>(content.data()),
+            static_cast<std::streamsize>(content.size()));
+    }
+};
+}  // namespace
+
+TEST_F(module_cache, save_and_load)
+{
+    const auto module = parse(wasm);
+    save_module_cache(*module, wasm, path);
+
+    const std::shared_ptr<const Module> cached_module = load_module_cache(wasm, path);
+    ASSERT_NE(cached_module, nullptr);
+    EXPECT_EQ(cached_module->typesec, module->typesec);
+    ASSERT_EQ(cached_module->importsec.size(), 1);
+    EXPECT_EQ(cached_module->importsec[0].module, "env");
+    EXPECT_EQ(cached_module->importsec[0].name, "f");
+    EXPECT_EQ(cached_module->imported_function_types, module->imported_function_types);
+    EXPECT_EQ(cached_module->function_type_ids, module->function_type_ids);
+    ASSERT_EQ(cached_module->exportsec.size(), 1);
+    EXPECT_EQ(cached_module->exportsec[0].name, "add");
+    EXPECT_EQ(cached_module->exportsec[0].index, 1);
+    ASSERT_EQ(cached_module->elementsec.size(), 1);
+    EXPECT_EQ(cached_module->elementsec[0].init, module->elementsec[0].init);
+    EXPECT_FALSE(cached_module->startfunc.has_value());
+
+    ASSERT_EQ(cached_module->codesec.size(), 1);
+    EXPECT_EQ(cached_module->codesec[0].instructions, module->codesec[0].instructions);
+    EXPECT_EQ(cached_module->codesec[0].max_stack_height, module->codesec[0].max_stack_height);
+    EXPECT_EQ(cached_module->codesec[0].local_count, module->codesec[0].local_count);
+
+    // The data segments refer to the cache file kept with the module.
+    ASSERT_EQ(cached_module->datasec.size(), 1);
+    EXPECT_EQ(cached_module->datasec[0].init, from_hex("68656c6c6f"));
+    EXPECT_NE(cached_module->data_storage, nullptr);
+
+    const auto host_function = [](Instance&, const Value* args, int) {
+        return ExecutionResult{args[0]};
+    };
+    auto instance =
+        instantiate(cached_module, {{host_function, {{ValType::i32}, {ValType::i32}}}});
+    EXPECT_THAT(execute(*instance, 1, {10}), Result(15));
+    EXPECT_EQ(instance->memory->substr(16, 5), from_hex("68656c6c6f"));
+}
+
+TEST_F(module_cache, metered)
+{
+    const auto* const cost_table = get_default_instruction_cost_table();
+    const auto module = parse(wasm, cost_table);
+    save_module_cache(*module, wasm, path, cost_table);
+
+    EXPECT_EQ(load_module_cache(wasm, path), nullptr);
+    const auto cached_module = load_module_cache(wasm, path, cost_table);
+    ASSERT_NE(cached_module, nullptr);
+    EXPECT_EQ(cached_module->codesec[0].instructions, module->codesec[0].instructions);
+}
+
+TEST_F(module_cache, load_missing)
+{
+    EXPECT_EQ(load_module_cache(wasm, path), nullptr);
+
+    write_file({});
+    EXPECT_EQ(load_module_cache(wasm, path), nullptr);
+}
+
+TEST_F(module_cache, load_other_binary)
+{
+    save_module_cache(*parse(wasm), wasm, path);
+
+    auto other_wasm = wasm;
+    other_wasm.back() = 'O';
+    EXPECT_EQ(load_module_cache(other_wasm, path), nullptr);
+    EXPECT_NE(load_module_cache(wasm, path), nullptr);
+}
+
+TEST_F(module_cache, load_corrupted)
+{
+    save_module_cache(*parse(wasm), wasm, path);
+    const auto content = read_file();
+
+    auto corrupted_content = content;
+    corrupted_content[content.size() / 2] ^= 0x01;
+    write_file(corrupted_content);
+    EXPECT_EQ(load_module_cache(wasm, path), nullptr);
+
+    write_file(content.substr(0, content.size() - 1));
+    EXPECT_EQ(load_module_cache(wasm, path), nullptr);
+
+    write_file(content.substr(0, 16));
+    EXPECT_EQ(load_module_cache(wasm, path), nullptr);
+
+    write_file(content);
+    EXPECT_NE(load_module_cache(wasm, path), nullptr);
+}
+
+TEST_F(module_cache, save_lazy_module)
+{
+    EXPECT_THROW_MESSAGE(save_module_cache(*parse_lazy(wasm), wasm, path), cache_error,
+        "module parsed lazily cannot be cached");
+}
+
+TEST_F(module_cache, save_to_invalid_path)
+{
+    const auto invalid_path = path + "/nonexistent/file";
+    EXPECT_THROW_MESSAGE(save_module_cache(*parse(wasm), wasm, invalid_path), cache_error,
+        ("cannot write module cache file " + invalid_path).c_str());
+}
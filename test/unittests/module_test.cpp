@@ -30,6 +30,15 @@ TEST(module, functions)
     EXPECT_EQ(module->get_function_type(2), (FuncType{{ValType::i64}, {}}));
     EXPECT_EQ(module->get_function_type(3), (FuncType{{}, {ValType::f32}}));
 
+    ASSERT_EQ(module->typesec_ids.size(), module->typesec.size());
+    for (size_t i = 0; i < module->typesec.size(); ++i)
+        EXPECT_EQ(module->typesec_ids[i], get_canonical_func_type_id(module->typesec[i]));
+    for (FuncIdx i = 0; i < module->get_function_count(); ++i)
+    {
+        EXPECT_EQ(module->get_function_type_id(i),
+            get_canonical_func_type_id(module->get_function_type(i)));
+    }
+
     EXPECT_EQ(module->get_code(1).instructions.size(), 1);
     EXPECT_EQ(module->get_code(1).local_count, 0);
     EXPECT_EQ(module->get_code(2).instructions.size(), 1);
@@ -14,8 +14,8 @@ using namespace testing;
 
 namespace
 {
-const Module ModuleWithSingleFunction = {
-    {FuncType{{}, {}}}, {}, {0}, {}, {}, {}, {}, std::nullopt, {}, {}, {}, {}, {}, {}, {}};
+const Module ModuleWithSingleFunction = {{FuncType{{}, {}}}, {}, {0}, {}, {}, {}, {}, std::nullopt,
+    {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}, {}};
 
 inline auto parse_expr(bytes_view input, FuncIdx func_idx = 0,
     const std::vector<Locals>& locals = {}, const Module& module = ModuleWithSingleFunction)
@@ -94,8 +94,8 @@ TEST(parser_expr, loop_br)
     const auto module = parse(wasm);
 
     EXPECT_THAT(module->codesec[0].instructions,
-        ElementsAre(Instr::loop, Instr::br, /*arity:*/ 0, 0, 0, 0, /*code_offset:*/ 0, 0, 0, 0,
-            /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::end));
+        ElementsAre(Instr::br_no_drop, /*arity:*/ 0, 0, 0, 0, /*code_offset:*/ 0, 0, 0, 0,
+            /*stack_drop:*/ 0, 0, 0, 0, Instr::end_function));
 
     /* wat2wasm
     (func
@@ -109,9 +109,9 @@ TEST(parser_expr, loop_br)
     const auto module_parent_stack = parse(wasm_parent_stack);
 
     EXPECT_THAT(module_parent_stack->codesec[0].instructions,
-        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::loop, Instr::br, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 5, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::drop,
-            Instr::end));
+        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::br_no_drop, /*arity:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 5, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::drop,
+            Instr::end_function));
 
     /* wat2wasm
     (func
@@ -127,9 +127,9 @@ TEST(parser_expr, loop_br)
     const auto module_arity = parse(wasm_arity);
 
     EXPECT_THAT(module_arity->codesec[0].instructions,
-        ElementsAre(Instr::loop, Instr::i32_const, 0, 0, 0, 0, Instr::br, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 0, 0, 0, 0, /*stack_drop:*/ 1, 0, 0, 0, Instr::end, Instr::drop,
-            Instr::end));
+        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::br_void, /*arity:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 0, 0, 0, 0, /*stack_drop:*/ 1, 0, 0, 0, Instr::drop,
+            Instr::end_function));
 }
 
 TEST(parser_expr, loop_return)
@@ -140,10 +140,9 @@ TEST(parser_expr, loop_return)
     const auto wasm = from_hex("0061736d01000000010401600000030201000a0801060003400f0b0b");
     const auto module = parse(wasm);
 
-    EXPECT_THAT(
-        module->codesec[0].instructions, ElementsAre(Instr::loop, Instr::return_,
-                                             /*arity:*/ 0, 0, 0, 0, /*code_offset:*/ 15, 0, 0, 0,
-                                             /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::end));
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::br_no_drop, /*arity:*/ 0, 0, 0, 0, /*code_offset:*/ 13, 0, 0, 0,
+            /*stack_drop:*/ 0, 0, 0, 0, Instr::end_function));
 }
 
 TEST(parser_expr, block_br)
@@ -182,9 +181,9 @@ TEST(parser_expr, block_br)
     const auto module_parent_stack = parse(wasm_parent_stack);
 
     EXPECT_THAT(module_parent_stack->codesec[0].instructions,
-        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::block, Instr::br, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 20, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::drop,
-            Instr::end));
+        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::br_no_drop, /*arity:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 18, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::drop,
+            Instr::end_function));
 
     /* wat2wasm
     (func
@@ -200,9 +199,9 @@ TEST(parser_expr, block_br)
     const auto module_arity = parse(wasm_arity);
 
     EXPECT_THAT(module_arity->codesec[0].instructions,
-        ElementsAre(Instr::block, Instr::i32_const, 0, 0, 0, 0, Instr::br, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 20, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::drop,
-            Instr::end));
+        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::br_no_drop, /*arity:*/ 1, 0, 0, 0,
+            /*code_offset:*/ 18, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::drop,
+            Instr::end_function));
 }
 
 TEST(parser_expr, block_return)
@@ -214,8 +213,8 @@ TEST(parser_expr, block_return)
     const auto module = parse(wasm);
 
     EXPECT_THAT(module->codesec[0].instructions,
-        ElementsAre(Instr::block, Instr::return_, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 15, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end, Instr::end));
+        ElementsAre(Instr::br_no_drop, /*arity:*/ 0, 0, 0, 0, /*code_offset:*/ 13, 0, 0, 0,
+            /*stack_drop:*/ 0, 0, 0, 0, Instr::end_function));
 }
 
 TEST(parser_expr, if_br)
@@ -230,10 +229,10 @@ TEST(parser_expr, if_br)
     const auto module = parse(wasm);
 
     EXPECT_THAT(module->codesec[0].instructions,
-        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::if_, /*else_offset:*/ 24, 0, 0, 0,
-            Instr::br, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 24, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*24:*/ Instr::end));
+        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::if_, /*else_offset:*/ 23, 0, 0, 0,
+            Instr::br_no_drop, /*arity:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 23, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            /*23:*/ Instr::end_function));
 
     /* wat2wasm
     (func
@@ -249,9 +248,9 @@ TEST(parser_expr, if_br)
 
     EXPECT_THAT(module_parent_stack->codesec[0].instructions,
         ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::i32_const, 0, 0, 0, 0, Instr::if_,
-            /*else_offset:*/ 29, 0, 0, 0, Instr::br, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 29, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            /*29:*/ Instr::end, Instr::drop, Instr::end));
+            /*else_offset:*/ 28, 0, 0, 0, Instr::br_no_drop, /*arity:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 28, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            /*28:*/ Instr::drop, Instr::end_function));
 }
 
 TEST(parser_expr, instr_br_table)
@@ -286,27 +285,26 @@ TEST(parser_expr, instr_br_table)
     const auto& code = module->codesec[0];
 
     EXPECT_THAT(code.instructions,
-        ElementsAre(Instr::block, Instr::block, Instr::block, Instr::block, Instr::block,
-            Instr::local_get, 0, 0, 0, 0, Instr::br_table,
+        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::br_table,
             /*label_count:*/ 4, 0, 0, 0, /*arity:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 135, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 116, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 97, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 78, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            /*code_offset:*/ 154, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-
-            /*59:*/ Instr::i32_const, 0x41, 0, 0, 0, Instr::return_, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 159, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*78:*/ Instr::i32_const, 0x42, 0, 0, 0, Instr::return_, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 159, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*97:*/ Instr::i32_const, 0x43, 0, 0, 0, Instr::return_, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 159, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*116:*/ Instr::i32_const, 0x44, 0, 0, 0, Instr::return_, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 159, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*135:*/ Instr::i32_const, 0x45, 0, 0, 0, Instr::return_, /*arity:*/ 1, 0, 0, 0,
-            /*code_offset:*/ 159, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0, Instr::end,
-            /*154:*/ Instr::i32_const, 0x46, 0, 0, 0,
-            /*159:*/ Instr::end));
+            /*code_offset:*/ 126, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 108, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 90, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 72, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 144, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+
+            /*54:*/ Instr::i32_const, 0x41, 0, 0, 0, Instr::br_no_drop, /*arity:*/ 1, 0, 0, 0,
+            /*code_offset:*/ 149, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            /*72:*/ Instr::i32_const, 0x42, 0, 0, 0, Instr::br_no_drop, /*arity:*/ 1, 0, 0, 0,
+            /*code_offset:*/ 149, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            /*90:*/ Instr::i32_const, 0x43, 0, 0, 0, Instr::br_no_drop, /*arity:*/ 1, 0, 0, 0,
+            /*code_offset:*/ 149, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            /*108:*/ Instr::i32_const, 0x44, 0, 0, 0, Instr::br_no_drop, /*arity:*/ 1, 0, 0, 0,
+            /*code_offset:*/ 149, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            /*126:*/ Instr::i32_const, 0x45, 0, 0, 0, Instr::br_no_drop, /*arity:*/ 1, 0, 0, 0,
+            /*code_offset:*/ 149, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            /*144:*/ Instr::i32_const, 0x46, 0, 0, 0,
+            /*149:*/ Instr::end_function));
 
     EXPECT_EQ(code.max_stack_height, 1);
 }
@@ -330,11 +328,11 @@ TEST(parser_expr, instr_br_table_empty_vector)
     const auto& code = module->codesec[0];
 
     EXPECT_THAT(code.instructions,
-        ElementsAre(Instr::block, Instr::local_get, 0, 0, 0, 0, Instr::br_table,
-            /*label_count:*/ 0, 0, 0, 0, /*arity:*/ 0, 0, 0, 0, /*code_offset:*/ 42, 0, 0, 0,
-            /*stack_drop:*/ 0, 0, 0, 0, Instr::i32_const, 0x63, 0, 0, 0, Instr::return_,
-            /*arity:*/ 1, 0, 0, 0, /*code_offset:*/ 47, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
-            Instr::end, Instr::i32_const, 0x64, 0, 0, 0, Instr::end));
+        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::br_table,
+            /*label_count:*/ 0, 0, 0, 0, /*arity:*/ 0, 0, 0, 0, /*code_offset:*/ 40, 0, 0, 0,
+            /*stack_drop:*/ 0, 0, 0, 0, Instr::i32_const, 0x63, 0, 0, 0, Instr::br_no_drop,
+            /*arity:*/ 1, 0, 0, 0, /*code_offset:*/ 45, 0, 0, 0, /*stack_drop:*/ 0, 0, 0, 0,
+            Instr::i32_const, 0x64, 0, 0, 0, Instr::end_function));
 
     EXPECT_EQ(code.max_stack_height, 1);
 }
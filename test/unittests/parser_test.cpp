@@ -1015,6 +1015,217 @@ TEST(parser, code_locals_too_many)
     }
 }
 
+TEST(parser, code_section_parallel)
+{
+    // 100 functions returning their indices.
+    constexpr uint32_t num_functions = 100;
+    bytes code_section = leb128u_encode(num_functions);
+    for (uint32_t i = 0; i < num_functions; ++i)
+        code_section += add_size_prefix("00"_bytes + i32_const(i) + "0b"_bytes);
+    const auto wasm = bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {0x7f})})) +
+                      make_section(3, leb128u_encode(num_functions) + bytes(num_functions, 0)) +
+                      make_section(10, code_section);
+
+    const auto module = parse(wasm);
+    for (const auto num_threads : {0u, 2u, 8u, 200u})
+    {
+        const auto parallel_module = parse(wasm, nullptr, num_threads);
+        ASSERT_EQ(parallel_module->codesec.size(), num_functions);
+        for (size_t i = 0; i < num_functions; ++i)
+        {
+            EXPECT_EQ(parallel_module->codesec[i].instructions, module->codesec[i].instructions);
+            EXPECT_EQ(parallel_module->codesec[i].max_stack_height,
+                module->codesec[i].max_stack_height);
+        }
+    }
+}
+
+TEST(parser, code_section_parallel_first_error)
+{
+    const auto invalid_instruction = add_size_prefix("00ff0b"_bytes);
+    const auto invalid_local_type = add_size_prefix("01017b0b"_bytes);
+    const auto make_wasm = [](const bytes& invalid_code1, const bytes& invalid_code2) {
+        constexpr uint32_t num_functions = 100;
+        bytes code_section = leb128u_encode(num_functions);
+        for (uint32_t i = 0; i < num_functions; ++i)
+        {
+            if (i == 30)
+                code_section += invalid_code1;
+            else if (i == 70)
+                code_section += invalid_code2;
+            else
+                code_section += add_size_prefix("000b"_bytes);
+        }
+        return bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {})})) +
+               make_section(3, leb128u_encode(num_functions) + bytes(num_functions, 0)) +
+               make_section(10, code_section);
+    };
+
+    // The error of the function of the lowest index is reported.
+    for (const auto num_threads : {1u, 0u, 2u, 8u, 200u})
+    {
+        EXPECT_THROW_MESSAGE(parse(make_wasm(invalid_instruction, invalid_local_type), nullptr,
+                                 num_threads),
+            parser_error, "invalid instruction 255");
+        EXPECT_THROW_MESSAGE(parse(make_wasm(invalid_local_type, invalid_instruction), nullptr,
+                                 num_threads),
+            parser_error, "invalid valtype 123");
+    }
+}
+
+TEST(parser, code_section_lazy)
+{
+    const auto code_bin = add_size_prefix("01027f20000b"_bytes);
+    const auto wasm = bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {0x7f})})) +
+                      make_section(3, "020000"_bytes) +
+                      make_section(10, make_vec({code_bin, code_bin}));
+
+    const auto module = parse_lazy(wasm, get_default_instruction_cost_table());
+    EXPECT_TRUE(module->codesec.empty());
+    ASSERT_NE(module->lazy_codesec, nullptr);
+    EXPECT_EQ(module->get_code_count(), 2);
+
+    // The code is parsed on first use, the same way as by parse().
+    const auto eager_module = parse(wasm, get_default_instruction_cost_table());
+    const auto& code = module->get_code(1);
+    EXPECT_EQ(code.local_count, 2);
+    EXPECT_EQ(code.instructions, eager_module->codesec[1].instructions);
+    EXPECT_EQ(&module->get_code(1), &code);
+}
+
+TEST(parser, code_section_lazy_structure_validated)
+{
+    // The function bodies must still match the function section.
+    const auto wasm = bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {})})) +
+                      make_section(3, "020000"_bytes) +
+                      make_section(10, make_vec({add_size_prefix("000b"_bytes)}));
+    EXPECT_THROW_MESSAGE(parse_lazy(wasm), parser_error,
+        "malformed binary: number of function and code entries must match");
+
+    const auto truncated_wasm = bytes{wasm_prefix} +
+                                make_section(1, make_vec({make_functype({}, {})})) +
+                                make_section(3, "0100"_bytes) + make_section(10, "01050b"_bytes);
+    EXPECT_THROW_MESSAGE(parse_lazy(truncated_wasm), parser_error, "unexpected EOF");
+}
+
+TEST(parser, streaming)
+{
+    constexpr uint32_t num_functions = 100;
+    bytes code_section = leb128u_encode(num_functions);
+    for (uint32_t i = 0; i < num_functions; ++i)
+        code_section += add_size_prefix("00"_bytes + i32_const(i) + "0b"_bytes);
+    const auto wasm =
+        bytes{wasm_prefix} + make_section(0, "046e616d65"_bytes) +
+        make_section(1, make_vec({make_functype({}, {0x7f})})) +
+        make_section(3, leb128u_encode(num_functions) + bytes(num_functions, 0)) +
+        make_section(5, make_vec({"0001"_bytes})) +
+        make_section(6, make_vec({"7f00412a0b"_bytes})) +
+        make_section(7, make_vec({"01660000"_bytes})) + make_section(10, code_section) +
+        make_section(11, make_vec({"0041000b03616263"_bytes})) + make_section(0, "0178ff"_bytes);
+
+    const auto expected_module = parse(wasm);
+    for (const size_t chunk_size : {size_t{1}, size_t{2}, size_t{7}, size_t{64}, wasm.size()})
+    {
+        StreamingParser parser;
+        for (size_t pos = 0; pos < wasm.size(); pos += chunk_size)
+            parser.push(bytes_view{wasm}.substr(pos, chunk_size));
+        const auto module = parser.finish();
+
+        EXPECT_EQ(module->typesec, expected_module->typesec);
+        EXPECT_EQ(module->function_type_ids, expected_module->function_type_ids);
+        EXPECT_EQ(module->memorysec.size(), 1);
+        EXPECT_EQ(module->globalsec.size(), 1);
+        ASSERT_EQ(module->exportsec.size(), 1);
+        EXPECT_EQ(module->exportsec[0].name, "f");
+        ASSERT_EQ(module->codesec.size(), num_functions);
+        for (size_t i = 0; i < num_functions; ++i)
+            EXPECT_EQ(module->codesec[i].instructions, expected_module->codesec[i].instructions);
+        ASSERT_EQ(module->datasec.size(), 1);
+        EXPECT_EQ(module->datasec[0].init, "616263"_bytes);
+    }
+}
+
+TEST(parser, streaming_empty_chunks)
+{
+    StreamingParser parser;
+    parser.push({});
+    parser.push(wasm_prefix);
+    parser.push({});
+    const auto module = parser.finish();
+    EXPECT_TRUE(module->typesec.empty());
+    EXPECT_TRUE(module->codesec.empty());
+}
+
+TEST(parser, streaming_function_validated_on_arrival)
+{
+    const auto wasm_head = bytes{wasm_prefix} + make_section(1, make_vec({make_functype({}, {})})) +
+                           make_section(3, "03000000"_bytes);
+    const auto valid_code = add_size_prefix("000b"_bytes);
+    const auto invalid_code = add_size_prefix("00ff0b"_bytes);
+
+    // The code section header declares 3 functions, only the first 2 arrive.
+    StreamingParser parser;
+    parser.push(wasm_head + "0a"_bytes + leb128u_encode(1 + 3 * valid_code.size()) + "03"_bytes);
+    parser.push(valid_code);
+    EXPECT_THROW_MESSAGE(parser.push(invalid_code), parser_error, "invalid instruction 255");
+}
+
+TEST(parser, streaming_errors)
+{
+    const auto parse_streaming = [](bytes_view wasm) {
+        StreamingParser parser;
+        for (const auto byte : wasm)
+            parser.push({&byte, 1});
+        return parser.finish();
+    };
+
+    EXPECT_THROW_MESSAGE(parse_streaming({}), parser_error, "invalid wasm module prefix");
+    EXPECT_THROW_MESSAGE(
+        parse_streaming(wasm_prefix.substr(0, 4)), parser_error, "invalid wasm module prefix");
+    EXPECT_THROW_MESSAGE(
+        parse_streaming("0061736d02000000"_bytes), parser_error, "invalid wasm module prefix");
+
+    const auto type_section = make_section(1, make_vec({make_functype({}, {})}));
+    const auto wasm = bytes{wasm_prefix} + type_section + make_section(3, "0100"_bytes) +
+                      make_section(10, make_vec({add_size_prefix("000b"_bytes)}));
+    EXPECT_THROW_MESSAGE(
+        parse_streaming(wasm.substr(0, wasm.size() - 1)), parser_error, "unexpected EOF");
+    EXPECT_THROW_MESSAGE(parse_streaming(wasm.substr(0, wasm_prefix.size() + 2)), parser_error,
+        "unexpected EOF");
+
+    EXPECT_THROW_MESSAGE(parse_streaming(bytes{wasm_prefix} + type_section + type_section),
+        parser_error, "unexpected out-of-order section type");
+
+    EXPECT_THROW_MESSAGE(
+        parse_streaming(bytes{wasm_prefix} + type_section + make_section(3, "0100"_bytes)),
+        parser_error, "malformed binary: number of function and code entries must match");
+    EXPECT_THROW_MESSAGE(parse_streaming(bytes{wasm_prefix} + type_section +
+                                         make_section(3, "0100"_bytes) +
+                                         make_section(10, make_vec({}))),
+        parser_error, "malformed binary: number of function and code entries must match");
+
+    // The function body exceeds the code section.
+    EXPECT_THROW_MESSAGE(parse_streaming(bytes{wasm_prefix} + type_section +
+                                         make_section(3, "0100"_bytes) +
+                                         make_section(10, "01030b"_bytes) + "0b"_bytes),
+        parser_error, "unexpected EOF");
+
+    // The code section is larger than its function bodies.
+    EXPECT_THROW_MESSAGE(parse_streaming(bytes{wasm_prefix} + type_section +
+                                         make_section(3, "0100"_bytes) +
+                                         make_section(10, "0102000b00"_bytes)),
+        parser_error, "incorrect section 10 size, difference: -1");
+
+    const auto code_section = make_section(10, make_vec({add_size_prefix("000b"_bytes)}));
+    EXPECT_THROW_MESSAGE(
+        parse_streaming(bytes{wasm_prefix} + make_section(3, "0100"_bytes) + code_section),
+        validation_error, "invalid function type index");
+
+    EXPECT_THROW_MESSAGE(parse_streaming(bytes{wasm_prefix} +
+                                         make_section(11, make_vec({"0041000b00"_bytes}))),
+        validation_error, "data section encountered without a memory section");
+}
+
 TEST(parser, code_with_empty_expr_2_locals)
 {
     // Func with 2x i32 locals, only 0x0b "end" instruction.
@@ -1027,7 +1238,7 @@ TEST(parser, code_with_empty_expr_2_locals)
     ASSERT_EQ(module->codesec.size(), 1);
     const auto& code_obj = module->codesec[0];
     EXPECT_EQ(code_obj.local_count, 2);
-    EXPECT_THAT(code_obj.instructions, ElementsAre(Instr::end));
+    EXPECT_THAT(code_obj.instructions, ElementsAre(Instr::end_function));
 }
 
 TEST(parser, code_with_empty_expr_5_locals)
@@ -1042,7 +1253,7 @@ TEST(parser, code_with_empty_expr_5_locals)
     ASSERT_EQ(module->codesec.size(), 1);
     const auto& code_obj = module->codesec[0];
     EXPECT_EQ(code_obj.local_count, 5);
-    EXPECT_THAT(code_obj.instructions, ElementsAre(Instr::end));
+    EXPECT_THAT(code_obj.instructions, ElementsAre(Instr::end_function));
 }
 
 TEST(parser, code_section_with_2_trivial_codes)
@@ -1059,9 +1270,9 @@ TEST(parser, code_section_with_2_trivial_codes)
     EXPECT_EQ(module->typesec[0].outputs.size(), 0);
     ASSERT_EQ(module->codesec.size(), 2);
     EXPECT_EQ(module->codesec[0].local_count, 0);
-    EXPECT_THAT(module->codesec[0].instructions, ElementsAre(Instr::end));
+    EXPECT_THAT(module->codesec[0].instructions, ElementsAre(Instr::end_function));
     EXPECT_EQ(module->codesec[1].local_count, 0);
-    EXPECT_THAT(module->codesec[1].instructions, ElementsAre(Instr::end));
+    EXPECT_THAT(module->codesec[1].instructions, ElementsAre(Instr::end_function));
 }
 
 TEST(parser, code_section_with_basic_instructions)
@@ -1087,8 +1298,8 @@ TEST(parser, code_section_with_basic_instructions)
     ASSERT_EQ(module->codesec.size(), 1);
     EXPECT_EQ(module->codesec[0].local_count, 4);
     EXPECT_THAT(module->codesec[0].instructions,
-        ElementsAre(Instr::local_get, 1, 0, 0, 0, Instr::i32_const, 2, 0, 0, 0, Instr::i32_add,
-            Instr::local_set, 3, 0, 0, 0, Instr::nop, Instr::unreachable, Instr::end));
+        ElementsAre(Instr::local_get, 1, 0, 0, 0, Instr::i32_add_imm, 2, 0, 0, 0,
+            Instr::local_set, 3, 0, 0, 0, Instr::unreachable, Instr::end_function));
 }
 
 TEST(parser, code_section_with_memory_size)
@@ -1104,7 +1315,8 @@ TEST(parser, code_section_with_memory_size)
     const auto module = parse(bin);
     ASSERT_EQ(module->codesec.size(), 1);
     EXPECT_EQ(module->codesec[0].local_count, 0);
-    EXPECT_THAT(module->codesec[0].instructions, ElementsAre(Instr::memory_size, Instr::end));
+    EXPECT_THAT(
+        module->codesec[0].instructions, ElementsAre(Instr::memory_size, Instr::end_function));
 
     const auto func_bin_invalid =
         "00"  // vec(locals)
@@ -1132,7 +1344,8 @@ TEST(parser, code_section_with_memory_grow)
     ASSERT_EQ(module->codesec.size(), 1);
     EXPECT_EQ(module->codesec[0].local_count, 0);
     EXPECT_THAT(module->codesec[0].instructions,
-        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::memory_grow, Instr::drop, Instr::end));
+        ElementsAre(Instr::i32_const, 0, 0, 0, 0, Instr::memory_grow, Instr::drop,
+            Instr::end_function));
 
     const auto func_bin_invalid = "00"_bytes +  // vec(locals)
                                   i32_const(0) + "40011a0b"_bytes;
@@ -1320,6 +1533,33 @@ TEST(parser, data_section)
     EXPECT_EQ(module->datasec[2].init, "2424"_bytes);
 }
 
+TEST(parser, data_section_in_place)
+{
+    /* wat2wasm
+      (memory 0)
+      (data (i32.const 1) "\aa\ff")
+      (data (i32.const 2) "\55\55")
+    */
+    const auto bin = from_hex("0061736d0100000005030100000b0f020041010b02aaff0041020b025555");
+    const auto module = parse_in_place(bin);
+
+    // The segments refer to the input.
+    EXPECT_EQ(module->data_storage, nullptr);
+    ASSERT_EQ(module->datasec.size(), 2);
+    EXPECT_EQ(module->datasec[0].init, "aaff"_bytes);
+    EXPECT_EQ(module->datasec[0].init.data(), &bin[bin.size() - 9]);
+    EXPECT_EQ(module->datasec[1].init, "5555"_bytes);
+    EXPECT_EQ(module->datasec[1].init.data(), &bin[bin.size() - 2]);
+
+    // parse() copies the segments into the storage owned by the module.
+    const auto copied_module = parse(bin);
+    ASSERT_NE(copied_module->data_storage, nullptr);
+    ASSERT_EQ(copied_module->datasec.size(), 2);
+    EXPECT_EQ(copied_module->datasec[0].init, "aaff"_bytes);
+    EXPECT_NE(copied_module->datasec[0].init.data(), &bin[bin.size() - 9]);
+    EXPECT_EQ(copied_module->datasec[1].init.data(), copied_module->datasec[0].init.data() + 2);
+}
+
 TEST(parser, data_section_memidx_nonzero)
 {
     const auto section_contents = make_vec({"0141010b0100"_bytes});
@@ -1453,7 +1693,8 @@ TEST(parser, milestone1)
     const auto& c = m->codesec[0];
     EXPECT_EQ(c.local_count, 1);
     EXPECT_THAT(c.instructions,
-        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::local_get, 1, 0, 0, 0, Instr::i32_add,
-            Instr::local_get, 2, 0, 0, 0, Instr::i32_add, Instr::local_tee, 2, 0, 0, 0,
-            Instr::local_get, 0, 0, 0, 0, Instr::i32_add, Instr::end));
+        ElementsAre(Instr::local_get_local_get_i32_add, 0, 0, 0, 0, Instr::local_get, 1, 0, 0, 0,
+            Instr::i32_add, Instr::local_get, 2, 0, 0, 0, Instr::i32_add,
+            Instr::local_tee_local_get, 2, 0, 0, 0, Instr::local_get, 0, 0, 0, 0, Instr::i32_add,
+            Instr::end_function));
 }
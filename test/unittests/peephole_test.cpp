@@ -0,0 +1,252 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2019-2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "parser.hpp"
+#include <gmock/gmock.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+
+using namespace fizzy;
+using namespace fizzy::test;
+using namespace testing;
+
+TEST(peephole, remove_nop_block_loop_end)
+{
+    /* wat2wasm
+    (func (param i32) (result i32)
+      nop
+      (block (loop (nop)))
+      local.get 0
+    )
+    */
+    const auto wasm =
+        from_hex("0061736d0100000001060160017f017f030201000a0e010c000102400340010b0b20000b");
+    const auto module = parse(wasm);
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::end_function));
+
+    EXPECT_THAT(execute(module, 0, {7}), Result(7));
+}
+
+TEST(peephole, if_else_targets_relocated)
+{
+    /* wat2wasm
+    (func (param i32) (result i32)
+      (if (result i32) (local.get 0)
+        (then (block (result i32) (i32.const 1)))
+        (else (nop) (i32.const 2))
+      )
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f030201000a120110002000047f027f41010b050141020b0b");
+    const auto module = parse(wasm);
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::if_, /*else_offset:*/ 20, 0, 0, 0,
+            Instr::i32_const, 1, 0, 0, 0, Instr::else_, /*end_offset:*/ 25, 0, 0, 0,
+            /*20:*/ Instr::i32_const, 2, 0, 0, 0,
+            /*25:*/ Instr::end_function));
+
+    EXPECT_THAT(execute(module, 0, {1}), Result(1));
+    EXPECT_THAT(execute(module, 0, {0}), Result(2));
+}
+
+TEST(peephole, end_function_returns_to_caller)
+{
+    /* wat2wasm
+    (func (result i32)
+      call 1
+      call 1
+      i32.add
+    )
+    (func (result i32)
+      (block (result i32) (i32.const 2))
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d010000000105016000017f03030200000a11020700100110016a0b0700027f41020b0b");
+    const auto module = parse(wasm);
+    EXPECT_THAT(module->codesec[1].instructions,
+        ElementsAre(Instr::i32_const, 2, 0, 0, 0, Instr::end_function));
+
+    EXPECT_THAT(execute(module, 0, {}), Result(4));
+}
+
+TEST(peephole, br_specialized)
+{
+    /* wat2wasm
+    (func (param i32) (result i32)
+      (block (result i32)
+        (block
+          i32.const 1
+          local.get 0
+          br_if 0  ;; arity 0, stack_drop 1
+          drop
+          i32.const 1
+          br 0  ;; arity 0, stack_drop 1
+        )
+        i32.const 3
+        i32.const 2
+        local.get 0
+        br_if 0  ;; arity 1, stack_drop 1
+        drop
+      )
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f030201000a1e011c00027f0240410120000d001a41010c000b410341"
+        "0220000d001a0b0b");
+    const auto module = parse(wasm);
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::i32_const, 1, 0, 0, 0, Instr::local_get, 0, 0, 0, 0, Instr::br_if_void,
+            /*arity:*/ 0, 0, 0, 0, /*code_offset:*/ 42, 0, 0, 0, /*stack_drop:*/ 1, 0, 0, 0,
+            Instr::drop, Instr::i32_const, 1, 0, 0, 0, Instr::br_void, /*arity:*/ 0, 0, 0, 0,
+            /*code_offset:*/ 42, 0, 0, 0, /*stack_drop:*/ 1, 0, 0, 0,
+            /*42:*/ Instr::i32_const, 3, 0, 0, 0, Instr::i32_const, 2, 0, 0, 0, Instr::local_get,
+            0, 0, 0, 0, Instr::br_if, /*arity:*/ 1, 0, 0, 0, /*code_offset:*/ 71, 0, 0, 0,
+            /*stack_drop:*/ 1, 0, 0, 0, Instr::drop,
+            /*71:*/ Instr::end_function));
+
+    EXPECT_THAT(execute(module, 0, {0}), Result(3));
+    EXPECT_THAT(execute(module, 0, {1}), Result(2));
+}
+
+TEST(peephole, fold_i32_const_all_variants)
+{
+    /* wat2wasm
+    (func (param i32) (result i32)
+      local.get 0
+      i32.const 3
+      i32.add  ;; to be replaced by variants of i32 instructions with immediate value
+    )
+    */
+    const auto wasm = from_hex("0061736d0100000001060160017f017f030201000a09010700200041036a0b");
+    const auto module = parse(wasm);
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::i32_add_imm, 3, 0, 0, 0,
+            Instr::end_function));
+
+    auto* const instr = const_cast<uint8_t*>(&module->codesec[0].instructions[5]);
+
+    constexpr std::pair<Instr, uint32_t> test_cases[]{
+        {Instr::i32_add_imm, 0x80000004},
+        {Instr::i32_and_imm, 0x00000001},
+        {Instr::i32_or_imm, 0x80000003},
+        {Instr::i32_xor_imm, 0x80000002},
+        {Instr::i32_shl_imm, 0x00000008},
+        {Instr::i32_shr_s_imm, 0xf0000000},
+        {Instr::i32_shr_u_imm, 0x10000000},
+        {Instr::i32_rotl_imm, 0x0000000c},
+        {Instr::i32_rotr_imm, 0x30000000},
+    };
+
+    for (const auto& [imm_instr, expected] : test_cases)
+    {
+        *instr = static_cast<uint8_t>(imm_instr);
+        EXPECT_THAT(execute(module, 0, {0x80000001}), Result(expected));
+    }
+}
+
+TEST(peephole, fold_i64_const_all_variants)
+{
+    /* wat2wasm
+    (func (param i64) (result i64)
+      local.get 0
+      i64.const 3
+      i64.add  ;; to be replaced by variants of i64 instructions with immediate value
+    )
+    */
+    const auto wasm = from_hex("0061736d0100000001060160017e017e030201000a09010700200042037c0b");
+    const auto module = parse(wasm);
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::i64_add_imm, 3, 0, 0, 0, 0, 0, 0, 0,
+            Instr::end_function));
+
+    auto* const instr = const_cast<uint8_t*>(&module->codesec[0].instructions[5]);
+
+    constexpr std::pair<Instr, uint64_t> test_cases[]{
+        {Instr::i64_add_imm, 0x8000000000000004},
+        {Instr::i64_and_imm, 0x0000000000000001},
+        {Instr::i64_or_imm, 0x8000000000000003},
+        {Instr::i64_xor_imm, 0x8000000000000002},
+        {Instr::i64_shl_imm, 0x0000000000000008},
+        {Instr::i64_shr_s_imm, 0xf000000000000000},
+        {Instr::i64_shr_u_imm, 0x1000000000000000},
+        {Instr::i64_rotl_imm, 0x000000000000000c},
+        {Instr::i64_rotr_imm, 0x3000000000000000},
+    };
+
+    for (const auto& [imm_instr, expected] : test_cases)
+    {
+        *instr = static_cast<uint8_t>(imm_instr);
+        EXPECT_THAT(execute(module, 0, {0x8000000000000001}), Result(expected));
+    }
+}
+
+TEST(peephole, fold_sub)
+{
+    /* wat2wasm
+    (func (param i32) (result i32)
+      local.get 0
+      i32.const 1
+      i32.sub
+    )
+    */
+    const auto wasm_i32 =
+        from_hex("0061736d0100000001060160017f017f030201000a09010700200041016b0b");
+    const auto module_i32 = parse(wasm_i32);
+    EXPECT_THAT(module_i32->codesec[0].instructions,
+        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::i32_add_imm, 0xff, 0xff, 0xff, 0xff,
+            Instr::end_function));
+
+    EXPECT_THAT(execute(module_i32, 0, {0}), Result(0xffffffff));
+    EXPECT_THAT(execute(module_i32, 0, {2}), Result(1));
+
+    /* wat2wasm
+    (func (param i64) (result i64)
+      local.get 0
+      i64.const 1
+      i64.sub
+    )
+    */
+    const auto wasm_i64 =
+        from_hex("0061736d0100000001060160017e017e030201000a09010700200042017d0b");
+    const auto module_i64 = parse(wasm_i64);
+    EXPECT_THAT(module_i64->codesec[0].instructions,
+        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::i64_add_imm, 0xff, 0xff, 0xff, 0xff,
+            0xff, 0xff, 0xff, 0xff, Instr::end_function));
+
+    EXPECT_THAT(execute(module_i64, 0, {0}), Result(0xffffffffffffffff));
+    EXPECT_THAT(execute(module_i64, 0, {2}), Result(1));
+}
+
+TEST(peephole, no_fold_into_branch_target)
+{
+    /* wat2wasm
+    (func (param i32 i32) (result i32)
+      local.get 0
+      (block (result i32)
+        i32.const 7
+        local.get 1
+        br_if 0
+        drop
+        i32.const 5
+      )
+      i32.add  ;; the target of br_if
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001070160027f7f017f030201000a130111002000027f410720010d001a41050b6a0b");
+    const auto module = parse(wasm);
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::i32_const, 7, 0, 0, 0, Instr::local_get,
+            1, 0, 0, 0, Instr::br_if_no_drop, /*arity:*/ 1, 0, 0, 0, /*code_offset:*/ 34, 0, 0, 0,
+            /*stack_drop:*/ 0, 0, 0, 0, Instr::drop, Instr::i32_const, 5, 0, 0, 0,
+            /*34:*/ Instr::i32_add, Instr::end_function));
+
+    EXPECT_THAT(execute(module, 0, {10, 0}), Result(15));
+    EXPECT_THAT(execute(module, 0, {10, 1}), Result(17));
+}
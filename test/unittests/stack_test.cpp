@@ -277,6 +277,34 @@ TEST(operand_stack, large_with_locals)
 }
 
 
+TEST(operand_stack, external_storage)
+{
+    fizzy::Value storage[8];
+    std::fill(std::begin(storage), std::end(storage), fizzy::Value{0xee});
+    storage[0] = 0xa1;
+    storage[1] = 0xa2;
+
+    OperandStack stack(storage, 2, 3);
+    EXPECT_EQ(stack.size(), 0);
+    EXPECT_EQ(stack.rbegin(), &storage[5]);
+
+    EXPECT_EQ(stack.local(0).i64, 0xa1);
+    EXPECT_EQ(stack.local(1).i64, 0xa2);
+    EXPECT_EQ(stack.local(2).i64, 0);
+    EXPECT_EQ(stack.local(3).i64, 0);
+    EXPECT_EQ(stack.local(4).i64, 0);
+
+    stack.push(1);
+    stack.push(2);
+    stack.push(3);
+    EXPECT_EQ(stack.size(), 3);
+    EXPECT_EQ(storage[7].i64, 3);
+    EXPECT_EQ(stack.rend(), std::end(storage));
+
+    stack.local(1) = 0xc1;
+    EXPECT_EQ(storage[1].i64, 0xc1);
+}
+
 TEST(operand_stack, rbegin_rend)
 {
     OperandStack stack(nullptr, 0, 0, 3);
@@ -326,3 +354,118 @@ TEST(operand_stack, to_vector)
     EXPECT_EQ(result[1].i64, 2);
     EXPECT_EQ(result[2].i64, 3);
 }
+
+TEST(cached_operand_stack, push_pop)
+{
+    // The last local variable is the slot reserved for the spilled top item of an empty stack.
+    fizzy::Value storage[6];
+    std::fill(std::begin(storage), std::end(storage), fizzy::Value{0xee});
+    storage[0] = 0xa1;
+
+    const OperandStack operand_stack(storage, 1, 2);
+    CachedOperandStack stack{operand_stack};
+    EXPECT_EQ(stack.size(), 0);
+    EXPECT_EQ(stack.local(0).i64, 0xa1);
+    EXPECT_EQ(stack.local(1).i64, 0);
+
+    stack.push(1);
+    stack.push(2);
+    stack.push(3);
+    EXPECT_EQ(stack.size(), 3);
+    EXPECT_EQ(stack.top().i64, 3);
+    EXPECT_EQ(storage[3].i64, 1);
+    EXPECT_EQ(storage[4].i64, 2);
+    EXPECT_EQ(storage[5].i64, 0xee) << "the top item is not spilled";
+
+    stack.top() = 13;
+    EXPECT_EQ(stack.pop().i64, 13);
+    EXPECT_EQ(stack.top().i64, 2);
+    EXPECT_EQ(stack.pop().i64, 2);
+    EXPECT_EQ(stack.pop().i64, 1);
+    EXPECT_EQ(stack.size(), 0);
+
+    stack.push(4);
+    EXPECT_EQ(stack.top().i64, 4);
+    EXPECT_EQ(stack.size(), 1);
+    EXPECT_EQ(stack.local(0).i64, 0xa1);
+}
+
+TEST(cached_operand_stack, drop)
+{
+    fizzy::Value storage[5];
+    const OperandStack operand_stack(storage, 0, 1);
+    CachedOperandStack stack{operand_stack};
+
+    stack.push(1);
+    stack.push(2);
+    stack.push(3);
+    stack.top() = 4;
+
+    stack.drop(0);
+    EXPECT_EQ(stack.size(), 3);
+    EXPECT_EQ(stack.top().i64, 4);
+
+    stack.drop(2);
+    EXPECT_EQ(stack.size(), 1);
+    EXPECT_EQ(stack.top().i64, 1);
+
+    stack.drop(1);
+    EXPECT_EQ(stack.size(), 0);
+}
+
+TEST(cached_operand_stack, rend_spills_top)
+{
+    fizzy::Value storage[4];
+    const OperandStack operand_stack(storage, 0, 1);
+    CachedOperandStack stack{operand_stack};
+
+    stack.push(1);
+    stack.push(2);
+    stack.top() = 3;
+    EXPECT_EQ(stack.rend(), &storage[3]);
+    EXPECT_EQ(storage[1].i64, 1);
+    EXPECT_EQ(storage[2].i64, 3);
+    EXPECT_EQ(stack.top().i64, 3);
+}
+
+TEST(cached_operand_stack, frame)
+{
+    fizzy::Value storage[8];
+    storage[0] = 0xa1;
+    const OperandStack operand_stack(storage, 1, 1);
+    CachedOperandStack stack{operand_stack};
+
+    stack.push(1);
+    stack.push(2);
+    const auto frame = stack.frame();
+    EXPECT_EQ(frame.top, &storage[3]);
+    EXPECT_EQ(storage[3].i64, 2);
+
+    // Switch to the frame of a called function placed at the top stack item (the argument).
+    stack.drop(1);
+    stack.set_frame(&storage[3], 1, 1);
+    EXPECT_EQ(stack.size(), 0);
+    EXPECT_EQ(stack.local(0).i64, 2);
+    stack.push(5);
+    stack.top() = 6;
+
+    stack.set_frame(frame);
+    EXPECT_EQ(stack.size(), 2);
+    EXPECT_EQ(stack.top().i64, 2);
+    EXPECT_EQ(stack.local(0).i64, 0xa1);
+    stack.drop(1);
+    EXPECT_EQ(stack.top().i64, 1);
+}
+
+TEST(cached_operand_stack, view_of_non_empty_stack)
+{
+    fizzy::Value storage[4];
+    OperandStack operand_stack(storage, 0, 1);
+    operand_stack.push(1);
+    operand_stack.push(2);
+
+    CachedOperandStack stack{operand_stack};
+    EXPECT_EQ(stack.size(), 2);
+    EXPECT_EQ(stack.pop().i64, 2);
+    EXPECT_EQ(stack.pop().i64, 1);
+}
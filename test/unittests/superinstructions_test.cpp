@@ -0,0 +1,179 @@
+// Fizzy: A fast WebAssembly interpreter
+// Copyright 2019-2020 The Fizzy Authors.
+// SPDX-License-Identifier: Apache-2.0
+
+#include "execute.hpp"
+#include "parser.hpp"
+#include <gmock/gmock.h>
+#include <test/utils/asserts.hpp>
+#include <test/utils/execute_helpers.hpp>
+#include <test/utils/hex.hpp>
+
+using namespace fizzy;
+using namespace fizzy::test;
+using namespace testing;
+
+TEST(superinstructions, local_get_local_get_i32_add)
+{
+    /* wat2wasm
+    (func (param i32 i32) (result i32)
+      local.get 0
+      local.get 1
+      i32.add
+    )
+    */
+    const auto wasm =
+        from_hex("0061736d0100000001070160027f7f017f030201000a09010700200020016a0b");
+    const auto module = parse(wasm);
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::local_get_local_get_i32_add, 0, 0, 0, 0, Instr::local_get, 1, 0, 0, 0,
+            Instr::i32_add, Instr::end_function));
+
+    EXPECT_THAT(execute(module, 0, {2, 3}), Result(5));
+    EXPECT_THAT(execute(module, 0, {0xffffffff, 2}), Result(1));
+}
+
+TEST(superinstructions, local_get_i32_load)
+{
+    /* wat2wasm
+    (memory 1)
+    (data (i32.const 0) "\01\02\03\04\05")
+    (func (param i32) (result i32)
+      local.get 0
+      i32.load offset=1
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f0302010005030100010a0901070020002802010b0b0b010041000b0501"
+        "02030405");
+    const auto module = parse(wasm);
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::local_get_i32_load, 0, 0, 0, 0, Instr::i32_load, 1, 0, 0, 0,
+            Instr::end_function));
+
+    auto instance = instantiate(*module);
+    EXPECT_THAT(execute(*instance, 0, {0}), Result(0x05040302));
+    EXPECT_THAT(execute(*instance, 0, {65531}), Result(0));
+    EXPECT_THAT(execute(*instance, 0, {65532}), Traps());
+}
+
+TEST(superinstructions, local_tee_local_get)
+{
+    /* wat2wasm
+    (func (param i32 i32) (result i32) (local i32)
+      local.get 0
+      local.tee 2
+      local.get 1
+      i32.sub
+      local.get 2
+      i32.add
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001070160027f7f017f030201000a10010e01017f2000220220016b20026a0b");
+    const auto module = parse(wasm);
+    EXPECT_THAT(module->codesec[0].instructions,
+        ElementsAre(Instr::local_get, 0, 0, 0, 0, Instr::local_tee_local_get, 2, 0, 0, 0,
+            Instr::local_get, 1, 0, 0, 0, Instr::i32_sub, Instr::local_get, 2, 0, 0, 0,
+            Instr::i32_add, Instr::end_function));
+
+    EXPECT_THAT(execute(module, 0, {10, 3}), Result(17));
+}
+
+TEST(superinstructions, i32_lt_u_br_if_loop)
+{
+    /* wat2wasm
+    (func (param i32) (result i32) (local i32)
+      (loop $l
+        local.get 1
+        i32.const 1
+        i32.add
+        local.set 1
+        local.get 1
+        local.get 0
+        i32.lt_u
+        br_if $l
+      )
+      local.get 1
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001060160017f017f030201000a19011701017f0340200141016a210120012000490d000b20"
+        "010b");
+    const auto module = parse(wasm);
+    EXPECT_EQ(module->codesec[0].instructions[25], Instr::i32_lt_u_br_if);
+
+    EXPECT_THAT(execute(module, 0, {0}), Result(1));
+    EXPECT_THAT(execute(module, 0, {10}), Result(10));
+}
+
+TEST(superinstructions, i32_eqz_br_if_with_result)
+{
+    /* wat2wasm
+    (func (param i32) (result i32)
+      (block (result i32)
+        i32.const 7
+        local.get 0
+        i32.eqz
+        br_if 0
+        drop
+        i32.const 8
+      )
+    )
+    */
+    const auto wasm =
+        from_hex("0061736d0100000001060160017f017f030201000a11010f00027f41072000450d001a41080b0b");
+    const auto module = parse(wasm);
+    EXPECT_EQ(module->codesec[0].instructions[10], Instr::i32_eqz_br_if);
+
+    EXPECT_THAT(execute(module, 0, {0}), Result(7));
+    EXPECT_THAT(execute(module, 0, {1}), Result(8));
+}
+
+TEST(superinstructions, i32_comparison_br_if_all_variants)
+{
+    /* wat2wasm
+    (func (param i32 i32) (result i32)
+      (block
+        local.get 0
+        local.get 1
+        i32.eq  ;; to be replaced by variants of i32 comparison
+        br_if 0
+        i32.const 0
+        return
+      )
+      i32.const 1
+    )
+    */
+    const auto wasm = from_hex(
+        "0061736d0100000001070160027f7f017f030201000a13011100024020002001460d0041000f0b41010b");
+    const auto module = parse(wasm);
+
+    auto* const cmp_instr = const_cast<uint8_t*>(&module->codesec[0].instructions[10]);
+    ASSERT_EQ(*cmp_instr, Instr::i32_eq_br_if);
+    ASSERT_EQ(cmp_instr[1], Instr::br_if_no_drop);
+
+    constexpr uint32_t M = 0xffffffff;  // -1 as signed.
+    // The expected results for arguments (1, 1), (-1, 1) and (1, -1).
+    constexpr std::tuple<Instr, uint32_t, uint32_t, uint32_t> test_cases[]{
+        {Instr::i32_eq_br_if, 1, 0, 0},
+        {Instr::i32_ne_br_if, 0, 1, 1},
+        {Instr::i32_lt_s_br_if, 0, 1, 0},
+        {Instr::i32_lt_u_br_if, 0, 0, 1},
+        {Instr::i32_gt_s_br_if, 0, 0, 1},
+        {Instr::i32_gt_u_br_if, 0, 1, 0},
+        {Instr::i32_le_s_br_if, 1, 1, 0},
+        {Instr::i32_le_u_br_if, 1, 0, 1},
+        {Instr::i32_ge_s_br_if, 1, 0, 1},
+        {Instr::i32_ge_u_br_if, 1, 1, 0},
+    };
+
+    for (const auto& [instr, expected_1_1, expected_m_1, expected_1_m] : test_cases)
+    {
+        *cmp_instr = static_cast<uint8_t>(instr);
+        auto instance = instantiate(*module);
+        EXPECT_THAT(execute(*instance, 0, {1, 1}), Result(expected_1_1));
+        EXPECT_THAT(execute(*instance, 0, {M, 1}), Result(expected_m_1));
+        EXPECT_THAT(execute(*instance, 0, {1, M}), Result(expected_1_m));
+    }
+}
@@ -44,3 +44,26 @@ TEST(types, functype)
     EXPECT_TRUE(functype_I != functype_i_ii);
     EXPECT_TRUE(functype_I != functype_ii_i);
 }
+
+TEST(types, canonical_func_type_id)
+{
+    const FuncType functype_v = {};
+    const FuncType functype_i = {{ValType::i32}, {}};
+    const FuncType functype_I = {{ValType::i64}, {}};
+    const FuncType functype_i_i = {{ValType::i32}, {ValType::i32}};
+    const FuncType functype_ii = {{ValType::i32, ValType::i32}, {}};
+    const FuncType functype__i = {{}, {ValType::i32}};
+
+    const auto id_v = get_canonical_func_type_id(functype_v);
+    EXPECT_EQ(get_canonical_func_type_id(FuncType{}), id_v);
+    EXPECT_EQ(get_canonical_func_type_id(functype_i_i), get_canonical_func_type_id(functype_i_i));
+
+    const FuncTypeId ids[]{id_v, get_canonical_func_type_id(functype_i),
+        get_canonical_func_type_id(functype_I), get_canonical_func_type_id(functype_i_i),
+        get_canonical_func_type_id(functype_ii), get_canonical_func_type_id(functype__i)};
+    for (size_t i = 0; i < std::size(ids); ++i)
+    {
+        for (size_t j = i + 1; j < std::size(ids); ++j)
+            EXPECT_NE(ids[i], ids[j]);
+    }
+}
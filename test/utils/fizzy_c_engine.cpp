@@ -36,7 +36,7 @@ FizzyExecutionResult env_adler32(void*, FizzyInstance* instance, const FizzyValu
     const auto ret = fizzy::test::adler32(
         bytes_view(memory, size)
             .substr(static_cast<uint32_t>(args[0].i64), static_cast<uint32_t>(args[1].i64)));
-    return {false, true, {ret}};
+    return {false, true, {ret}, false};
 }
 }  // namespace
 
@@ -65,6 +65,7 @@ bool FizzyCEngine::instantiate(bytes_view wasm_binary)
     FizzyImportedFunction imports[] = {
         {"env", "adler32", {{FizzyValueTypeI32, inputs, 2}, env_adler32, nullptr}}};
     m_instance.reset(fizzy_resolve_instantiate(module, imports, 1, nullptr, nullptr, nullptr, 0));
+    fizzy_free_module(module);
 
     return (m_instance != nullptr);
 }
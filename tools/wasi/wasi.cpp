@@ -10,6 +10,7 @@
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <optional>
 
 namespace
 {
@@ -18,6 +19,16 @@ namespace
 // and we are a single-run tool. This may change in the future and should reevaluate.
 uvwasi_t state;
 
+// The fd_read call waiting to be completed by execute_with_async_io().
+struct PendingRead
+{
+    fizzy::Instance* instance;
+    uvwasi_fd_t fd;
+    std::vector<uvwasi_iovec_t> iovs;
+    uint32_t nread_ptr;
+};
+std::optional<PendingRead> pending_read;
+
 fizzy::ExecutionResult wasi_return_enosys(fizzy::Instance&, const fizzy::Value*, int)
 {
     return fizzy::Value{uint32_t{UVWASI_ENOSYS}};
@@ -65,13 +76,48 @@ fizzy::ExecutionResult wasi_fd_read(fizzy::Instance& instance, const fizzy::Valu
     if (ret != UVWASI_ESUCCESS)
         return fizzy::Value{uint32_t{ret}};
 
+    // The read is done outside of the execution, which is suspended until then.
+    assert(!pending_read.has_value());
+    pending_read = {&instance, static_cast<uvwasi_fd_t>(fd), std::move(iovs), nread_ptr};
+    return fizzy::Suspended;
+}
+
+fizzy::ExecutionResult complete_pending_read()
+{
+    assert(pending_read.has_value());
+    auto& [instance, fd, iovs, nread_ptr] = *pending_read;
+
     uvwasi_size_t nread;
-    ret = uvwasi_fd_read(&state, static_cast<uvwasi_fd_t>(fd), iovs.data(), iov_cnt, &nread);
-    uvwasi_serdes_write_uint32_t(instance.memory->data(), nread_ptr, nread);
+    const uvwasi_errno_t ret = uvwasi_fd_read(
+        &state, fd, iovs.data(), static_cast<uvwasi_size_t>(iovs.size()), &nread);
+    uvwasi_serdes_write_uint32_t(instance->memory->data(), nread_ptr, nread);
 
+    pending_read.reset();
     return fizzy::Value{uint32_t{ret}};
 }
 
+// Executes the function with the I/O host function calls pending until they are completed here,
+// so the execution does not block in the host functions. The tool runs a single execution,
+// so the pending read is completed right away with the blocking uvwasi_fd_read(): the I/O of
+// many executions is not multiplexed (only a single read can be pending, see pending_read).
+fizzy::ExecutionResult execute_with_async_io(fizzy::Instance& instance, fizzy::FuncIdx func_idx)
+{
+    fizzy::ExecutionHandle handle;
+    if (const auto result = fizzy::execute(
+            instance, func_idx, nullptr, fizzy::ExecutionContext::UnlimitedGas, handle);
+        !result.suspended)
+        return result;
+
+    while (true)
+    {
+        // The module is not metered, so only the host function calls are pending.
+        assert(handle->host_call_pending);
+        if (const auto result = fizzy::complete_host_call(handle, complete_pending_read());
+            !result.suspended)
+            return result;
+    }
+}
+
 fizzy::ExecutionResult wasi_fd_prestat_get(fizzy::Instance& instance, const fizzy::Value* args, int)
 {
     const auto fd = args[0].as<uint32_t>();
@@ -149,10 +195,16 @@ bool run(int argc, const char** argv)
         std::cerr << "Failed to open file: " << argv[0] << "\n";
         return false;
     }
-    const auto wasm_binary =
-        fizzy::bytes(std::istreambuf_iterator<char>{wasm_file}, std::istreambuf_iterator<char>{});
+    // The module is parsed while the file is being read.
+    fizzy::StreamingParser parser;
+    char chunk[64 * 1024];
+    while (wasm_file.read(chunk, sizeof(chunk)) || wasm_file.gcount() > 0)
+    {
+        parser.push({reinterpret_cast<const uint8_t*>(chunk),
+            static_cast<size_t>(wasm_file.gcount())});
+    }
 
-    auto module = fizzy::parse(wasm_binary);
+    auto module = parser.finish();
     auto imports = fizzy::resolve_imported_functions(*module, wasi_functions);
     auto instance = fizzy::instantiate(
         std::move(module), std::move(imports), {}, {}, {}, fizzy::MemoryPagesValidationLimit);
@@ -179,7 +231,7 @@ bool run(int argc, const char** argv)
         return false;
     }
 
-    const auto result = fizzy::execute(*instance, *start_function, {});
+    const auto result = execute_with_async_io(*instance, *start_function);
     if (result.trapped)
     {
         std::cerr << "Execution aborted with WebAssembly trap\n";